@@ -4,10 +4,13 @@
 
 #pragma once
 
+#include <bit>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <optional>
 #include <string>
+#include <type_traits>
 
 //! Namespace containing common definitions
 namespace bmboot
@@ -53,8 +56,124 @@ enum ErrorCode
     // TODO: might want to just propagate the OS error for these?
     dev_mem_access_failed,              //!< Failed to access the @c /dev/mem special device
     mmap_failed,                        //!< The @c mmap function returned an error
+    file_access_failed,                 //!< The payload file could not be opened
+    core_dump_failed,                   //!< The core dump could not be written out
+    invalid_argument,                   //!< An argument is outside of the permitted range
+    state_wait_timed_out,               //!< The domain did not reach the requested state within the timeout
 };
 
+//! A fixed-size binary record exchanged through the telemetry ring (see bmboot::Telemetry, bmboot::IDomain::readTelemetry)
+struct TelemetryRecord
+{
+    //! Maximum size of the record contents
+    static constexpr size_t MAX_DATA_SIZE = 48;
+
+    uint64_t timestamp;                 //!< Value of the built-in timer (CNTPCT_EL0) when the record was pushed
+    uint16_t type;                      //!< Record type; the meaning is up to the payload
+    uint16_t size;                      //!< Number of valid bytes in #data
+    uint32_t reserved;
+    uint8_t data[MAX_DATA_SIZE];        //!< Record contents
+
+    //! Reinterpret the record contents as a value of type @p T
+    template <typename T>
+    T as() const
+    {
+        static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= MAX_DATA_SIZE);
+
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+};
+
+static_assert(sizeof(TelemetryRecord) == 64);
+
+//! Severity of a log message (see BMBOOT_LOG). Lower values are more severe.
+enum class LogLevel : uint8_t
+{
+    error,          //!< An error the payload cannot recover from on its own
+    warning,        //!< Something unexpected that the payload can cope with
+    info,           //!< Normal operational messages (default level)
+    debug,          //!< Verbose diagnostics
+};
+
+//! A log message in its binary form, as written by BMBOOT_LOG and read by bmboot::IDomain::readLog.
+//!
+//! The message is not formatted on the executor. Instead, the record holds the address of the format string in the
+//! payload image and the raw argument values; bmboot::LogDecoder turns it into text, using the payload's ELF file.
+struct LogRecord
+{
+    //! Maximum number of arguments of a log message
+    static constexpr size_t MAX_ARGS = 5;
+
+    uint64_t timestamp;                 //!< Value of the built-in timer (CNTPCT_EL0) when the message was logged
+    uint64_t format;                    //!< Address of the format string in the payload
+    LogLevel level;                     //!< Severity of the message
+    uint8_t num_args;                   //!< Number of valid entries in #args
+    uint8_t reserved[6];
+    uint64_t args[MAX_ARGS];            //!< Arguments; integers are extended to 64 bits and floating-point values
+                                        //!< converted to @c double, pointers (including strings) are stored as addresses
+};
+
+static_assert(sizeof(LogRecord) == 64);
+
+//! A sample taken by the statistical profiler in the monitor (see bmboot::IDomain::startProfiler)
+struct ProfileSample
+{
+    //! Maximum number of return addresses recovered per sample
+    static constexpr size_t MAX_FRAMES = 13;
+
+    uint64_t timestamp;                 //!< Value of the built-in timer (CNTPCT_EL0) when the sample was taken
+    uint64_t pc;                        //!< Address of the instruction at which the payload was interrupted
+    uint32_t num_frames;                //!< Number of valid entries in #frames
+    uint32_t reserved;
+    uint64_t frames[MAX_FRAMES];        //!< Return addresses found by walking the frame pointer chain, innermost first
+};
+
+static_assert(sizeof(ProfileSample) == 128);
+
+//! Distribution of a duration measured in ticks of the built-in timer (see bmboot::IDomain::readIrqStatistics)
+struct TickHistogram
+{
+    //! Number of histogram bins. Bin @e i counts durations of 2<sup>i</sup> to 2<sup>i+1</sup>-1 ticks, except that
+    //! the first bin also counts durations of 0 ticks and the last one counts everything longer.
+    static constexpr size_t NUM_BINS = 16;
+
+    uint64_t count;                     //!< Number of durations measured
+    uint64_t total;                     //!< Sum of all durations
+    uint32_t min;                       //!< Shortest duration (meaningless if #count is 0)
+    uint32_t max;                       //!< Longest duration
+    uint32_t bins[NUM_BINS];            //!< Histogram on a logarithmic scale
+
+    //! Get the index of the bin into which a duration falls
+    static constexpr size_t getBin(uint64_t ticks)
+    {
+        auto bin = (ticks > 0) ? (size_t) std::bit_width(ticks) - 1 : 0;
+        return (bin < NUM_BINS) ? bin : NUM_BINS - 1;
+    }
+};
+
+static_assert(sizeof(TickHistogram) == 88);
+
+//! Execution statistics of a periodic task run by bmboot::Scheduler (see bmboot::IDomain::readSchedulerStatistics).
+//! All durations are in ticks of the built-in timer. The deadline of each job is the release of the next one.
+struct TaskStatistics
+{
+    uint64_t releases;                  //!< Number of jobs released
+    uint64_t completions;               //!< Number of jobs completed
+    uint64_t overruns;                  //!< Number of jobs completed after their deadline
+    uint64_t dropped;                   //!< Number of releases skipped because the previous job had not finished
+    uint64_t total_execution;           //!< Sum of execution times, for the mean
+    uint32_t min_execution;             //!< Shortest execution time, excluding preemption by other tasks
+                                        //!< (meaningless if #completions is 0, as are the following fields)
+    uint32_t max_execution;             //!< Longest execution time, excluding preemption by other tasks
+    uint32_t max_start_delay;           //!< Longest delay from the release of a job until it started executing
+    uint32_t reserved;
+    int64_t max_lateness;               //!< Latest completion relative to the deadline; negative if always early
+};
+
+static_assert(sizeof(TaskStatistics) == 64);
+
 //! Parse a domain index from its string representation
 std::optional<DomainIndex> parseDomainIndex(std::string_view const& str);
 
@@ -67,4 +186,10 @@ std::string toString(bmboot::DomainState state);
 //! Convert an error code into its string representation
 std::string toString(bmboot::ErrorCode err);
 
+//! Parse a log level from its string representation
+std::optional<LogLevel> parseLogLevel(std::string_view const& str);
+
+//! Convert a log level into its string representation
+std::string toString(bmboot::LogLevel level);
+
 }
@@ -0,0 +1,117 @@
+//! @file
+//! @brief  Console displaying the standard output of executor domains
+//! @author Martin Cejp
+
+#pragma once
+
+#include "bmboot/domain.hpp"
+#include "bmboot/log_decoder.hpp"
+#include "bmboot/time_correlation.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bmboot
+{
+
+//! Displays the standard output of any number of domains, servicing all of them from a single thread.
+//!
+//! Since the executors' output buffers reside in shared memory, there is nothing to wait on; the domains are polled
+//! instead. The polling interval adapts to the traffic: it is reset to the minimum whenever there is output and
+//! doubles on every idle poll, up to the maximum. Each poll results in (at most) one @c writev to the standard output.
+//!
+//! Messages from the deferred-formatting log (see BMBOOT_LOG) are rendered and displayed along with the standard
+//! output, each prefixed by its level. Unlike standard output, which can only be stamped with the time it was
+//! received, log messages show the time they were logged, as long as the executor's clock can be correlated
+//! (see bmboot::TimeCorrelation). This requires the payload to call bmboot::idle; while it does not answer, the
+//! clock is sampled less and less often, since every attempt costs a short busy-wait.
+//!
+//! If a domain has discarded output because its buffer was full, this is indicated by a notice in the output.
+class Console
+{
+public:
+    //! Create a console. Throws @c std::system_error if the necessary OS resources cannot be allocated.
+    //!
+    //! @param min_poll_interval Polling interval while the domains are producing output; at least 1 microsecond
+    //! @param max_poll_interval Polling interval when the domains are idle
+    explicit Console(std::chrono::microseconds min_poll_interval = std::chrono::microseconds(250),
+                     std::chrono::microseconds max_poll_interval = std::chrono::microseconds(20'000));
+    ~Console();
+
+    Console(Console const&) = delete;
+    Console& operator=(Console const&) = delete;
+
+    //! Start displaying the output of a domain. Adding a domain that is already being displayed has no effect.
+    //!
+    //! This function can be called from any thread, including while #run is in progress.
+    //! The domain must remain open for as long as #run might be executing.
+    //!
+    //! @param domain Domain to display
+    //! @param log_decoder Decoder for the log messages of the payload; if not provided, they are displayed raw
+    void addDomain(IDomain& domain, std::shared_ptr<LogDecoder const> log_decoder = nullptr);
+
+    //! Display the output of all added domains until #stop is called.
+    //! Before returning, the output pending at the time of the call to #stop is printed, even if not terminated by a
+    //! newline. Anything written afterwards is left in the buffers.
+    void run();
+
+    //! Make #run return. This function is async-signal-safe.
+    void stop();
+
+private:
+    static constexpr size_t MAX_LINE_LENGTH = 160;
+    static constexpr std::chrono::seconds CLOCK_SAMPLE_INTERVAL {1};
+    static constexpr std::chrono::seconds MAX_CLOCK_SAMPLE_INTERVAL {64};
+    static constexpr std::chrono::microseconds CLOCK_SAMPLE_TIMEOUT {200};
+    static constexpr size_t OUTPUT_BUFFER_SIZE = 4096;
+
+    struct PendingDomain
+    {
+        IDomain* domain;
+        std::shared_ptr<LogDecoder const> log_decoder;
+    };
+
+    struct Slot
+    {
+        IDomain* domain;
+        std::shared_ptr<LogDecoder const> log_decoder;
+        uint64_t dropped_bytes;             // last seen value of IDomain::getStdoutDroppedBytes
+        uint32_t dropped_log_messages;      // last seen value of IDomain::getLogDroppedCount
+        TimeCorrelation time_correlation;
+        std::chrono::steady_clock::time_point next_clock_sample;
+        std::chrono::seconds clock_sample_interval; // grows while the payload does not answer
+        size_t final_stdout_bytes;          // output still to be printed by the final drain in #run
+        size_t final_log_messages;          // log messages still to be printed by the final drain in #run
+        char name[8];
+        char line[MAX_LINE_LENGTH];
+        char output[OUTPUT_BUFFER_SIZE];
+    };
+
+    void acceptPendingDomains();
+    void closeAll();
+    bool drainAll(bool final);
+    size_t drain(Slot& slot, float timestamp, bool final);
+    size_t drainLog(Slot& slot, float timestamp, size_t used, bool final);
+
+    int m_epoll_fd = -1;
+    int m_timer_fd = -1;
+    int m_event_fd = -1;
+
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::microseconds m_min_poll_interval;
+    std::chrono::microseconds m_max_poll_interval;
+
+    std::atomic_bool m_stop_requested = false;
+
+    std::mutex m_pending_mutex;
+    std::vector<PendingDomain> m_pending_domains;
+
+    std::array<Slot, DomainIndex::max_domain> m_slots;
+    size_t m_num_slots = 0;
+};
+
+}
@@ -0,0 +1,334 @@
+//! @file
+//! @brief  Coroutines driven by interrupts, timers and channels
+//! @author Martin Cejp
+
+#pragma once
+
+#include <bmboot/payload_runtime.hpp>
+#include <bmboot/timer_service.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace bmboot
+{
+
+//! Return type of a coroutine run by bmboot::CoroutineExecutor.
+//!
+//! A function returning this type is a coroutine, which can wait for interrupts (bmboot::interrupt), time
+//! (bmboot::sleepFor, bmboot::sleepUntil) and data (bmboot::Channel) with @c co_await, instead of spreading its state
+//! across interrupt handlers. Calling the function does not run it yet: the returned object is either handed over to
+//! bmboot::CoroutineExecutor::spawn, or awaited by another coroutine, which then continues once it has finished.
+//!
+//! The frames of coroutines are allocated from a pool of bmboot::CoroutineExecutor::MAX_COROUTINES blocks of
+//! bmboot::CoroutineExecutor::FRAME_SIZE bytes; no heap memory is used. If the pool is exhausted, or the frame is
+//! too large, the returned object is empty: bmboot::CoroutineExecutor::spawn refuses it, and awaiting it reports a
+//! crash of the payload.
+//!
+//! Example:
+//! @code
+//! bmboot::Coroutine blink()
+//! {
+//!     for (;;)
+//!     {
+//!         toggleLed();
+//!         co_await bmboot::sleepFor(std::chrono::milliseconds(500));
+//!     }
+//! }
+//!
+//! int main()
+//! {
+//!     bmboot::notifyPayloadStarted();
+//!     bmboot::CoroutineExecutor::spawn(blink());
+//!     bmboot::CoroutineExecutor::run();
+//! }
+//! @endcode
+class Coroutine
+{
+public:
+    class promise_type
+    {
+    public:
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* frame) noexcept;
+        static Coroutine get_return_object_on_allocation_failure() noexcept { return {}; }
+
+        Coroutine get_return_object() noexcept
+        {
+            return Coroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept { return FinalAwaiter {}; }
+
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+
+    private:
+        friend class Coroutine;
+        friend class CoroutineExecutor;
+
+        std::coroutine_handle<> m_continuation;     // coroutine awaiting this one, if any
+        bool m_spawned = false;                     // owned by the executor rather than by a Coroutine object
+    };
+
+    Coroutine() = default;
+    Coroutine(Coroutine&& other) noexcept : m_handle(other.m_handle) { other.m_handle = {}; }
+    ~Coroutine();
+
+    Coroutine& operator=(Coroutine&& other) noexcept;
+
+    //! Check whether the coroutine has been created successfully
+    explicit operator bool() const { return (bool) m_handle; }
+
+    // Awaiting a coroutine runs it until it has finished
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept;
+    void await_resume() const noexcept {}
+
+private:
+    friend class CoroutineExecutor;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    explicit Coroutine(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+//! Runs coroutines in the payload's main thread.
+//!
+//! Coroutines are only ever resumed by #run. Interrupt handlers and timer callbacks merely mark the waiting coroutine
+//! as ready, so coroutine code needs no protection against being preempted by other coroutines, and interrupt
+//! handlers stay short. When no coroutine is ready, the core sleeps in WFI until the next interrupt.
+class CoroutineExecutor
+{
+public:
+    //! Maximum number of coroutine frames, counting both spawned coroutines and those awaited by them
+    static constexpr size_t MAX_COROUTINES = 16;
+
+    //! Size of a block in the frame pool; a coroutine with a larger frame cannot be created
+    static constexpr size_t FRAME_SIZE = 1024;
+
+    //! Start running a coroutine; it is resumed for the first time by #run. Must not be called from an interrupt
+    //! handler.
+    //!
+    //! @return true if successful, false if the coroutine could not be created (see bmboot::Coroutine)
+    static bool spawn(Coroutine coroutine);
+
+    //! Run coroutines until all of them have finished. bmboot::TimerService is started if it is not running yet.
+    //!
+    //! While waiting, standard output is flushed and the manager's requests for a clock sample are answered, as in
+    //! bmboot::idle, but these requests are only seen when the core wakes up for an interrupt.
+    static void run();
+
+    //! Mark a suspended coroutine as ready to be resumed by #run. Can be called from any context, including interrupt
+    //! handlers.
+    //!
+    //! This is the building block of custom awaitables. A coroutine must be woken up at most once per suspension.
+    static void wake(std::coroutine_handle<> coroutine);
+
+    //! Get the number of blocks in the frame pool that are in use
+    static size_t getFrameCount();
+
+private:
+    friend class Coroutine;
+
+    static void* allocateFrame(size_t size);
+    static void freeFrame(void* frame);
+    static void finish(std::coroutine_handle<Coroutine::promise_type> coroutine);
+};
+
+// ************************************************************
+
+//! Awaitable returned by bmboot::interrupt
+class InterruptAwaiter
+{
+public:
+    explicit InterruptAwaiter(int interrupt_id) : m_interrupt_id(interrupt_id) {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> coroutine);
+    bool await_resume() const noexcept { return m_valid; }
+
+private:
+    int m_interrupt_id;
+    bool m_valid = false;
+};
+
+//! Wait for the next occurrence of a peripheral interrupt.
+//!
+//! The interrupt is configured at bmboot::PayloadInterruptPriority::p0_min when it is awaited, replacing any handler
+//! set up by bmboot::setupInterruptHandling (also one set up after an earlier wait). It is enabled while a coroutine is
+//! waiting, and disabled again as soon as it has been taken, so that a level-sensitive interrupt does not keep firing
+//! until the coroutine has had a chance to service the peripheral.
+//!
+//! While no coroutine is waiting, the interrupt controller still latches an occurrence of an edge-triggered interrupt
+//! or an SGI as pending, and delivers it as soon as the interrupt is awaited again; the wait then ends immediately.
+//! Several occurrences in the meantime are merged into one, so the number of wakeups is not a count of occurrences.
+//! A level-sensitive interrupt is only seen if the peripheral still asserts it at the next wait.
+//!
+//! At most one coroutine may wait for a given interrupt at a time.
+//!
+//! Usage: <tt>co_await bmboot::interrupt(id)</tt>, which evaluates to false if the interrupt ID is out of range.
+//!
+//! @param interrupt_id Platform-specific interrupt ID
+inline InterruptAwaiter interrupt(int interrupt_id)
+{
+    return InterruptAwaiter(interrupt_id);
+}
+
+//! Awaitable returned by bmboot::sleepFor and bmboot::sleepUntil
+class SleepAwaiter
+{
+public:
+    explicit SleepAwaiter(uint64_t deadline) : m_deadline(deadline) {}
+
+    bool await_ready() const noexcept { return getBuiltinTimerValue() >= m_deadline; }
+    void await_suspend(std::coroutine_handle<> coroutine);
+    void await_resume() const noexcept {}
+
+private:
+    uint64_t m_deadline;
+    Timer m_timer;
+};
+
+//! Suspend the coroutine for the given time, using bmboot::TimerService.
+//!
+//! Usage: <tt>co_await bmboot::sleepFor(duration)</tt>
+//!
+//! @param duration Delay from now; rounded up to whole ticks of the built-in timer
+inline SleepAwaiter sleepFor(std::chrono::microseconds duration)
+{
+    return SleepAwaiter(getBuiltinTimerValue() + TimerService::toTicks(duration));
+}
+
+//! Suspend the coroutine until the given time, using bmboot::TimerService.
+//!
+//! Advancing the deadline by a fixed amount in a loop gives a period that does not drift with the execution time of
+//! the loop body.
+//!
+//! Usage: <tt>co_await bmboot::sleepUntil(deadline)</tt>
+//!
+//! @param deadline Value of the built-in timer (see bmboot::getBuiltinTimerValue)
+inline SleepAwaiter sleepUntil(uint64_t deadline)
+{
+    return SleepAwaiter(deadline);
+}
+
+// ************************************************************
+
+//! Untyped implementation of bmboot::Channel
+class ChannelBase
+{
+public:
+    ChannelBase(ChannelBase const&) = delete;
+    ChannelBase& operator=(ChannelBase const&) = delete;
+
+    //! Get the number of elements waiting to be received
+    size_t size() const { return m_count; }
+
+protected:
+    ChannelBase(void* storage, size_t element_size, size_t capacity)
+            : m_storage(static_cast<std::byte*>(storage)), m_element_size(element_size), m_capacity(capacity)
+    {
+    }
+
+    bool send(void const* element);
+    bool tryReceive(void* element);
+
+    // Either receive an element into @p element right away and return false, or register the coroutine as the
+    // receiver and return true
+    bool suspendReceiver(std::coroutine_handle<> receiver, void* element);
+
+private:
+    std::byte* m_storage;
+    size_t m_element_size;
+    size_t m_capacity;
+
+    size_t m_head = 0;                          // index of the oldest element
+    size_t m_count = 0;
+
+    std::coroutine_handle<> m_receiver;         // coroutine waiting for an element, if any
+    void* m_receiver_element = nullptr;         // where the element is to be delivered
+};
+
+//! A bounded queue of elements between any code and a coroutine.
+//!
+//! Elements can be sent from any context, including interrupt handlers; they are received by a coroutine, which is
+//! suspended while the channel is empty. At most one coroutine may wait for an element at a time.
+//!
+//! Example:
+//! @code
+//! static bmboot::Channel<uint8_t, 64> rx_bytes;
+//!
+//! static void uartIrq(void*) { rx_bytes.send(UART->FIFO); }
+//!
+//! bmboot::Coroutine parser()
+//! {
+//!     for (;;)
+//!     {
+//!         auto byte = co_await rx_bytes.receive();
+//!         // ...
+//!     }
+//! }
+//! @endcode
+//!
+//! @tparam T Element type; must be trivially copyable and default-constructible
+//! @tparam N Capacity
+template <typename T, size_t N>
+class Channel : public ChannelBase
+{
+    static_assert(std::is_trivially_copyable_v<T>, "channel elements must be trivially copyable");
+    static_assert(N > 0, "channel capacity must be positive");
+
+public:
+    Channel() : ChannelBase(m_elements, sizeof(T), N) {}
+
+    //! Awaitable returned by #receive
+    class ReceiveAwaiter
+    {
+    public:
+        explicit ReceiveAwaiter(Channel& channel) : m_channel(channel) {}
+
+        bool await_ready() noexcept { return m_channel.ChannelBase::tryReceive(&m_element); }
+        bool await_suspend(std::coroutine_handle<> coroutine)
+        {
+            return m_channel.suspendReceiver(coroutine, &m_element);
+        }
+        T await_resume() const noexcept { return m_element; }
+
+    private:
+        Channel& m_channel;
+        T m_element;
+    };
+
+    //! Send an element. If a coroutine is waiting for one, it is woken up.
+    //!
+    //! @return true if successful, false if the channel is full
+    bool send(T const& element) { return ChannelBase::send(&element); }
+
+    //! Receive an element if one is available, without waiting.
+    //!
+    //! @return true if an element has been received, false if the channel is empty
+    bool tryReceive(T& element) { return ChannelBase::tryReceive(&element); }
+
+    //! Receive an element, waiting for one if the channel is empty.
+    //!
+    //! Usage: <tt>auto element = co_await channel.receive()</tt>
+    ReceiveAwaiter receive() { return ReceiveAwaiter(*this); }
+
+private:
+    T m_elements[N];
+};
+
+}
@@ -5,14 +5,19 @@
 #pragma once
 
 #include "bmboot.hpp"
+#include "bmboot/pmu.hpp"
 
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 
+#include <filesystem>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <span>
 #include <variant>
+#include <vector>
 
 namespace bmboot
 {
@@ -27,6 +32,134 @@ struct CrashInfo
     std::string desc;
 };
 
+//! Policy used when waiting for the executor to respond (state changes, command acknowledgements).
+//!
+//! The manager first busy-polls the shared memory for #spin_duration, since the executor normally responds within
+//! microseconds. After that, it sleeps between polls, starting at #initial_backoff and doubling the interval up to
+//! #max_backoff.
+struct WaitPolicy
+{
+    std::chrono::microseconds spin_duration {100};                    //!< Busy-poll for this long before sleeping
+    std::chrono::microseconds initial_backoff {50};                   //!< First sleep interval
+    std::chrono::microseconds max_backoff {10'000};                   //!< Upper bound of the sleep interval
+
+    std::chrono::microseconds monitor_startup_timeout {500'000};      //!< Timeout of #IDomain::startup and #IDomain::terminatePayload
+    std::chrono::microseconds payload_start_timeout {1'000'000};      //!< Timeout of payload start-up
+    std::chrono::microseconds snapshot_timeout {100'000};             //!< Timeout for the payload to be parked by #IDomain::snapshot
+
+    //! Inter-processor interrupt peer mask to be signalled by the executor whenever its state changes or a command is
+    //! acknowledged. The encoding is platform-specific (on the Zynq UltraScale+, see UG1087, APU_TRIG (IPI) Register).
+    //! The channels used by Bmboot to control the executors are refused. 0 = no notification.
+    uint32_t notification_ipi_mask = 0;
+
+    //! If provided, this function is called instead of sleeping. It should block until either the notification
+    //! (see #notification_ipi_mask) is received, or the timeout given as argument elapses.
+    //! An example would be a @c poll on a UIO device bound to the corresponding IPI channel.
+    std::function<void(std::chrono::microseconds timeout)> await_notification;
+};
+
+//! A simultaneous observation of the executor's built-in timer and the manager's monotonic clock
+//! (see bmboot::IDomain::sampleExecutorClock).
+//!
+//! The executor read its timer at some instant between #host_before and #host_after.
+struct ClockSample
+{
+    uint64_t executor_ticks;                                //!< Value of the executor's CNTPCT_EL0
+    uint32_t executor_frequency;                            //!< Value of the executor's CNTFRQ_EL0
+    std::chrono::steady_clock::time_point host_before;      //!< Time at which the request was issued
+    std::chrono::steady_clock::time_point host_after;       //!< Time at which the response was observed
+};
+
+//! Content of a snapshot taken by bmboot::IDomain::snapshot
+enum class SnapshotMode
+{
+    full,           //!< All of the payload's memory
+    incremental,    //!< Only the pages that have changed since the previous snapshot through the same IDomain instance
+};
+
+//! Settings of the statistical profiler (see bmboot::IDomain::startProfiler)
+struct ProfilerSettings
+{
+    //! Mean interval between samples. The actual intervals are randomly varied by up to &plusmn;1/8, so that the
+    //! sampling does not lock on to periodic activity in the payload. Intervals shorter than 10 &micro;s are not honored.
+    std::chrono::microseconds interval {1'000};
+
+    //! Maximum number of return addresses to recover per sample by walking the frame pointer chain, up to
+    //! ProfileSample::MAX_FRAMES. 0 = record only the interrupted PC.
+    size_t max_stack_depth = 0;
+};
+
+//! Values of the PMU counters of an executor, as published by its monitor (see bmboot::IDomain::startPerfCounters)
+struct PerfCounterValues
+{
+    uint64_t timestamp;                         //!< Value of the built-in timer (CNTPCT_EL0) when the values were taken
+    uint64_t timer_frequency;                   //!< Frequency of the built-in timer in Hz
+    uint64_t cycles;                            //!< Cycles spent in the payload
+    size_t num_events;                          //!< Number of valid entries in #events
+    uint64_t events[pmu::MAX_COUNTERS];         //!< Event counts, in the order given to IDomain::startPerfCounters
+};
+
+//! Statistics of one interrupt ID (see bmboot::IDomain::readIrqStatistics)
+struct InterruptStatistics
+{
+    int interrupt_id;                           //!< GIC interrupt ID
+
+    //! Time from entry into the IRQ vector until the handler has returned, including any interrupts that preempted
+    //! it. The number of occurrences of the interrupt is given by TickHistogram::count.
+    TickHistogram duration;
+};
+
+//! Interrupt statistics collected by an instrumented payload (see bmboot::IDomain::readIrqStatistics)
+struct IrqStatistics
+{
+    uint32_t timer_frequency;                   //!< Frequency of the built-in timer, to convert ticks into time
+
+    //! Delay between the deadline of the periodic interrupt (see bmboot::setupPeriodicInterrupt) and the entry into
+    //! the IRQ vector
+    TickHistogram timer_latency;
+
+    std::vector<InterruptStatistics> interrupts;    //!< Interrupts that have occurred, by ascending ID
+};
+
+//! A task of the payload's bmboot::Scheduler, with its statistics (see bmboot::IDomain::readSchedulerStatistics)
+struct ScheduledTask
+{
+    std::string name;                           //!< Name of the task
+    uint64_t period;                            //!< Period in ticks of the built-in timer
+    uint64_t offset;                            //!< Release of the first job after the start of the scheduler, in ticks
+    int priority;                               //!< Interrupt priority at which the task executes (a
+                                                //!< bmboot::PayloadInterruptPriority value; lower is more urgent)
+    TaskStatistics statistics;                  //!< Execution statistics
+};
+
+//! Statistics of the payload's bmboot::Scheduler (see bmboot::IDomain::readSchedulerStatistics)
+struct SchedulerStatistics
+{
+    uint32_t timer_frequency;                   //!< Frequency of the built-in timer, to convert ticks into time
+    std::vector<ScheduledTask> tasks;           //!< Tasks by decreasing priority
+};
+
+//! Behavior of the executor when its standard output buffer is full
+enum class StdoutOverflowPolicy
+{
+    drop,       //!< Discard the output that does not fit (default)
+    block,      //!< Wait for the manager to make room, up to a timeout; then discard the rest
+};
+
+//! Options for the mappings of executor memory that a domain keeps for its entire lifetime.
+//!
+//! The monitor, IPC and payload regions are mapped once, when the domain is opened, and reused by all subsequent
+//! operations. These options control how much of the mapping cost is paid up-front.
+struct MappingOptions
+{
+    //! Pre-fault all pages when the domain is opened (@c MAP_POPULATE), so that the first payload load does not
+    //! take a page fault on each of the 8192 pages of the payload region
+    bool populate = false;
+
+    //! Align the mappings to 2 MiB, so that the kernel can use block translations where @c /dev/mem permits it
+    bool large_page_alignment = true;
+};
+
 //! An abstract class representing an executor domain
 class IDomain
 {
@@ -34,8 +167,9 @@ public:
     //! Open an executor domain.
     //!
     //! @param index Domain selector
+    //! @param options Options for the mappings of executor memory
     //! @return
-    static DomainInstanceOrErrorCode open(DomainIndex index);
+    static DomainInstanceOrErrorCode open(DomainIndex index, MappingOptions const& options = {});
 
     virtual ~IDomain() = default;
 
@@ -51,6 +185,21 @@ public:
     //! Query current state of the domain
     virtual DomainState getState() = 0;
 
+    //! Wait until the domain reaches the given state.
+    //!
+    //! The manner of waiting is determined by the domain's #WaitPolicy.
+    //!
+    //! @param state The state to wait for
+    //! @param timeout Maximum time to wait
+    //! @return @link bmboot::state_wait_timed_out state_wait_timed_out@endlink if the state was not reached in time
+    virtual MaybeError waitForState(DomainState state, std::chrono::microseconds timeout) = 0;
+
+    //! Get the policy used to wait for responses from the executor
+    virtual WaitPolicy const& getWaitPolicy() const = 0;
+
+    //! Set the policy used to wait for responses from the executor
+    virtual void setWaitPolicy(WaitPolicy policy) = 0;
+
     //! Terminate the payload, returning control to the monitor.
     virtual MaybeError terminatePayload() = 0;
 
@@ -73,6 +222,16 @@ public:
                                            uint32_t payload_crc32,
                                            uintptr_t payload_argument) = 0;
 
+    //! Load and execute the given payload, computing its checksum while it is being copied to the domain's memory.
+    //!
+    //! This operation is permissible only when the domain state is @link bmboot::monitor_ready monitor_ready@endlink.
+    //!
+    //! \param payload_binary
+    //! \param payload_argument The value of this argument is simply passed to the payload (see bmboot::getPayloadArgument)
+    //! \return
+    virtual MaybeError loadAndStartPayload(std::span<uint8_t const> payload_binary,
+                                           uintptr_t payload_argument) = 0;
+
     //! Load and execute the given payload in ELF format.
     //!
     //! This operation is permissible only when the domain state is @link bmboot::monitor_ready monitor_ready@endlink.
@@ -83,17 +242,241 @@ public:
     virtual MaybeError loadElfPayload(std::span<uint8_t const> payload_binary,
                                       uintptr_t payload_argument) = 0;
 
+    //! Load and execute a payload stored in a file.
+    //!
+    //! The file is mapped into memory read-only and copied directly into the domain's memory; at no point is the
+    //! whole image buffered on the heap. Files with the extension @c .elf are loaded as in #loadElfPayload, anything
+    //! else is treated as a raw binary.
+    //!
+    //! This operation is permissible only when the domain state is @link bmboot::monitor_ready monitor_ready@endlink.
+    //!
+    //! \param path
+    //! \param payload_argument The value of this argument is simply passed to the payload (see bmboot::getPayloadArgument)
+    //! \return
+    virtual MaybeError loadPayloadFromFile(std::filesystem::path const& path,
+                                           uintptr_t payload_argument) = 0;
+
     //! Read a character from the executor's standard output. This function should be polled on a regular basis.
     //!
     //! @return The character read, or -1 if no output is pending.
     virtual int getchar() = 0;
 
+    //! Read all pending output from the executor's standard output, up to the size of the buffer.
+    //! This function should be polled on a regular basis.
+    //!
+    //! Unlike #getchar, this copies the data out in (at most) two contiguous runs, so it is much cheaper per byte.
+    //!
+    //! @param buffer Destination buffer
+    //! @return Number of bytes read, or 0 if no output is pending
+    virtual size_t readStdout(std::span<char> buffer) = 0;
+
+    //! Read one line from the executor's standard output, including the terminating newline character.
+    //!
+    //! If the pending output does not contain a newline, nothing is consumed, unless the output would fill the
+    //! entire buffer; in that case, a buffer-full of (unterminated) output is returned.
+    //!
+    //! @param buffer Destination buffer
+    //! @return Number of bytes read, or 0 if no complete line is available
+    virtual size_t readStdoutLine(std::span<char> buffer) = 0;
+
+    //! Get the number of bytes of standard output that the executor had to discard because the buffer was full.
+    //!
+    //! The counter is reset when the monitor is started.
+    virtual uint64_t getStdoutDroppedBytes() = 0;
+
+    //! Get the number of bytes of standard output waiting to be read
+    virtual size_t getStdoutPendingBytes() = 0;
+
+    //! Set the behavior of the executor when its standard output buffer is full.
+    //!
+    //! With @link bmboot::StdoutOverflowPolicy::block block@endlink, a payload writing to the standard output will
+    //! stall -- with interrupts masked -- until the manager makes room or the timeout elapses. This avoids losing
+    //! output under load at the expense of determinism, so it is primarily intended for debugging.
+    //!
+    //! The setting takes effect immediately and is reset to the default when the monitor is started.
+    //!
+    //! @param policy Overflow policy
+    //! @param block_timeout Maximum time to wait per write, clamped to 10 ms; only for StdoutOverflowPolicy::block
+    virtual void setStdoutOverflowPolicy(StdoutOverflowPolicy policy,
+                                         std::chrono::microseconds block_timeout = std::chrono::microseconds(0)) = 0;
+
+    //! Read pending telemetry records pushed by the payload (see bmboot::Telemetry), up to the size of the buffer.
+    //! This function should be polled on a regular basis.
+    //!
+    //! The records are stamped with the executor's built-in timer; use bmboot::TimeCorrelation to convert the
+    //! timestamps to the manager's clock.
+    //!
+    //! @param records Destination buffer
+    //! @return Number of records read, or 0 if none are pending
+    virtual size_t readTelemetry(std::span<TelemetryRecord> records) = 0;
+
+    //! Get the number of telemetry records that the payload had to discard because the ring was full
+    virtual uint32_t getTelemetryDroppedCount() = 0;
+
+    //! Read pending log messages (see BMBOOT_LOG), up to the size of the buffer.
+    //! This function should be polled on a regular basis; bmboot::LogDecoder renders the messages as text.
+    //!
+    //! @param records Destination buffer
+    //! @return Number of records read, or 0 if none are pending
+    virtual size_t readLog(std::span<LogRecord> records) = 0;
+
+    //! Get the number of log messages that the payload had to discard because the ring was full
+    virtual uint32_t getLogDroppedCount() = 0;
+
+    //! Get the number of log messages waiting to be read
+    virtual size_t getLogPendingCount() = 0;
+
+    //! Set the least severe level of log messages to be logged by the payload. Less severe messages are filtered out
+    //! by the payload itself, without reaching the log ring.
+    //!
+    //! The setting takes effect immediately and is reset to @link bmboot::LogLevel::info info@endlink when the
+    //! monitor is started.
+    virtual void setLogLevel(LogLevel level) = 0;
+
+    //! Start sampling the payload's program counter at regular intervals.
+    //!
+    //! Sampling is driven by the secure physical timer, which belongs to the monitor, so the payload needs no
+    //! instrumentation and cannot disable it. Each sample records the interrupted PC and optionally the return addresses
+    //! found by walking the AAPCS64 frame records; for those to be meaningful, the payload must be built with
+    //! @c -fno-omit-frame-pointer. Samples are only taken while the payload is executing, not while the monitor is.
+    //!
+    //! Samples left over from before are discarded. The profiler keeps running across payload restarts until stopped,
+    //! but it is turned off when the monitor is started.
+    //!
+    //! This operation is permissible only once the monitor is running.
+    //!
+    //! @param settings Sampling interval and stack depth
+    virtual MaybeError startProfiler(ProfilerSettings const& settings) = 0;
+
+    //! Stop the profiler. Samples already taken can still be read out.
+    virtual MaybeError stopProfiler() = 0;
+
+    //! Read pending profiler samples, up to the size of the buffer. While the profiler is running, this function should
+    //! be polled on a regular basis. bmboot::Symbolizer and bmboot::formatFoldedStacks help to make sense of them.
+    //!
+    //! @param samples Destination buffer
+    //! @return Number of samples read, or 0 if none are pending
+    virtual size_t readProfileSamples(std::span<ProfileSample> samples) = 0;
+
+    //! Get the number of profiler samples that had to be discarded because the ring was full
+    virtual uint32_t getProfileDroppedCount() = 0;
+
+    //! Count PMU events on behalf of the manager, without any cooperation from the payload.
+    //!
+    //! The monitor programs the PMU and publishes the counter values every 10 ms; the counters are reset when
+    //! counting starts. Only the execution of the payload is counted, not that of the monitor. Counting continues
+    //! across payload restarts until stopped (the counters are reset every time the monitor is restarted, for example
+    //! to terminate a payload).
+    //!
+    //! While counting, the PMU is not accessible to the payload: its registers read as zero and writes to them are
+    //! ignored. Consequently, bmboot::pmu::configure fails in the payload, bmboot::startCycleCounter has no effect
+    //! and bmboot::getCycleCounterValue returns 0.
+    //!
+    //! This operation is permissible only once the monitor is running.
+    //!
+    //! @param events Events to count, at most pmu::MAX_COUNTERS (the cycle counter is always included)
+    //! @return @link bmboot::invalid_argument invalid_argument@endlink if too many events have been requested
+    virtual MaybeError startPerfCounters(std::span<pmu::Event const> events) = 0;
+
+    //! Stop counting PMU events and give the PMU back to the payload
+    virtual MaybeError stopPerfCounters() = 0;
+
+    //! Get the most recently published counter values.
+    //!
+    //! Values published before the monitor has acted on the most recent call of #startPerfCounters -- for example,
+    //! those left over from an earlier session that was never stopped -- are not returned.
+    //!
+    //! @return The values, or nothing if the monitor is not counting (yet)
+    virtual std::optional<PerfCounterValues> readPerfCounters() = 0;
+
+    //! Read the interrupt statistics of the payload.
+    //!
+    //! The statistics are collected by the payload runtime itself, and only if it has been built with the CMake
+    //! option @c BMBOOT_IRQ_STATS. They are kept in shared memory, so reading them has no effect on the payload.
+    //! They are reset whenever a payload is started, and by #resetIrqStatistics.
+    //!
+    //! @return The statistics, or nothing if the payload does not collect them
+    virtual std::optional<IrqStatistics> readIrqStatistics() = 0;
+
+    //! Discard the interrupt statistics collected so far, for example once the payload has finished initializing.
+    //! The payload clears the statistics of each interrupt the next time it occurs.
+    virtual void resetIrqStatistics() = 0;
+
+    //! Read the task statistics of the payload's bmboot::Scheduler.
+    //!
+    //! They are kept in shared memory, so reading them has no effect on the payload. They are reset whenever a payload
+    //! is started, and by #resetSchedulerStatistics.
+    //!
+    //! @return The statistics, or nothing if the payload has not started a scheduler
+    virtual std::optional<SchedulerStatistics> readSchedulerStatistics() = 0;
+
+    //! Discard the task statistics collected so far. The payload clears the statistics of each task the next time it
+    //! updates them.
+    virtual void resetSchedulerStatistics() = 0;
+
+    //! Sample the executor's built-in timer through a handshake in shared memory.
+    //!
+    //! The request is answered by the monitor when no payload is running, and by bmboot::idle otherwise.
+    //! The manager busy-waits for the answer, so the timeout should be kept short; the narrower the interval between
+    //! request and response, the more useful the sample. See bmboot::TimeCorrelation for how to make use of it.
+    //!
+    //! @param timeout Maximum time to wait for the executor to answer
+    //! @return The sample, or nothing if the executor did not answer in time (or is not running)
+    virtual std::optional<ClockSample> sampleExecutorClock(std::chrono::microseconds timeout) = 0;
+
     //! Produce a Linux-compatible core dump for a crashed executor.
     //!
+    //! Pages of executor memory that contain only zeros are not written out, so the size of the dump, as well as the
+    //! time it takes to produce, is proportional to the memory actually in use rather than to the size of the payload
+    //! area.
+    //!
     //! @param filename Name of the file to be generated
-    //! @return
+    //! @return @link bmboot::core_dump_failed core_dump_failed@endlink if the file could not be created or written
     virtual MaybeError dumpCore(char const* filename) = 0;
 
+    //! Produce a Linux-compatible core dump for a crashed executor, writing it to an open file descriptor.
+    //!
+    //! The descriptor can refer to a regular file, in which case unused memory becomes holes in the file, or to a
+    //! pipe or socket, so that the dump can be compressed or transferred elsewhere on the fly. It is written
+    //! sequentially, starting at the current position (which, for a regular file, must be the beginning). A regular
+    //! file is truncated first, so any previous contents are discarded. The descriptor is not closed.
+    //!
+    //! @param fd File descriptor open for writing
+    //! @return @link bmboot::core_dump_failed core_dump_failed@endlink if writing failed
+    virtual MaybeError dumpCore(int fd) = 0;
+
+    //! Capture the state of a running payload as a Linux-compatible core dump, without stopping it.
+    //!
+    //! The payload memory is first copied while the payload keeps running. Then the payload is interrupted and parked
+    //! by the monitor, which captures its registers, and kept parked only for as long as the manager takes to compare
+    //! the payload memory with the copy and to copy again the pages that have changed in the meantime. During that time
+    //! the payload does not execute, and its interrupts are held pending. Everything else, including writing the core
+    //! dump, is done after the payload has been released.
+    //!
+    //! In @link bmboot::SnapshotMode::incremental incremental@endlink mode, the snapshot only contains the pages
+    //! whose content (as determined by a CRC-32 per 4 KiB page) differs from the previous snapshot taken through
+    //! this IDomain instance, be it full or incremental. Such a snapshot is meant to be overlaid on its predecessors;
+    //! memory missing from it is to be taken from them. If there is no previous snapshot of the current payload, an
+    //! incremental snapshot is the same as a full one. The baseline is not persisted: it is lost along with the IDomain
+    //! instance, so a process that opens the domain anew for every snapshot (such as <tt>bmctl snapshot</tt>) always
+    //! takes full ones.
+    //!
+    //! This operation is permissible only when the domain state is @link bmboot::running_payload running_payload@endlink.
+    //!
+    //! @param fd File descriptor open for writing; see #dumpCore(int)
+    //! @param mode Full or incremental snapshot
+    //! @return @link bmboot::state_wait_timed_out state_wait_timed_out@endlink if the payload could not be parked
+    //!         within WaitPolicy::snapshot_timeout,
+    //!         @link bmboot::core_dump_failed core_dump_failed@endlink if writing failed
+    virtual MaybeError snapshot(int fd, SnapshotMode mode = SnapshotMode::full) = 0;
+
+    //! Capture the state of a running payload into a file. See #snapshot(int, SnapshotMode).
+    //!
+    //! @param filename Name of the file to be generated
+    //! @param mode Full or incremental snapshot
+    //! @return
+    virtual MaybeError snapshot(char const* filename, SnapshotMode mode = SnapshotMode::full) = 0;
+
     //! Write miscellaneous debug information to the standard output. No guarantees are made about the content.
     virtual void dumpDebugInfo() = 0;
 
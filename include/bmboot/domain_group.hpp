@@ -0,0 +1,86 @@
+//! @file
+//! @brief  Management of multiple domains at once
+//! @author Martin Cejp
+
+#pragma once
+
+#include "bmboot/domain.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace bmboot
+{
+
+class DomainGroup;
+using DomainGroupOrErrorCode = std::variant<DomainGroup, ErrorCode>;
+
+//! A set of executor domains operated on together.
+//!
+//! Operations on a group are equivalent to applying the corresponding IDomain operation to each member, but all
+//! domains make progress concurrently: the time taken is bounded by the slowest domain, rather than the sum of all.
+//!
+//! The results of group operations are reported per domain, in the order in which the domains were given to #open.
+class DomainGroup
+{
+public:
+    //! Open a group of executor domains.
+    //!
+    //! @param domains Domain selectors; each domain may only be given once, otherwise
+    //!                @link bmboot::hw_resource_unavailable hw_resource_unavailable@endlink is returned
+    //! @param options Options for the mappings of executor memory, applied to all domains
+    //! @return
+    static DomainGroupOrErrorCode open(std::span<DomainIndex const> domains, MappingOptions const& options = {});
+
+    //! Open a group consisting of all executor domains.
+    static DomainGroupOrErrorCode openAll(MappingOptions const& options = {});
+
+    //! Start the bmboot monitor in all domains of the group.
+    //!
+    //! The monitors are copied and all the cores released first; only then are the monitors awaited, in parallel.
+    //!
+    //! This operation is permissible only when the state of each domain is @link bmboot::in_reset in_reset@endlink;
+    //! domains in any other state fail with @link bmboot::bad_domain_state bad_domain_state@endlink without
+    //! affecting the others.
+    std::vector<MaybeError> startup();
+
+    //! Group equivalent of IDomain::ensureReadyToLoadPayload
+    std::vector<MaybeError> ensureReadyToLoadPayload();
+
+    //! Load and execute a payload in each domain of the group, in parallel. See IDomain::loadPayloadFromFile.
+    //!
+    //! @param paths One payload file per domain; domains without a corresponding path fail with
+    //!              @link bmboot::file_access_failed file_access_failed@endlink
+    //! @param payload_argument The value of this argument is simply passed to each payload
+    //! @return
+    std::vector<MaybeError> loadPayloadsFromFiles(std::span<std::filesystem::path const> paths,
+                                                  uintptr_t payload_argument);
+
+    //! Load and execute a payload in each domain of the group, in parallel, each with its own argument.
+    //!
+    //! @param paths One payload file per domain, as above
+    //! @param payload_arguments One argument per domain, passed to the corresponding payload; domains without one
+    //!                          get 0
+    //! @return
+    std::vector<MaybeError> loadPayloadsFromFiles(std::span<std::filesystem::path const> paths,
+                                                  std::span<uintptr_t const> payload_arguments);
+
+    //! Number of domains in the group
+    size_t size() const { return m_domains.size(); }
+
+    //! Access a member of the group
+    IDomain& operator[](size_t index) { return *m_domains[index]; }
+
+    auto begin() { return m_domains.begin(); }
+    auto end() { return m_domains.end(); }
+
+private:
+    explicit DomainGroup(std::vector<std::unique_ptr<IDomain>> domains) : m_domains(std::move(domains)) {}
+
+    std::vector<std::unique_ptr<IDomain>> m_domains;
+};
+
+}
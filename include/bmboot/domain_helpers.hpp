@@ -6,17 +6,24 @@
 
 #include "bmboot.hpp"
 #include "bmboot/domain.hpp"
+#include "bmboot/domain_group.hpp"
 
 #include <filesystem>
+#include <span>
 
 namespace bmboot
 {
 
-void runConsoleUntilInterrupted(IDomain& domain);
-void startConsoleThread(IDomain& domain);
+// The payload paths are used to decode log messages (see BMBOOT_LOG); only ELF files are of any use
+void runConsoleUntilInterrupted(IDomain& domain, std::filesystem::path const& payload_path = {});
+void runConsoleUntilInterrupted(DomainGroup& group, std::span<std::filesystem::path const> payload_paths = {});
+void startConsoleThread(IDomain& domain, std::filesystem::path const& payload_path = {});
 
+// Argument passed to payloads started by bmctl, so that a payload can tell which format it was loaded from
+uintptr_t getDefaultPayloadArgument(std::filesystem::path const& path);
 void loadPayloadFromFileOrThrow(IDomain & domain, std::filesystem::path const& path);
 std::unique_ptr<IDomain> throwOnError(DomainInstanceOrErrorCode maybe_domain, const char* function_name);
+DomainGroup throwOnError(DomainGroupOrErrorCode maybe_group, const char* function_name);
 void throwOnError(MaybeError err, const char* function_name);
 
 }
@@ -0,0 +1,58 @@
+//! @file
+//! @brief  Rendering of deferred-formatting log messages
+//! @author Martin Cejp
+
+#pragma once
+
+#include "bmboot.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace bmboot
+{
+
+class LogDecoder;
+using LogDecoderOrErrorCode = std::variant<LogDecoder, ErrorCode>;
+
+//! Renders binary log messages (see BMBOOT_LOG, bmboot::IDomain::readLog) as text.
+//!
+//! The format strings -- and any strings passed as @c %s arguments -- are looked up by their address in the loadable
+//! segments of the payload's ELF file. Only conversions with a fixed-size argument are supported. The payload widens
+//! all arguments to 64 bits; integers are narrowed back according to the length modifier of the conversion, so that,
+//! for example, @c %x of an @c int of -1 is rendered as @c ffffffff.
+class LogDecoder
+{
+public:
+    //! Create a decoder without any payload image. Messages are rendered as their raw format address and arguments.
+    LogDecoder() = default;
+
+    //! Create a decoder for a payload.
+    //!
+    //! @param elf_path ELF file of the payload that produced the messages
+    //! @return @link bmboot::file_access_failed file_access_failed@endlink if the file cannot be read,
+    //!         @link bmboot::payload_image_malformed payload_image_malformed@endlink if it is not a 64-bit ELF file
+    static LogDecoderOrErrorCode open(std::filesystem::path const& elf_path);
+
+    //! Render a message as text, without a trailing newline
+    std::string format(LogRecord const& record) const;
+
+private:
+    struct Segment
+    {
+        uint64_t address;
+        size_t size;
+        size_t offset;          // in m_image
+    };
+
+    std::optional<std::string_view> lookupString(uint64_t address) const;
+
+    std::vector<char> m_image;
+    std::vector<Segment> m_segments;
+};
+
+}
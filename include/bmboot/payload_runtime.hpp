@@ -12,6 +12,7 @@
 #include "bmboot.hpp"
 
 #include <functional>
+#include <type_traits>
 
 namespace bmboot
 {
@@ -38,9 +39,24 @@ enum class PayloadInterruptPriority
     p0_min = 0xF0,         //!< Lowest priority (0xF0)
 };
 
+//! Buffering of the payload's standard output, see bmboot::setStdoutBuffering
+enum class StdoutBuffering
+{
+    unbuffered,     //!< Every write traps to the monitor, which copies it out right away; slowest, but no output is held
+                    //!< back in payload memory, where a crash or a hang could keep it from ever being flushed
+    line,           //!< Output is buffered until a newline is written (default)
+    full,           //!< Output is buffered until the buffer fills up or bmboot::flushStdout is called
+};
+
 //! Callback function for the periodic interrupt
 using InterruptHandler = std::function<void()>;
 
+//! Interrupt handler in the form of a plain function, which receives the context pointer given at registration.
+//!
+//! Unlike bmboot::InterruptHandler, registering one never allocates memory and invoking it costs a single indirect
+//! call.
+using InterruptHandlerFunction = void (*)(void* context);
+
 //! Get the frequency of the built-in timer.
 //!
 //! Per document 102379_0100_02_en (<em>Learn the architecture - Generic Timer</em>), this frequency should typically
@@ -79,6 +95,9 @@ inline uint64_t getBuiltinTimerValue()
 //! The cycle counter must be manually started by @link bmboot::startCycleCounter @endlink.
 //! Otherwise, the call will fail.
 //!
+//! While the manager is counting events of this payload (see bmboot::IDomain::startPerfCounters), the PMU belongs to
+//! the monitor and this function always returns 0.
+//!
 //! \return Cycle counter value
 inline uint64_t getCycleCounterValue()
 {
@@ -119,7 +138,18 @@ void notifyPayloadStarted();
 //! \param handler Funcion to be called
 void setupPeriodicInterrupt(std::chrono::microseconds period_us, InterruptHandler handler);
 
-//! Start the CPU cycle counter
+//! Configure the built-in periodic interrupt, with a handler that is a plain function.
+//!
+//! \param period_us Interrupt period in microseconds
+//! \param handler Function to be called; nullptr to not call anything
+//! \param context Argument to be passed to @p handler
+void setupPeriodicInterrupt(std::chrono::microseconds period_us, InterruptHandlerFunction handler, void* context);
+
+//! Start the CPU cycle counter.
+//!
+//! To count other events, such as cache refills, see bmboot::pmu::configure.
+//!
+//! Has no effect while the manager is counting events of this payload (see bmboot::IDomain::startPerfCounters).
 void startCycleCounter();
 
 //! Start the built-in periodic interrupt.
@@ -139,6 +169,39 @@ void stopPeriodicInterrupt();
 //! @return True if setup was successful, false otherwise
 bool setupInterruptHandling(int interrupt_id, PayloadInterruptPriority priority, InterruptHandler handler);
 
+//! Configure the reception of a peripheral interrupt, with a handler that is a plain function.
+//!
+//! This is the allocation-free variant of the function; the other overloads are built on top of it.
+//!
+//! @param interruptId Platform-specific interrupt ID
+//! @param priority Interrupt priority. A high-priority interrupt may preempt a low priority one.
+//! @param handler Callback function; nullptr to remove the handler
+//! @param context Argument to be passed to @p handler
+//! @return True if setup was successful, false otherwise
+bool setupInterruptHandling(int interrupt_id, PayloadInterruptPriority priority,
+                            InterruptHandlerFunction handler, void* context);
+
+//! Configure the reception of a peripheral interrupt, with a member function as the handler.
+//!
+//! The binding is resolved at compile time, so no memory is allocated. Example:
+//! @code
+//! bmboot::setupInterruptHandling<&MotorController::onEncoderInterrupt>(ENCODER_INTERRUPT_ID,
+//!                                                                      bmboot::PayloadInterruptPriority::p5,
+//!                                                                      motor_controller);
+//! @endcode
+//!
+//! @tparam Method Member function to be called, taking no arguments
+//! @param interruptId Platform-specific interrupt ID
+//! @param priority Interrupt priority. A high-priority interrupt may preempt a low priority one.
+//! @param object Object on which @p Method is to be called; must outlive the registration
+//! @return True if setup was successful, false otherwise
+template <auto Method, typename T>
+bool setupInterruptHandling(int interrupt_id, PayloadInterruptPriority priority, T& object)
+{
+    return setupInterruptHandling(interrupt_id, priority, [](void* context) { (static_cast<T*>(context)->*Method)(); },
+                                  &object);
+}
+
 //! Enable the reception of a peripheral interrupt.
 //!
 //! @link bmboot::setupInterruptHandling @endlink must be called first to configure the interrupt handler and priority.
@@ -152,13 +215,244 @@ void enableInterruptHandling(int interruptId);
 //! @param interruptId Platform-specific interrupt ID
 void disableInterruptHandling(int interruptId);
 
+//! Make an interrupt pending, as if it had been signalled.
+//!
+//! A software-generated interrupt (on the Zynq UltraScale+, IDs 0 to 15) is sent to the calling CPU core only.
+//! Any other interrupt is set pending in the distributor; since peripheral interrupts are configured as
+//! edge-triggered by @link bmboot::setupInterruptHandling @endlink, it is taken once, like a hardware edge would be.
+//! The interrupt must have been configured and enabled beforehand.
+//!
+//! This can be used to defer work from a high-priority handler to a lower priority, or to test interrupt handling.
+//!
+//! @param interruptId Platform-specific interrupt ID
+void raiseInterrupt(int interruptId);
+
+//! Get the interrupt priority mask of the calling CPU core.
+//!
+//! Only interrupts of a higher priority than the mask (that is, of a numerically lower value) are signalled to the
+//! core. The value is on the same scale as bmboot::PayloadInterruptPriority; 0xF8 or above means that no payload
+//! interrupt is masked.
+//!
+//! @return Current mask
+uint32_t getInterruptPriorityMask();
+
+//! Set the interrupt priority mask of the calling CPU core (see bmboot::getInterruptPriorityMask).
+//!
+//! Values below bmboot::PayloadInterruptPriority::p7_max are limited to it; the interrupts of the monitor cannot be
+//! masked by the payload. When the mask is raised, interrupts which have been signalled already might still be taken
+//! right afterwards; they are then recognized as spurious and ignored.
+//!
+//! Normally, bmboot::PriorityCeiling is to be used instead.
+//!
+//! @param mask New mask
+void setInterruptPriorityMask(uint32_t mask);
+
+//! Critical section that holds off the interrupts up to a given priority, while higher ones can still preempt it.
+//!
+//! To protect data shared with interrupt handlers, use the highest priority of these handlers as the ceiling. Unlike
+//! masking IRQs altogether, this keeps the latency of more urgent interrupts unaffected. The priority mask of the
+//! interrupt controller is raised to the ceiling for the lifetime of the object and restored afterwards; if it is
+//! higher already (in a nested critical section, for example), it is left as is. Creating the object in a handler of
+//! a priority at or above the ceiling is harmless, but pointless.
+//!
+//! Do not wait for interrupts (bmboot::idle, @c usleep) inside the critical section: the held-off ones would not wake
+//! up the core.
+//!
+//! Example:
+//! @code
+//! // Shared with the handlers of the encoder (p3) and of the limit switches (p4)
+//! {
+//!     bmboot::PriorityCeiling<bmboot::PayloadInterruptPriority::p4> lock;
+//!     position = encoder_position;
+//!     limits = limit_switches;
+//! }
+//! @endcode
+//!
+//! @tparam Ceiling Highest priority of the interrupts to be held off
+template <PayloadInterruptPriority Ceiling>
+class PriorityCeiling
+{
+public:
+    PriorityCeiling() : m_previous_mask(getInterruptPriorityMask())
+    {
+        if ((uint32_t) Ceiling < m_previous_mask)
+        {
+            setInterruptPriorityMask((uint32_t) Ceiling);
+        }
+    }
+
+    ~PriorityCeiling()
+    {
+        if ((uint32_t) Ceiling < m_previous_mask)
+        {
+            setInterruptPriorityMask(m_previous_mask);
+        }
+    }
+
+    PriorityCeiling(PriorityCeiling const&) = delete;
+    PriorityCeiling& operator=(PriorityCeiling const&) = delete;
+
+private:
+    uint32_t m_previous_mask;
+};
+
 //! Write to the standard output.
 //!
+//! Unless buffering has been disabled by bmboot::setStdoutBuffering, the data is collected in a small local buffer and
+//! copied to the manager-visible output buffer directly, without trapping to the monitor.
+//! Can be called from any context, including interrupt handlers.
+//!
 //! @param data Data to write (normally in ASCII encoding)
 //! @param size Number of bytes to written
 //! @return Number of bytes actually written, which might be limited by available buffer space
 int writeToStdout(void const* data, size_t size);
 
+//! Make any buffered standard output visible to the manager.
+//!
+//! This happens automatically at exit and when a crash is reported, but a payload using
+//! @link bmboot::StdoutBuffering::full StdoutBuffering::full@endlink should also call this periodically,
+//! for example from its idle loop (see bmboot::idle).
+void flushStdout();
+
+//! Set the buffering mode of the standard output. Any data buffered so far is flushed first.
+//!
+//! This is independent of the buffering done by the C standard library on top.
+void setStdoutBuffering(StdoutBuffering mode);
+
+//! Flush the standard output (see bmboot::flushStdout), service pending requests of the manager, and wait for an
+//! interrupt or an event. Output written by the interrupt handlers in the meantime is flushed before returning.
+//!
+//! Intended as the body of a payload's main loop when all the work is done in interrupt handlers. Besides output,
+//! this is where the manager's requests to sample the executor's clock are answered (see bmboot::TimeCorrelation);
+//! a payload which never calls this function cannot be correlated.
+void idle();
+
+//! Binary telemetry stream to the manager.
+//!
+//! Records are written directly to a dedicated region of shared memory, without involving the monitor, and read out in
+//! batches by bmboot::IDomain::readTelemetry. Each record is stamped with the value of the built-in timer.
+//! If the manager does not keep up, new records are discarded and counted.
+class Telemetry
+{
+public:
+    //! Push a record containing a value of type @p T.
+    //!
+    //! Can be called from any context, including interrupt handlers.
+    //!
+    //! @param type Record type; the meaning is up to the payload
+    //! @param value Record contents; must be trivially copyable and fit in TelemetryRecord::MAX_DATA_SIZE bytes
+    //! @return true if the record was pushed, false if it was discarded because the ring is full
+    template <typename T>
+    static bool push(uint16_t type, T const& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "telemetry records must be trivially copyable");
+        static_assert(sizeof(T) <= TelemetryRecord::MAX_DATA_SIZE, "telemetry record too large");
+
+        return push(type, &value, sizeof(T));
+    }
+
+    //! Push a record with arbitrary contents.
+    //!
+    //! @param type Record type; the meaning is up to the payload
+    //! @param data Record contents
+    //! @param size Size of the contents; at most TelemetryRecord::MAX_DATA_SIZE
+    //! @return true if the record was pushed, false if it was discarded (ring full or @p size too large)
+    static bool push(uint16_t type, void const* data, size_t size);
+
+    //! Get the number of records discarded so far because the ring was full
+    static uint32_t getDroppedCount();
+};
+
+//! Deferred-formatting log.
+//!
+//! Formatting text on the executor is slow and its duration depends on the data. Instead, each message is written to
+//! a dedicated ring in shared memory as a bmboot::LogRecord: the address of the format string and the raw argument
+//! values. The manager renders the message using the format string found in the payload's ELF file
+//! (see bmboot::LogDecoder). Which levels are logged is decided by the manager (bmboot::IDomain::setLogLevel);
+//! messages below that level cost no more than a comparison.
+//!
+//! Use through the BMBOOT_LOG macro, which also checks the arguments against the format string at compile time.
+class Log
+{
+public:
+    //! Check whether messages of the given level are currently being logged
+    static bool isEnabled(LogLevel level);
+
+    //! Log a message, irrespective of the current log level.
+    //!
+    //! Can be called from any context, including interrupt handlers.
+    //!
+    //! @param level Severity of the message
+    //! @param format printf-style format string; must be a string literal, since only its address is recorded.
+    //!               The same applies to any @c %s arguments.
+    //! @param args At most LogRecord::MAX_ARGS integer, floating-point or pointer arguments
+    //! @return true if the message was logged, false if it was discarded because the ring is full
+    template <typename... Args>
+    static bool write(LogLevel level, char const* format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "too many arguments for a log message");
+
+        uint64_t const encoded[sizeof...(Args) + 1] = { encodeArgument(args)..., 0 };
+        return writeEncoded(level, format, encoded, sizeof...(Args));
+    }
+
+    //! Log a message with pre-encoded arguments (see LogRecord::args)
+    static bool writeEncoded(LogLevel level, char const* format, uint64_t const* args, size_t num_args);
+
+    //! Get the number of messages discarded so far because the ring was full
+    static uint32_t getDroppedCount();
+
+private:
+    template <typename T>
+    static uint64_t encodeArgument(T value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            double as_double = value;
+            uint64_t bits;
+            memcpy(&bits, &as_double, sizeof(bits));
+            return bits;
+        }
+        else if constexpr (std::is_pointer_v<T>)
+        {
+            return (uintptr_t) value;
+        }
+        else if constexpr (std::is_enum_v<T>)
+        {
+            return encodeArgument((std::underlying_type_t<T>) value);
+        }
+        else
+        {
+            static_assert(std::is_integral_v<T>, "unsupported type of log message argument");
+
+            // Sign-extend; the manager narrows the value back according to the length modifier in the format string
+            return std::is_signed_v<T> ? (uint64_t) (int64_t) value : (uint64_t) value;
+        }
+    }
+};
+
+//! Never called; only used to have the compiler check the arguments of BMBOOT_LOG against the format string.
+[[gnu::format(printf, 1, 2)]] inline void checkLogFormat(char const*, ...) {}
+
 // TODO: can have some IPC here too
 
 }
+
+//! Log a message through the deferred-formatting log (see bmboot::Log).
+//!
+//! Example: <tt>BMBOOT_LOG(warning, "overcurrent on channel %d: %.3f A", channel, current);</tt>
+//!
+//! @param level One of the values of bmboot::LogLevel, without qualification
+//! @param format printf-style format string; must be a string literal
+#define BMBOOT_LOG(level, format, ...)                                                                      \
+    do                                                                                                      \
+    {                                                                                                       \
+        if (false)                                                                                          \
+        {                                                                                                   \
+            bmboot::checkLogFormat(format __VA_OPT__(,) __VA_ARGS__);                                       \
+        }                                                                                                   \
+        if (bmboot::Log::isEnabled(bmboot::LogLevel::level))                                                \
+        {                                                                                                   \
+            bmboot::Log::write(bmboot::LogLevel::level, "" format __VA_OPT__(,) __VA_ARGS__);               \
+        }                                                                                                   \
+    } while (0)
@@ -0,0 +1,239 @@
+//! @file
+//! @brief  Performance Monitor Unit event counters for the payload
+//! @author Martin Cejp
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace bmboot
+{
+enum class PayloadInterruptPriority;
+}
+
+namespace bmboot::pmu
+{
+
+//! Maximum number of event counters that can be in use at the same time (the Cortex-A53 implements six)
+constexpr inline size_t MAX_COUNTERS = 6;
+
+//! Some of the events that can be counted; see the <em>Cortex-A53 Technical Reference Manual</em>, section 12.9.
+//! Other event numbers supported by the core can be used by casting them to this type.
+enum class Event : uint16_t
+{
+    l1i_cache_refill = 0x01,        //!< Level 1 instruction cache refill
+    l1d_cache_refill = 0x03,        //!< Level 1 data cache refill
+    l1d_cache_access = 0x04,        //!< Level 1 data cache access
+    instructions_retired = 0x08,    //!< Instruction architecturally executed
+    exception_taken = 0x09,         //!< Exception taken
+    branch_mispredicted = 0x10,     //!< Branch mispredicted or not predicted
+    cpu_cycles = 0x11,              //!< Cycle (the dedicated cycle counter is always available, see Counts::cycles)
+    l2d_cache_access = 0x16,        //!< Level 2 data cache access
+    l2d_cache_refill = 0x17,        //!< Level 2 data cache refill
+    bus_access = 0x19,              //!< Bus access
+    irq_taken = 0x86,               //!< IRQ exception taken
+    stall_icache_miss = 0xE1,       //!< Cycle stalled because of an instruction cache miss
+    stall_load_miss = 0xE7,         //!< Cycle stalled because of a load miss
+    stall_store = 0xE8,             //!< Cycle stalled because of a store
+};
+
+//! Every event listed in bmboot::pmu::Event
+constexpr inline Event ALL_EVENTS[] = {
+    Event::l1i_cache_refill, Event::l1d_cache_refill, Event::l1d_cache_access, Event::instructions_retired,
+    Event::exception_taken, Event::branch_mispredicted, Event::cpu_cycles, Event::l2d_cache_access,
+    Event::l2d_cache_refill, Event::bus_access, Event::irq_taken, Event::stall_icache_miss, Event::stall_load_miss,
+    Event::stall_store,
+};
+
+//! Get the name of an event as spelled in bmboot::pmu::Event, or nullptr if it is not listed there
+constexpr char const* toString(Event event)
+{
+    switch (event)
+    {
+        case Event::l1i_cache_refill: return "l1i_cache_refill";
+        case Event::l1d_cache_refill: return "l1d_cache_refill";
+        case Event::l1d_cache_access: return "l1d_cache_access";
+        case Event::instructions_retired: return "instructions_retired";
+        case Event::exception_taken: return "exception_taken";
+        case Event::branch_mispredicted: return "branch_mispredicted";
+        case Event::cpu_cycles: return "cpu_cycles";
+        case Event::l2d_cache_access: return "l2d_cache_access";
+        case Event::l2d_cache_refill: return "l2d_cache_refill";
+        case Event::bus_access: return "bus_access";
+        case Event::irq_taken: return "irq_taken";
+        case Event::stall_icache_miss: return "stall_icache_miss";
+        case Event::stall_load_miss: return "stall_load_miss";
+        case Event::stall_store: return "stall_store";
+    }
+
+    return nullptr;
+}
+
+//! Parse an event from its name (see #toString) or its number in hexadecimal, prefixed by @c 0x
+constexpr std::optional<Event> parseEvent(std::string_view str)
+{
+    for (auto event : ALL_EVENTS)
+    {
+        if (str == toString(event))
+        {
+            return event;
+        }
+    }
+
+    if (str.size() < 3 || str.size() > 6 || str[0] != '0' || (str[1] != 'x' && str[1] != 'X'))
+    {
+        return {};
+    }
+
+    uint16_t number = 0;
+
+    for (auto c : str.substr(2))
+    {
+        auto digit = (c >= '0' && c <= '9') ? c - '0' :
+                     (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                     (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+
+        if (digit < 0)
+        {
+            return {};
+        }
+
+        number = number * 16 + digit;
+    }
+
+    return (Event) number;
+}
+
+//! Values of the counters at one instant, or the difference between two such instants
+struct Counts
+{
+    uint64_t cycles;                        //!< Value of the cycle counter
+    uint64_t events[MAX_COUNTERS];          //!< Values of the event counters, in the order given to bmboot::pmu::configure
+
+    Counts operator-(Counts const& other) const;
+};
+
+//! Program the event counters and start counting, together with the cycle counter.
+//!
+//! Only the execution of the payload is counted, not that of the monitor. All counters, including the cycle counter
+//! (and thus bmboot::getCycleCounterValue), are reset to 0.
+//!
+//! The hardware counters are 32 bits wide (except for the cycle counter), which may take just a few seconds to wrap
+//! around. To make them appear as 64-bit ones, the PMU overflow interrupt is set up at the highest payload priority;
+//! it must not be used for anything else.
+//!
+//! @param events Events to count; at most as many as the hardware implements, up to MAX_COUNTERS
+//! @return true if successful, false if too many events have been requested
+bool configure(std::span<Event const> events);
+
+//! Program the event counters and start counting, like #configure(std::span<Event const>), but with the overflow
+//! interrupt at a given priority.
+//!
+//! While a handler of higher priority is running, an overflow is held pending. Reading the counters in the meantime
+//! still gives the right result, but a counter that overflows a second time before the interrupt is taken loses
+//! 2<sup>32</sup> counts.
+//!
+//! @param events Events to count; at most as many as the hardware implements, up to MAX_COUNTERS
+//! @param overflow_priority Priority of the PMU overflow interrupt
+//! @return true if successful, false if too many events have been requested
+bool configure(std::span<Event const> events, PayloadInterruptPriority overflow_priority);
+
+//! Stop counting and release the counters
+void stop();
+
+//! Read the counters. Can be called from any context, including interrupt handlers.
+Counts read();
+
+//! Statistics of a quantity measured repeatedly
+struct Statistics
+{
+    uint64_t min = UINT64_MAX;      //!< Smallest value seen
+    uint64_t max = 0;               //!< Largest value seen
+    uint64_t total = 0;             //!< Sum of all values
+
+    //! Add one observation
+    void add(uint64_t value);
+
+    //! Average value (0 if nothing has been observed)
+    uint64_t mean(uint32_t num_samples) const { return num_samples ? total / num_samples : 0; }
+};
+
+//! A named piece of code whose executions are measured by bmboot::pmu::ScopedCounters.
+//!
+//! Regions are normally declared as static objects. All the regions in existence can be listed by #printAll.
+class Region
+{
+public:
+    //! @param name Name to be shown; must remain valid for the lifetime of the region (a string literal is best)
+    explicit Region(char const* name);
+    ~Region();
+
+    Region(Region const&) = delete;
+    Region& operator=(Region const&) = delete;
+
+    //! Account for one execution of the region
+    void add(Counts const& delta);
+
+    //! Forget all executions so far
+    void reset();
+
+    char const* getName() const { return m_name; }
+
+    //! Number of executions measured
+    uint32_t getNumSamples() const { return m_num_samples; }
+
+    //! Statistics of the cycle counter
+    Statistics const& getCycles() const { return m_cycles; }
+
+    //! Statistics of an event counter, in the order given to bmboot::pmu::configure
+    Statistics const& getEvents(size_t counter) const { return m_events[counter]; }
+
+    //! Write the statistics to the standard output, one line per counter
+    void print() const;
+
+    //! Write the statistics of all regions to the standard output
+    static void printAll();
+
+private:
+    char const* m_name;
+    uint32_t m_num_samples = 0;
+    Statistics m_cycles;
+    Statistics m_events[MAX_COUNTERS];
+
+    Region* m_next;                 // list of all regions, for printAll
+};
+
+//! Measures the execution of a code region, from construction to destruction of the object.
+//!
+//! The counters must have been started by bmboot::pmu::configure. Reading them costs about a dozen register accesses
+//! on entry and exit, which are included in the measurement.
+//!
+//! Example:
+//! @code
+//! static bmboot::pmu::Region control_loop_region("control loop");
+//!
+//! void controlLoop()
+//! {
+//!     bmboot::pmu::ScopedCounters measure(control_loop_region);
+//!     ...
+//! }
+//! @endcode
+class ScopedCounters
+{
+public:
+    explicit ScopedCounters(Region& region) : m_region(region), m_start(read()) {}
+    ~ScopedCounters() { m_region.add(read() - m_start); }
+
+    ScopedCounters(ScopedCounters const&) = delete;
+    ScopedCounters& operator=(ScopedCounters const&) = delete;
+
+private:
+    Region& m_region;
+    Counts m_start;
+};
+
+}
@@ -0,0 +1,84 @@
+//! @file
+//! @brief  Symbolization and rendering of profiler samples
+//! @author Martin Cejp
+
+#pragma once
+
+#include "bmboot.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace bmboot
+{
+
+class Symbolizer;
+using SymbolizerOrErrorCode = std::variant<Symbolizer, ErrorCode>;
+
+//! Resolves code addresses of a payload into function names, using the symbol table of its ELF file.
+//!
+//! C++ names are demangled. A stripped ELF file is accepted, but then nothing can be resolved.
+class Symbolizer
+{
+public:
+    //! A resolved address
+    struct Location
+    {
+        std::string_view function;      //!< Demangled name of the function containing the address
+        uint64_t offset;                //!< Offset of the address from the start of the function
+    };
+
+    //! Create a symbolizer without any symbols. Addresses are rendered in hexadecimal.
+    Symbolizer() = default;
+
+    //! Create a symbolizer for a payload.
+    //!
+    //! @param elf_path ELF file of the payload
+    //! @return @link bmboot::file_access_failed file_access_failed@endlink if the file cannot be read,
+    //!         @link bmboot::payload_image_malformed payload_image_malformed@endlink if it is not a 64-bit ELF file
+    static SymbolizerOrErrorCode open(std::filesystem::path const& elf_path);
+
+    //! Find the function containing an address
+    std::optional<Location> lookup(uint64_t address) const;
+
+    //! Render an address as @c function+0xoffset, or just in hexadecimal if it cannot be resolved
+    std::string describe(uint64_t address) const;
+
+private:
+    struct Function
+    {
+        uint64_t address;
+        uint64_t size;                  // 0 if unknown, in which case the function extends up to the next one
+        std::string name;
+    };
+
+    std::vector<Function> m_functions;  // sorted by address
+};
+
+//! Aggregate profiler samples into the "folded stacks" format understood by @c flamegraph.pl and similar tools.
+//!
+//! Every distinct stack produces one line: the function names from the outermost to the innermost, separated by
+//! semicolons, followed by a space and the number of samples.
+//!
+//! @param samples Samples as read by bmboot::IDomain::readProfileSamples
+//! @param symbolizer Symbolizer for the payload that was sampled
+std::string formatFoldedStacks(std::span<ProfileSample const> samples, Symbolizer const& symbolizer);
+
+//! Render profiler samples in the format produced by <tt>perf script</tt>, for consumption by tools written for
+//! Linux @c perf.
+//!
+//! @param samples Samples as read by bmboot::IDomain::readProfileSamples
+//! @param symbolizer Symbolizer for the payload that was sampled
+//! @param timer_frequency Frequency of the executor's built-in timer (see bmboot::ClockSample), used to convert
+//!                        the timestamps to seconds
+//! @param command Name to be shown as the command of every sample, typically that of the payload
+//! @param cpu CPU number to be shown for every sample
+std::string formatPerfScript(std::span<ProfileSample const> samples, Symbolizer const& symbolizer,
+                             uint32_t timer_frequency, std::string_view command, int cpu);
+
+}
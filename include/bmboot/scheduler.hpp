@@ -0,0 +1,130 @@
+//! @file
+//! @brief  Fixed-priority scheduler of periodic tasks
+//! @author Martin Cejp
+
+#pragma once
+
+#include <bmboot.hpp>
+#include <bmboot/payload_runtime.hpp>
+#include <bmboot/timer_service.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace bmboot
+{
+
+//! A periodic task, executed by bmboot::Scheduler.
+//!
+//! Each period, a job of the task is released: the task function is called once. Tasks are normally static objects;
+//! a task must not be destroyed while the scheduler is running.
+class Task
+{
+public:
+    //! @param name Name to be shown by the manager; must remain valid for the lifetime of the task
+    //! @param function Function to be called for every job
+    //! @param context Argument to be passed to @p function
+    //! @param period Period, which is also the relative deadline of each job
+    //! @param offset Release of the first job, relative to the start of the scheduler
+    //! @param priority Priority at which the task executes. If not given, it is assigned by the rate-monotonic rule
+    //!                 (see bmboot::Scheduler::start).
+    Task(char const* name, InterruptHandlerFunction function, void* context, std::chrono::microseconds period,
+         std::chrono::microseconds offset = {}, std::optional<PayloadInterruptPriority> priority = {})
+            : m_name(name), m_function(function), m_context(context), m_period(period), m_offset(offset),
+              m_requested_priority(priority)
+    {
+    }
+
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+
+    char const* getName() const { return m_name; }
+
+    //! Get the priority at which the task executes; only valid once the scheduler has been started
+    PayloadInterruptPriority getPriority() const { return m_priority; }
+
+    //! Get the execution statistics collected so far (they are also available to the manager, see
+    //! bmboot::IDomain::readSchedulerStatistics)
+    TaskStatistics getStatistics() const;
+
+private:
+    friend class Scheduler;
+
+    char const* m_name;
+    InterruptHandlerFunction m_function;
+    void* m_context;
+    std::chrono::microseconds m_period;
+    std::chrono::microseconds m_offset;
+    std::optional<PayloadInterruptPriority> m_requested_priority;
+
+    PayloadInterruptPriority m_priority = PayloadInterruptPriority::p0_min;
+    int m_index = -1;                   // position in the scheduler's table, by decreasing priority
+    int m_level = -1;                   // index into the scheduler's priority levels
+
+    Timer m_release_timer;
+    uint32_t m_timer_overruns = 0;      // value of Timer::getOverrunCount already accounted for
+    uint64_t m_release = 0;             // release time of the current job, in ticks
+    bool m_job_pending = false;         // released but not yet completed
+};
+
+//! Fixed-priority preemptive scheduler of periodic tasks.
+//!
+//! Jobs are released by bmboot::TimerService at the highest payload priority, and executed in the handler of a
+//! software-generated interrupt configured at the priority of the task. Preemption between tasks is therefore done
+//! by the interrupt controller: a job of a higher-priority task preempts a job of a lower-priority one, while tasks of
+//! equal priority run to completion one after another. Code outside of the tasks (such as @c main) runs when no job
+//! is pending.
+//!
+//! Seven priority levels are available to tasks, bmboot::PayloadInterruptPriority::p6 down to p0_min;
+//! bmboot::PayloadInterruptPriority::p7_max is taken by the timer service. The scheduler uses software-generated
+//! interrupts 8 to 14, which must not be used for anything else.
+//!
+//! For every task, the scheduler measures execution times, start delays and deadline misses. These statistics are
+//! kept in shared memory, where the manager can read them at any time (see bmboot::IDomain::readSchedulerStatistics).
+//!
+//! Example:
+//! @code
+//! static bmboot::Task control_loop("control loop", controlLoop, nullptr, std::chrono::microseconds(100));
+//! static bmboot::Task supervision("supervision", supervise, nullptr, std::chrono::milliseconds(1));
+//!
+//! bmboot::Scheduler::addTask(control_loop);
+//! bmboot::Scheduler::addTask(supervision);
+//! bmboot::Scheduler::start();
+//! @endcode
+class Scheduler
+{
+public:
+    //! Maximum number of tasks
+    static constexpr size_t MAX_TASKS = 16;
+
+    //! Register a task. Must be called before #start.
+    //!
+    //! @return true if successful, false if the scheduler is running, the table is full, or the task requests
+    //!         bmboot::PayloadInterruptPriority::p7_max
+    static bool addTask(Task& task);
+
+    //! Assign priorities and start releasing jobs; bmboot::TimerService is started if it is not running yet.
+    //!
+    //! Tasks without an explicit priority are assigned one by the rate-monotonic rule: the shorter the period, the
+    //! higher the priority. Distinct periods get distinct levels, from bmboot::PayloadInterruptPriority::p6 downwards;
+    //! if the levels run out, the longest periods share the lowest one. Explicit priorities are used as given.
+    //!
+    //! @return true if successful, false if no tasks have been added or the scheduler is running already
+    static bool start();
+
+    //! Stop releasing jobs. Jobs that have been released already still run to completion.
+    static void stop();
+
+    //! Check whether the scheduler is running
+    static bool isRunning();
+
+private:
+    static void assignPriorities();
+    static void releaseJob(void* context);
+    static void runLevel(void* context);
+    static void runJob(Task& task);
+};
+
+}
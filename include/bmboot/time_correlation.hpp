@@ -0,0 +1,95 @@
+//! @file
+//! @brief  Correlation of executor timestamps with the manager's clock
+//! @author Martin Cejp
+
+#pragma once
+
+#include "bmboot/domain.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+namespace bmboot
+{
+
+//! An executor timestamp converted to the manager's clock
+struct HostTime
+{
+    std::chrono::steady_clock::time_point time;     //!< Best estimate
+    std::chrono::nanoseconds error_bound;           //!< The true time lies within +/- this much of #time
+};
+
+//! Maps timestamps taken with the executor's built-in timer (CNTPCT_EL0, see bmboot::getBuiltinTimerValue) to the
+//! manager's @c std::chrono::steady_clock, which on Linux is @c CLOCK_MONOTONIC.
+//!
+//! The mapping is a least-squares linear fit over a sliding window of samples obtained by
+//! bmboot::IDomain::sampleExecutorClock; #update should therefore be called periodically, e.g. once per second.
+//! Each sample is taken as the midpoint of its request-response interval; samples with a long interval are discarded.
+//!
+//! The error bound of a conversion is the worst deviation of any sample in the window from the fit, plus the half-width
+//! of its interval. Beyond the time span covered by the window, the bound additionally grows by 500 ppm of the distance,
+//! which is the most by which the kernel may slew @c CLOCK_MONOTONIC to follow NTP.
+class TimeCorrelation
+{
+public:
+    //! @param max_round_trip Samples whose request-response interval is longer than this are discarded
+    //! @param window Maximum number of (most recent) samples that the fit is based on
+    explicit TimeCorrelation(std::chrono::nanoseconds max_round_trip = std::chrono::microseconds(50),
+                             size_t window = 32);
+
+    //! Take a new sample from a domain and add it to the fit.
+    //!
+    //! @param domain Domain to sample
+    //! @param timeout Maximum time to wait for the executor to answer (see IDomain::sampleExecutorClock)
+    //! @return true if a usable sample was obtained
+    bool update(IDomain& domain, std::chrono::microseconds timeout = std::chrono::microseconds(200));
+
+    //! Add a sample to the fit.
+    //!
+    //! @return true if the sample was accepted, false if it was discarded (see @p max_round_trip)
+    bool addSample(ClockSample const& sample);
+
+    //! Discard all samples, e.g. after the executor has been restarted
+    void reset();
+
+    //! Convert an executor timestamp to the manager's clock.
+    //!
+    //! @return The converted time, or nothing if no sample has been accepted yet
+    std::optional<HostTime> toHostTime(uint64_t executor_ticks) const;
+
+    //! Convert the timestamp of a telemetry record (see bmboot::IDomain::readTelemetry) to the manager's clock.
+    //!
+    //! @return The converted time, or nothing if no sample has been accepted yet
+    std::optional<HostTime> toHostTime(TelemetryRecord const& record) const { return toHostTime(record.timestamp); }
+
+    //! Get the frequency of the executor's timer as measured by the manager's clock, if at least two samples with
+    //! different timestamps have been accepted
+    std::optional<double> getMeasuredFrequency() const;
+
+private:
+    struct Point
+    {
+        uint64_t ticks;
+        int64_t host_ns;            // midpoint of the request-response interval
+        int64_t half_width_ns;
+    };
+
+    void refit();
+
+    std::chrono::nanoseconds m_max_round_trip;
+    size_t m_window;
+    std::deque<Point> m_points;
+
+    // The fit: host_ns = m_ref_host_ns + m_offset_ns + m_ns_per_tick * (ticks - m_ref_ticks)
+    uint32_t m_nominal_frequency = 0;
+    uint64_t m_ref_ticks = 0;
+    int64_t m_ref_host_ns = 0;
+    double m_offset_ns = 0;
+    double m_ns_per_tick = 0;
+    bool m_slope_measured = false;
+    int64_t m_error_ns = 0;
+};
+
+}
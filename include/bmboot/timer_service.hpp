@@ -0,0 +1,152 @@
+//! @file
+//! @brief  Software timers multiplexed onto the built-in timer
+//! @author Martin Cejp
+
+#pragma once
+
+#include <bmboot/payload_runtime.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace bmboot
+{
+
+//! A software timer, started and serviced by bmboot::TimerService.
+//!
+//! Timers are normally static objects, or members of one. The service only links them together, so starting a timer
+//! never allocates memory. A timer must not be destroyed or moved while it is active; the destructor cancels it.
+class Timer
+{
+public:
+    Timer() = default;
+
+    //! @param callback Function to be called when the timer expires; nullptr to only use the timer for its deadline
+    //! @param context Argument to be passed to @p callback
+    Timer(InterruptHandlerFunction callback, void* context) : m_callback(callback), m_context(context) {}
+
+    ~Timer();
+
+    Timer(Timer const&) = delete;
+    Timer& operator=(Timer const&) = delete;
+
+    //! Change the function called on expiry. Must not be called while the timer is active.
+    void setCallback(InterruptHandlerFunction callback, void* context)
+    {
+        m_callback = callback;
+        m_context = context;
+    }
+
+    //! Check whether the timer has been started and has not yet expired (for a one-shot timer) or been cancelled
+    bool isActive() const { return m_level != INACTIVE; }
+
+    //! Get the next expiry, in ticks of the built-in timer (meaningless if the timer is not active)
+    uint64_t getDeadline() const { return m_deadline; }
+
+    //! Get the period in ticks of the built-in timer, or 0 for a one-shot timer
+    uint64_t getPeriod() const { return m_period; }
+
+    //! Get the number of periods skipped because the callback could not be called in time.
+    //!
+    //! A periodic timer that falls behind is not called repeatedly to catch up; it skips to the next period in the
+    //! future instead, and the skipped periods are counted here.
+    uint32_t getOverrunCount() const { return m_overruns; }
+
+private:
+    friend class TimerService;
+
+    static constexpr int8_t INACTIVE = -1;
+
+    InterruptHandlerFunction m_callback = nullptr;
+    void* m_context = nullptr;
+
+    uint64_t m_deadline = 0;
+    uint64_t m_period = 0;
+    uint32_t m_overruns = 0;
+
+    // Position in the timer wheel (see timer_service.cpp)
+    int8_t m_level = INACTIVE;
+    uint8_t m_slot = 0;
+    Timer* m_next = nullptr;
+    Timer* m_prev = nullptr;
+};
+
+//! Any number of one-shot and periodic software timers on top of the built-in timer.
+//!
+//! The timers are kept in a hierarchical timer wheel, so that starting and cancelling one takes constant time
+//! regardless of how many are active. The EL1 physical timer (CNTP) is programmed for the nearest deadline only,
+//! instead of interrupting at a fixed rate, so an idle payload is not woken up needlessly.
+//!
+//! Timer callbacks are called from the timer interrupt, at the highest payload priority; they may start and cancel
+//! timers, including their own. All other functions can be called from any context.
+//!
+//! The service takes over the EL1 physical timer and its interrupt, so it cannot be used together with
+//! bmboot::setupPeriodicInterrupt.
+//!
+//! Example:
+//! @code
+//! static bmboot::Timer control_loop_timer(controlLoop, nullptr);
+//! static bmboot::Timer housekeeping_timer(housekeeping, nullptr);
+//!
+//! bmboot::TimerService::start();
+//! bmboot::TimerService::startPeriodic(control_loop_timer, std::chrono::microseconds(100));
+//! bmboot::TimerService::startPeriodic(housekeeping_timer, std::chrono::seconds(1));
+//! @endcode
+class TimerService
+{
+public:
+    //! Take over the EL1 physical timer and start servicing timers.
+    //!
+    //! Timers may be started before the service; they only begin to expire once it is running.
+    static void start();
+
+    //! Stop servicing timers and release the EL1 physical timer. Active timers stay active, but do not expire until
+    //! the service is started again.
+    static void stop();
+
+    //! Check whether the service is running
+    static bool isRunning();
+
+    //! Check whether the caller is a timer callback
+    static bool isInCallback();
+
+    //! Start a timer that expires once, after the given delay. If the timer is already active, it is restarted.
+    //!
+    //! @param timer Timer to be started
+    //! @param delay Delay from now; rounded up to whole ticks of the built-in timer
+    static void startOneShot(Timer& timer, std::chrono::microseconds delay);
+
+    //! Start a timer that expires periodically, the first time one period from now. If the timer is already active,
+    //! it is restarted.
+    //!
+    //! The deadlines advance by exactly one period each time, so they do not drift with the interrupt latency.
+    //!
+    //! @param timer Timer to be started
+    //! @param period Period; rounded up to whole ticks of the built-in timer
+    static void startPeriodic(Timer& timer, std::chrono::microseconds period);
+
+    //! Start a timer at an absolute deadline. If the timer is already active, it is restarted.
+    //!
+    //! This allows timers to be started in a fixed phase relation to each other, or to another event.
+    //!
+    //! @param timer Timer to be started
+    //! @param deadline First expiry, as a value of the built-in timer (see bmboot::getBuiltinTimerValue)
+    //! @param period Period in ticks of the built-in timer, or 0 for a one-shot timer
+    static void startAt(Timer& timer, uint64_t deadline, uint64_t period = 0);
+
+    //! Cancel a timer. Nothing happens if the timer is not active.
+    static void cancel(Timer& timer);
+
+    //! Convert a duration to ticks of the built-in timer, rounding up
+    static uint64_t toTicks(std::chrono::microseconds duration);
+
+private:
+    static void insert(Timer& timer);
+    static void remove(Timer& timer);
+    static void advance(uint64_t now);
+    static void reprogram();
+    static void handleIrq(void* context);
+};
+
+}
@@ -0,0 +1,290 @@
+//! @file
+//! @brief  Benchmark: interrupt latency of the payload runtime
+//! @author Martin Cejp
+//!
+//! Measures the time from an interrupt being signalled until its handler is entered, for
+//!  - the periodic interrupt (bmboot::setupPeriodicInterrupt), relative to its deadline in CNTP_CVAL_EL0,
+//!  - a software-generated interrupt sent by the core to itself, at each PayloadInterruptPriority,
+//!  - a shared peripheral interrupt set pending by software, at each PayloadInterruptPriority.
+//!
+//! The latencies are collected into histograms with a resolution of one tick of the built-in timer. The results are
+//! written to the standard output as JSON objects, one per line and short enough to not be split by the console of
+//! bmctl. Each case is described by several records, told apart by their keys and tied together by @c source and
+//! @c priority: the parameters, the summary statistics, the percentiles, and the occupied histogram bins as
+//! [ticks, count] pairs, spread over as many records as needed. All durations are in ticks, see @c timer_frequency.
+//!
+//! The console prefixes every line with the domain and a timestamp, which has to be stripped to get JSON Lines.
+//! To see the effect of memory traffic from the other cores, repeat the measurement with payload_memory_hog running
+//! on another domain:
+//!
+//!     bmctl run cpu1 payload_irq_latency_cpu1.bin | sed -u 's/^\[[^]]*\] //' > idle.jsonl
+//!     bmctl start cpu2 payload_memory_hog_cpu2.bin
+//!     bmctl run cpu1 payload_irq_latency_cpu1.bin | sed -u 's/^\[[^]]*\] //' > memory_hog.jsonl
+//!
+//! The benchmark prints {"done":true} when finished; @c bmctl @c run must then be interrupted.
+
+#include <bmboot/payload_runtime.hpp>
+
+#include "../../executor/armv8a.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+using bmboot::PayloadInterruptPriority;
+
+// Number of latencies collected per case; the periodic interrupt case takes NUM_SAMPLES * TIMER_PERIOD
+static constexpr uint32_t NUM_SAMPLES = 1'000'000;
+
+// Latencies measured before this many interrupts have been taken are discarded (cold caches, branch predictors)
+static constexpr uint32_t NUM_WARMUP_SAMPLES = 1'000;
+
+static constexpr auto TIMER_PERIOD = std::chrono::microseconds(20);
+
+// SGIs are private to each core, so any of them will do
+static constexpr int SGI_INTERRUPT_ID = 0;
+
+// PL_PS_IRQ1[7] (UG1085, Table 13-1: System Interrupts); nothing may drive it while the benchmark is running
+static constexpr int SPI_INTERRUPT_ID = 143;
+
+static constexpr int TIMER_INTERRUPT_ID = 30;
+
+// Longest line written, including the newline; bmboot::Console splits lines of 160 bytes and more
+static constexpr size_t MAX_RECORD_LENGTH = 150;
+
+static constexpr struct
+{
+    PayloadInterruptPriority priority;
+    char const* name;
+}
+ALL_PRIORITIES[] = {
+    { PayloadInterruptPriority::p7_max, "p7_max" },
+    { PayloadInterruptPriority::p6, "p6" },
+    { PayloadInterruptPriority::p5, "p5" },
+    { PayloadInterruptPriority::p4, "p4" },
+    { PayloadInterruptPriority::p3, "p3" },
+    { PayloadInterruptPriority::p2, "p2" },
+    { PayloadInterruptPriority::p1, "p1" },
+    { PayloadInterruptPriority::p0_min, "p0_min" },
+};
+
+// Latencies at a resolution of one tick; anything longer than the last bin is only counted
+struct Histogram
+{
+    static constexpr size_t NUM_BINS = 4096;
+
+    uint32_t bins[NUM_BINS];
+    uint64_t overflow;
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+
+    void clear()
+    {
+        std::fill(std::begin(bins), std::end(bins), 0);
+        overflow = 0;
+        count = 0;
+        total = 0;
+        min = UINT64_MAX;
+        max = 0;
+    }
+
+    void add(uint64_t ticks)
+    {
+        if (ticks < NUM_BINS)
+        {
+            bins[ticks]++;
+        }
+        else
+        {
+            overflow++;
+        }
+
+        count++;
+        total += ticks;
+        min = std::min(min, ticks);
+        max = std::max(max, ticks);
+    }
+
+    // Smallest latency that is not exceeded by the given fraction of samples
+    uint64_t getPercentile(double fraction) const
+    {
+        auto threshold = (uint64_t) (fraction * count);
+        uint64_t cumulative = 0;
+
+        for (size_t ticks = 0; ticks < NUM_BINS; ticks++)
+        {
+            cumulative += bins[ticks];
+
+            if (cumulative > threshold)
+            {
+                return ticks;
+            }
+        }
+
+        return max;
+    }
+};
+
+static Histogram histogram;
+
+// Interrupts taken in the current case, including the warm-up ones
+static volatile uint32_t num_interrupts;
+
+// Built-in timer value just before an interrupt was raised by software
+static volatile uint64_t trigger_ticks;
+
+// ************************************************************
+
+static void recordLatency(uint64_t ticks)
+{
+    if (num_interrupts >= NUM_WARMUP_SAMPLES && histogram.count < NUM_SAMPLES)
+    {
+        histogram.add(ticks);
+    }
+
+    num_interrupts = num_interrupts + 1;
+}
+
+static void onTimerInterrupt(void* context)
+{
+    // The runtime only moves the deadline forward once we return, so it still says when the interrupt was due
+    auto now = bmboot::getBuiltinTimerValue();
+    recordLatency(now - readSysReg(CNTP_CVAL_EL0));
+}
+
+static void onSoftwareInterrupt(void* context)
+{
+    recordLatency(bmboot::getBuiltinTimerValue() - trigger_ticks);
+}
+
+// ************************************************************
+
+static void printResults(char const* source, int interrupt_id, char const* priority_name)
+{
+    char key[48];
+    snprintf(key, sizeof(key), "\"source\":\"%s\",\"priority\":\"%s\"", source, priority_name);
+
+    printf("{%s,\"interrupt_id\":%d,\"cpu\":%d,\"timer_frequency\":%u,\"samples\":%llu}\n",
+           key, interrupt_id, bmboot::getCpuIndex(), bmboot::getBuiltinTimerFrequency(),
+           (unsigned long long) histogram.count);
+
+    printf("{%s,\"min\":%llu,\"mean\":%.2f,\"max\":%llu,\"overflow\":%llu}\n",
+           key,
+           (unsigned long long) histogram.min,
+           histogram.count ? (double) histogram.total / histogram.count : 0.0,
+           (unsigned long long) histogram.max,
+           (unsigned long long) histogram.overflow);
+
+    printf("{%s,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu}\n",
+           key,
+           (unsigned long long) histogram.getPercentile(0.5),
+           (unsigned long long) histogram.getPercentile(0.99),
+           (unsigned long long) histogram.getPercentile(0.999));
+
+    // Only the occupied bins, as [ticks, count] pairs, as many per record as fit
+    static constexpr char const* END_OF_RECORD = "]}\n";
+
+    char record[MAX_RECORD_LENGTH + 1];
+    size_t header_length = snprintf(record, sizeof(record), "{%s,\"bins\":[", key);
+    size_t length = header_length;
+
+    for (size_t ticks = 0; ticks < Histogram::NUM_BINS; ticks++)
+    {
+        if (histogram.bins[ticks] == 0)
+        {
+            continue;
+        }
+
+        char pair[32];
+        size_t pair_length = snprintf(pair, sizeof(pair), "%s[%zu,%u]", (length > header_length) ? "," : "",
+                                      ticks, (unsigned) histogram.bins[ticks]);
+
+        if (length + pair_length + strlen(END_OF_RECORD) > MAX_RECORD_LENGTH)
+        {
+            printf("%.*s%s", (int) length, record, END_OF_RECORD);
+
+            length = header_length;
+            pair_length = snprintf(pair, sizeof(pair), "[%zu,%u]", ticks, (unsigned) histogram.bins[ticks]);
+        }
+
+        memcpy(record + length, pair, pair_length);
+        length += pair_length;
+    }
+
+    if (length > header_length)
+    {
+        printf("%.*s%s", (int) length, record, END_OF_RECORD);
+    }
+}
+
+// ************************************************************
+
+static void measurePeriodicInterrupt()
+{
+    histogram.clear();
+    num_interrupts = 0;
+
+    bmboot::setupPeriodicInterrupt(TIMER_PERIOD, onTimerInterrupt, nullptr);
+    bmboot::startPeriodicInterrupt();
+
+    while (histogram.count < NUM_SAMPLES)
+    {
+        arm::armv8a::waitForInterrupt();
+    }
+
+    bmboot::stopPeriodicInterrupt();
+
+    // The priority is fixed by the runtime
+    printResults("timer", TIMER_INTERRUPT_ID, "p7_max");
+}
+
+static void measureSoftwareInterrupt(char const* source, int interrupt_id)
+{
+    for (auto const& [priority, priority_name] : ALL_PRIORITIES)
+    {
+        histogram.clear();
+        num_interrupts = 0;
+
+        bmboot::setupInterruptHandling(interrupt_id, priority, onSoftwareInterrupt, nullptr);
+        bmboot::enableInterruptHandling(interrupt_id);
+
+        // One interrupt at a time, so that each one finds the core idle (but not asleep)
+        while (histogram.count < NUM_SAMPLES)
+        {
+            auto num_before = num_interrupts;
+
+            trigger_ticks = bmboot::getBuiltinTimerValue();
+            bmboot::raiseInterrupt(interrupt_id);
+
+            while (num_interrupts == num_before)
+            {
+            }
+        }
+
+        bmboot::disableInterruptHandling(interrupt_id);
+
+        printResults(source, interrupt_id, priority_name);
+    }
+}
+
+// ************************************************************
+
+int main()
+{
+    bmboot::notifyPayloadStarted();
+
+    measurePeriodicInterrupt();
+    measureSoftwareInterrupt("sgi", SGI_INTERRUPT_ID);
+    measureSoftwareInterrupt("spi", SPI_INTERRUPT_ID);
+
+    printf("{\"done\":true}\n");
+
+    for (;;)
+    {
+        bmboot::idle();
+    }
+}
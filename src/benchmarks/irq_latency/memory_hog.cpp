@@ -0,0 +1,37 @@
+//! @file
+//! @brief  Benchmark companion: keeps the memory system busy from another core
+//! @author Martin Cejp
+//!
+//! Streams through a buffer much larger than the L2 cache, dirtying every cache line, so that the DDR controller and
+//! the shared L2 see continuous read and write-back traffic. Meant to run on a domain other than the one being
+//! measured, e.g. together with payload_irq_latency (see there). Runs until the domain is reset.
+
+#include <bmboot/payload_runtime.hpp>
+
+#include <cstdio>
+
+// 8x the L2 cache of the Cortex-A53 cluster
+static constexpr size_t BUFFER_SIZE = 8 * 1024 * 1024;
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+static uint64_t buffer[BUFFER_SIZE / sizeof(uint64_t)];
+
+int main()
+{
+    bmboot::notifyPayloadStarted();
+
+    printf("memory hog: streaming through %zu KiB\n", BUFFER_SIZE / 1024);
+
+    // volatile, since the loop never ends and nothing ever looks at the result
+    auto data = (uint64_t volatile*) buffer;
+
+    for (uint64_t round = 0; ; round++)
+    {
+        // One read-modify-write per cache line: a refill, and later a write-back of the dirty line
+        for (size_t i = 0; i < BUFFER_SIZE / sizeof(uint64_t); i += CACHE_LINE_SIZE / sizeof(uint64_t))
+        {
+            data[i] = data[i] + round;
+        }
+    }
+}
@@ -0,0 +1,151 @@
+//! @file
+//! @brief  Host benchmark: draining the stdout ring per-byte vs. in bulk
+//! @author Martin Cejp
+//!
+//! The executor side is simulated by a plain in-memory ring, so this measures the CPU cost of the manager-side access
+//! pattern only. On the target, where every access to the ring goes through an uncached @c /dev/mem mapping, the gap
+//! between the two paths is considerably wider.
+
+#include "../../manager/stdout_ring.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace bmboot::internal;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+static constexpr size_t RING_CAPACITY = 1024;
+static constexpr int DEFAULT_ROUNDS = 200'000;
+
+static char ring_buf[RING_CAPACITY];
+static size_t ring_wrpos;
+static size_t ring_rdpos;
+static size_t line_pos;
+
+static StdoutRingView const ring { ring_buf, RING_CAPACITY, &ring_wrpos, &ring_rdpos };
+
+// ************************************************************
+
+// Emulate the executor: fill the ring (as much as it will take) with newline-terminated lines of text
+static size_t produce()
+{
+    static char const line[] = "[  12.345] control loop: iteration 123456, error -0.00123, output 4.56789\n";
+
+    size_t produced = 0;
+
+    for (;;)
+    {
+        auto wrpos_new = (ring_wrpos + 1) % RING_CAPACITY;
+
+        if (wrpos_new == ring_rdpos)
+        {
+            return produced;
+        }
+
+        ring_buf[ring_wrpos] = line[line_pos];
+        ring_wrpos = wrpos_new;
+        line_pos = (line_pos + 1) % (sizeof(line) - 1);
+        produced++;
+    }
+}
+
+template <typename DrainFunc>
+static void doTest(char const* test_name, int rounds, DrainFunc drain)
+{
+    ring_wrpos = ring_rdpos = line_pos = 0;
+
+    size_t total_bytes = 0;
+    size_t checksum = 0;
+    duration<double> elapsed {};
+
+    for (int i = 0; i < rounds; i++)
+    {
+        auto produced = produce();
+
+        // only the drain is timed; the producer is the same for all tests
+        auto start = steady_clock::now();
+        auto consumed = drain(checksum);
+        elapsed += steady_clock::now() - start;
+
+        if (consumed != produced)
+        {
+            fprintf(stderr, "%s: consumed %zu bytes, expected %zu\n", test_name, consumed, produced);
+            exit(-1);
+        }
+
+        total_bytes += consumed;
+    }
+
+    printf("%-20s %8.3f ns/byte %10.1f MB/s (checksum %zx)\n",
+           test_name,
+           elapsed.count() * 1e9 / total_bytes,
+           total_bytes / elapsed.count() / 1e6,
+           checksum);
+}
+
+static size_t sum(char const* data, size_t length)
+{
+    size_t checksum = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        checksum += (unsigned char) data[i];
+    }
+
+    return checksum;
+}
+
+// ************************************************************
+
+int main(int argc, char** argv)
+{
+    int rounds = (argc >= 2) ? atoi(argv[1]) : DEFAULT_ROUNDS;
+
+    doTest("getchar", rounds, [](size_t& checksum)
+    {
+        size_t consumed = 0;
+
+        for (int c; (c = stdoutRingGetchar(ring)) >= 0; consumed++)
+        {
+            checksum += c;
+        }
+
+        return consumed;
+    });
+
+    doTest("readStdout", rounds, [](size_t& checksum)
+    {
+        char buffer[RING_CAPACITY];
+        auto consumed = stdoutRingRead(ring, buffer);
+
+        checksum += sum(buffer, consumed);
+        return consumed;
+    });
+
+    doTest("readStdoutLine", rounds, [](size_t& checksum)
+    {
+        char buffer[160];
+        size_t consumed = 0;
+
+        for (;;)
+        {
+            auto length = stdoutRingReadLine(ring, buffer);
+
+            if (length == 0)
+            {
+                length = stdoutRingRead(ring, buffer);
+            }
+
+            if (length == 0)
+            {
+                return consumed;
+            }
+
+            checksum += sum(buffer, length);
+            consumed += length;
+        }
+    });
+}
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <cstdlib>
 
+#include "bmboot.hpp"
 #include "bmboot_memmap.hpp"
 #include "cpu_state.hpp"
 
@@ -23,9 +24,25 @@ constexpr inline Cookie MONITOR_CODE_COOKIE = 0x7150ABCD;
 constexpr inline int GIC_MIN_USER_INTERRUPT_ID = 0;
 constexpr inline int GIC_MAX_USER_INTERRUPT_ID = 187;
 
+// Maximum number of memory ranges that the manager can report as written when starting a payload
+constexpr inline int MAX_PAYLOAD_SEGMENTS = 8;
+
+// Maximum number of PMU event counters that can be programmed by the monitor on behalf of the manager
+constexpr inline int MAX_PERF_EVENTS = 6;
+
+// Meaning of an IPI from the manager, as indicated by IpcBlock::manager_to_executor::ipi_request
 enum
 {
     IPI_REQ_KILL = 0x01,            // request to kill the payload & return to 'ready' state
+    IPI_REQ_SNAPSHOT = 0x02,        // request to park the payload and capture its registers for a snapshot
+    IPI_REQ_PROFILE = 0x03,         // request to apply the profiler settings from ProfileRingHeader
+    IPI_REQ_PERF = 0x04,            // request to apply the perf counter settings from IpcBlock::manager_to_executor
+};
+
+enum SnapshotResult
+{
+    snapshot_parked,                // registers captured, payload waiting for the manager to release it
+    snapshot_declined,              // there was no running payload to capture
 };
 
 enum {
@@ -53,6 +70,12 @@ enum Response
     abi_incompatible,
 };
 
+struct MemoryRange
+{
+    uintptr_t address;
+    size_t size;
+};
+
 // zeroed in bmboot::startup_domain
 struct IpcBlock
 {
@@ -69,7 +92,23 @@ struct IpcBlock
         uint32_t payload_crc;
         uintptr_t payload_argument;
 
-        size_t stdout_rdpos;
+        uint32_t notify_ipi_mask;   // IPI peer mask to signal on state change/command ack; 0 = none
+
+        // Memory written by the manager when loading the payload. The monitor performs cache maintenance for exactly
+        // these ranges; if there are none (or too many), it falls back to invalidating the entire I-cache.
+        uint32_t num_payload_segments;
+        MemoryRange payload_segments[MAX_PAYLOAD_SEGMENTS];
+
+        uint32_t clock_sample_seq;  // incremented by the manager to request a sample of CNTPCT_EL0
+
+        uint32_t ipi_request;       // IPI_REQ_*; anything else is treated as IPI_REQ_KILL
+        uint32_t snapshot_seq;      // incremented by the manager along with sending IPI_REQ_SNAPSHOT
+        uint32_t snapshot_release;  // set to snapshot_seq by the manager to let the payload continue
+
+        uint32_t perf_enabled;      // whether the monitor should count PMU events (picked up on IPI_REQ_PERF)
+        uint32_t perf_num_events;
+        uint16_t perf_events[MAX_PERF_EVENTS];
+        uint32_t perf_request_seq;  // incremented by the manager after changing the settings above
     }
     manager_to_executor;
 
@@ -87,15 +126,190 @@ struct IpcBlock
         Aarch64_Regs regs;
         Aarch64_FpRegs fpregs;
 
-        // standard output (circular buffer)
-        size_t stdout_wrpos;
-        char stdout_buf[1024];
+        uint64_t clock_sample_counter;  // CNTPCT_EL0 sampled when answering the request
+        uint32_t clock_sample_freq;     // CNTFRQ_EL0
+        uint32_t clock_sample_ack;      // equal to clock_sample_seq once the above are valid
+
+        SnapshotResult snapshot_result;
+        uint32_t snapshot_ack;          // equal to snapshot_seq once the result (and registers) are valid
+        Aarch64_Regs snapshot_regs;
+        Aarch64_FpRegs snapshot_fpregs;
+
+        // PMU counter values, updated periodically by the monitor under a sequence lock
+        uint32_t perf_seq;              // odd while the values below are being updated
+        uint32_t perf_active;           // 0 if the monitor is not counting
+        uint32_t perf_request_ack;      // perf_request_seq of the settings that the values below follow
+        uint32_t perf_num_events;
+        uint32_t perf_timer_freq;       // CNTFRQ_EL0
+        uint64_t perf_timestamp;        // CNTPCT_EL0 at the time of the update
+        uint64_t perf_cycles;
+        uint64_t perf_events[MAX_PERF_EVENTS];
     }
     executor_to_manager;
 };
 
+enum class StdoutOverflowMode : uint32_t
+{
+    drop = 0,
+    block = 1,
+};
+
+// The executor waits at EL3 or with interrupts masked, so the wait must stay short even if the manager dies
+constexpr uint32_t MAX_STDOUT_BLOCK_TIMEOUT_US = 10'000;
+
+// Standard output ring, placed at the start of the bmboot_cpuN_stdout region and followed by the buffer.
+// Positions are byte offsets; the ring is empty when they are equal, so at most (capacity - 1) bytes are pending.
+// Zeroed by the manager when the monitor is started.
+struct StdoutRingHeader
+{
+    alignas(64) size_t wrpos;           // owned by the executor
+    uint64_t dropped_bytes;             // owned by the executor; bytes discarded because the ring was full
+
+    alignas(64) size_t rdpos;           // owned by the manager
+    StdoutOverflowMode overflow_mode;   // owned by the manager
+    uint32_t block_timeout_us;          // owned by the manager; only for StdoutOverflowMode::block
+};
+
+static_assert(sizeof(StdoutRingHeader) == 128);
+
+constexpr size_t getStdoutRingCapacity(size_t region_size)
+{
+    return region_size - sizeof(StdoutRingHeader);
+}
+
+// Telemetry ring, placed at the start of the bmboot_cpuN_telemetry region and followed by the record slots.
+// Positions are slot indices; the ring is empty when they are equal, so at most (capacity - 1) records are pending.
+// The executor and manager-owned parts are kept in separate cache lines.
+struct TelemetryRingHeader
+{
+    alignas(64) uint32_t wrpos;         // owned by the executor
+    uint32_t dropped;                   // owned by the executor; number of records discarded because the ring was full
+
+    alignas(64) uint32_t rdpos;         // owned by the manager
+};
+
+static_assert(sizeof(TelemetryRingHeader) == 128);
+
+constexpr size_t getTelemetryRingCapacity(size_t region_size)
+{
+    return (region_size - sizeof(TelemetryRingHeader)) / sizeof(TelemetryRecord);
+}
+
+// Log ring, placed at the start of the bmboot_cpuN_log region and followed by the record slots.
+// Same protocol as the telemetry ring; in addition, the manager controls which messages are logged at all.
+struct LogRingHeader
+{
+    alignas(64) uint32_t wrpos;         // owned by the executor
+    uint32_t dropped;                   // owned by the executor; number of records discarded because the ring was full
+
+    alignas(64) uint32_t rdpos;         // owned by the manager
+    LogLevel level;                     // owned by the manager; messages less severe than this are not logged
+};
+
+static_assert(sizeof(LogRingHeader) == 128);
+
+constexpr size_t getLogRingCapacity(size_t region_size)
+{
+    return (region_size - sizeof(LogRingHeader)) / sizeof(LogRecord);
+}
+
+// Profile sample ring, placed at the start of the bmboot_cpuN_profile region and followed by the sample slots.
+// Same protocol as the telemetry ring, except that the producer is the monitor. The manager-owned part also holds
+// the profiler settings, which the monitor picks up when asked to through IPI_REQ_PROFILE, and whenever it starts.
+struct ProfileRingHeader
+{
+    alignas(64) uint32_t wrpos;         // owned by the monitor
+    uint32_t dropped;                   // owned by the monitor; number of samples discarded because the ring was full
+
+    alignas(64) uint32_t rdpos;         // owned by the manager
+    uint32_t interval_ticks;            // owned by the manager; mean sampling interval in timer ticks, 0 = off
+    uint32_t max_stack_depth;           // owned by the manager; at most ProfileSample::MAX_FRAMES
+};
+
+static_assert(sizeof(ProfileRingHeader) == 128);
+
+constexpr size_t getProfileRingCapacity(size_t region_size)
+{
+    return (region_size - sizeof(ProfileRingHeader)) / sizeof(ProfileSample);
+}
+
+// Statistics of one interrupt ID, or of the latency of the periodic interrupt
+struct IrqStatsRecord
+{
+    uint32_t seq;                       // odd while the record is being updated
+    uint32_t generation;                // IrqStatsBlock::generation as of the last update; older records count as empty
+    TickHistogram histogram;
+};
+
+// Interrupt statistics, placed in the bmboot_cpuN_irq_stats region. They are only collected by a payload runtime built
+// with BMBOOT_IRQ_STATS. The payload updates each record with IRQs masked, under the record's sequence lock.
+// Zeroed by the manager before starting a payload.
+struct IrqStatsBlock
+{
+    alignas(64) uint32_t instrumented;  // owned by the payload; non-zero if statistics are being collected
+    IrqStatsRecord timer_latency;       // owned by the payload; CNTP_CVAL_EL0 to IRQ entry, in ticks
+
+    alignas(64) uint32_t generation;    // owned by the manager; incremented to discard all statistics so far
+
+    // Owned by the payload; time spent in the handler of each user interrupt ID, in ticks
+    alignas(64) IrqStatsRecord interrupts[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
+};
+
+// A task of the payload's bmboot::Scheduler, as seen by the manager
+struct SchedulerTaskRecord
+{
+    uint32_t seq;                       // odd while the record is being updated
+    uint32_t generation;                // SchedulerBlock::generation as of the last update; older statistics count as 0
+
+    // Configuration, written by Scheduler::start before num_tasks is published
+    char name[32];
+    uint64_t period;                    // in ticks
+    uint64_t offset;                    // in ticks
+    uint32_t priority;                  // PayloadInterruptPriority at which the task executes
+    uint32_t reserved;
+
+    TaskStatistics statistics;
+};
+
+// Statistics of the payload's bmboot::Scheduler, placed in the bmboot_cpuN_scheduler region.
+// Zeroed by the manager before starting a payload.
+struct SchedulerBlock
+{
+    static constexpr size_t MAX_TASKS = 16;
+
+    alignas(64) uint32_t num_tasks;     // owned by the payload; 0 until the scheduler has been started
+
+    alignas(64) uint32_t generation;    // owned by the manager; incremented to discard all statistics so far
+
+    alignas(64) SchedulerTaskRecord tasks[MAX_TASKS];   // owned by the payload
+};
+
 static_assert(sizeof(IpcBlock) <= bmboot_cpu1_monitor_ipc_SIZE);
 static_assert(sizeof(IpcBlock) <= bmboot_cpu2_monitor_ipc_SIZE);
 static_assert(sizeof(IpcBlock) <= bmboot_cpu3_monitor_ipc_SIZE);
 
+static_assert(getStdoutRingCapacity(bmboot_cpu1_stdout_SIZE) >= 256);
+static_assert(getStdoutRingCapacity(bmboot_cpu2_stdout_SIZE) >= 256);
+static_assert(getStdoutRingCapacity(bmboot_cpu3_stdout_SIZE) >= 256);
+
+static_assert(getTelemetryRingCapacity(bmboot_cpu1_telemetry_SIZE) >= 2);
+static_assert(getTelemetryRingCapacity(bmboot_cpu2_telemetry_SIZE) >= 2);
+static_assert(getTelemetryRingCapacity(bmboot_cpu3_telemetry_SIZE) >= 2);
+
+static_assert(getLogRingCapacity(bmboot_cpu1_log_SIZE) >= 2);
+static_assert(getLogRingCapacity(bmboot_cpu2_log_SIZE) >= 2);
+static_assert(getLogRingCapacity(bmboot_cpu3_log_SIZE) >= 2);
+
+static_assert(getProfileRingCapacity(bmboot_cpu1_profile_SIZE) >= 2);
+static_assert(getProfileRingCapacity(bmboot_cpu2_profile_SIZE) >= 2);
+static_assert(getProfileRingCapacity(bmboot_cpu3_profile_SIZE) >= 2);
+
+static_assert(sizeof(IrqStatsBlock) <= bmboot_cpu1_irq_stats_SIZE);
+static_assert(sizeof(IrqStatsBlock) <= bmboot_cpu2_irq_stats_SIZE);
+static_assert(sizeof(IrqStatsBlock) <= bmboot_cpu3_irq_stats_SIZE);
+
+static_assert(sizeof(SchedulerBlock) <= bmboot_cpu1_scheduler_SIZE);
+static_assert(sizeof(SchedulerBlock) <= bmboot_cpu2_scheduler_SIZE);
+static_assert(sizeof(SchedulerBlock) <= bmboot_cpu3_scheduler_SIZE);
+
 }
@@ -6,17 +6,53 @@
 #define bmboot_cpu1_monitor_SIZE         0x00010000
 #define bmboot_cpu1_monitor_ipc_ADDRESS  0x800030000
 #define bmboot_cpu1_monitor_ipc_SIZE     0x00004000
+#define bmboot_cpu1_scheduler_ADDRESS    0x80003C000
+#define bmboot_cpu1_scheduler_SIZE       0x00001000
+#define bmboot_cpu1_telemetry_ADDRESS    0x800040000
+#define bmboot_cpu1_telemetry_SIZE       0x00010000
+#define bmboot_cpu1_stdout_ADDRESS       0x800070000
+#define bmboot_cpu1_stdout_SIZE          0x00008000
+#define bmboot_cpu1_log_ADDRESS          0x800090000
+#define bmboot_cpu1_log_SIZE             0x00010000
+#define bmboot_cpu1_profile_ADDRESS      0x8000C0000
+#define bmboot_cpu1_profile_SIZE         0x00010000
+#define bmboot_cpu1_irq_stats_ADDRESS    0x8000F0000
+#define bmboot_cpu1_irq_stats_SIZE       0x00005000
 #define bmboot_cpu1_payload_ADDRESS      0x800100000
 #define bmboot_cpu1_payload_SIZE         0x02000000
 #define bmboot_cpu2_monitor_ADDRESS      0x800010000
 #define bmboot_cpu2_monitor_SIZE         0x00010000
 #define bmboot_cpu2_monitor_ipc_ADDRESS  0x800034000
 #define bmboot_cpu2_monitor_ipc_SIZE     0x00004000
+#define bmboot_cpu2_scheduler_ADDRESS    0x80003D000
+#define bmboot_cpu2_scheduler_SIZE       0x00001000
+#define bmboot_cpu2_telemetry_ADDRESS    0x800050000
+#define bmboot_cpu2_telemetry_SIZE       0x00010000
+#define bmboot_cpu2_stdout_ADDRESS       0x800078000
+#define bmboot_cpu2_stdout_SIZE          0x00008000
+#define bmboot_cpu2_log_ADDRESS          0x8000A0000
+#define bmboot_cpu2_log_SIZE             0x00010000
+#define bmboot_cpu2_profile_ADDRESS      0x8000D0000
+#define bmboot_cpu2_profile_SIZE         0x00010000
+#define bmboot_cpu2_irq_stats_ADDRESS    0x8000F5000
+#define bmboot_cpu2_irq_stats_SIZE       0x00005000
 #define bmboot_cpu2_payload_ADDRESS      0x802100000
 #define bmboot_cpu2_payload_SIZE         0x02000000
 #define bmboot_cpu3_monitor_ADDRESS      0x800020000
 #define bmboot_cpu3_monitor_SIZE         0x00010000
 #define bmboot_cpu3_monitor_ipc_ADDRESS  0x800038000
 #define bmboot_cpu3_monitor_ipc_SIZE     0x00004000
+#define bmboot_cpu3_scheduler_ADDRESS    0x80003E000
+#define bmboot_cpu3_scheduler_SIZE       0x00001000
+#define bmboot_cpu3_telemetry_ADDRESS    0x800060000
+#define bmboot_cpu3_telemetry_SIZE       0x00010000
+#define bmboot_cpu3_stdout_ADDRESS       0x800080000
+#define bmboot_cpu3_stdout_SIZE          0x00008000
+#define bmboot_cpu3_log_ADDRESS          0x8000B0000
+#define bmboot_cpu3_log_SIZE             0x00010000
+#define bmboot_cpu3_profile_ADDRESS      0x8000E0000
+#define bmboot_cpu3_profile_SIZE         0x00010000
+#define bmboot_cpu3_irq_stats_ADDRESS    0x8000FA000
+#define bmboot_cpu3_irq_stats_SIZE       0x00005000
 #define bmboot_cpu3_payload_ADDRESS      0x804100000
 #define bmboot_cpu3_payload_SIZE         0x02000000
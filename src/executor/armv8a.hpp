@@ -17,9 +17,63 @@ namespace arm::armv8a
     static constexpr inline uint32_t DAIF_A_MASK =  (1<<8);
     static constexpr inline uint32_t DAIF_D_MASK =  (1<<9);
 
+    static constexpr inline uint32_t CNTP_CTL_ISTATUS = (1<<2);
+
+    // PMCR_EL0 fields
+    static constexpr inline uint64_t PMCR_E = (1<<0);           // enable
+    static constexpr inline uint64_t PMCR_P = (1<<1);           // reset event counters
+    static constexpr inline uint64_t PMCR_C = (1<<2);           // reset cycle counter
+    static constexpr inline uint64_t PMCR_DP = (1<<5);          // stop the cycle counter where events are not counted
+    static constexpr inline uint64_t PMCR_LC = (1<<6);          // 64-bit cycle counter
+    static constexpr inline int PMCR_N_SHIFT = 11;              // number of event counters implemented
+    static constexpr inline uint64_t PMCR_N_MASK = 0x1f;
+
+    // PMEVTYPER<n>_EL0 and PMCCFILTR_EL0: M != P excludes EL3
+    static constexpr inline uint64_t PMEVTYPER_M = (1<<26);
+
+    // Bit of the cycle counter in PMCNTENSET_EL0, PMOVSCLR_EL0 etc.
+    static constexpr inline uint64_t PMU_CYCLE_COUNTER_BIT = (1ull<<31);
+
+    // Number of event counters on the Cortex-A53, and thus the number of cases below
+    static constexpr inline int PMU_NUM_EVENT_COUNTERS = 6;
+
+    // The counter index is part of the register name, so there is no way around a switch
+    inline uint64_t readEventCounter(int counter)
+    {
+        switch (counter)
+        {
+            case 0: return readSysReg(PMEVCNTR0_EL0);
+            case 1: return readSysReg(PMEVCNTR1_EL0);
+            case 2: return readSysReg(PMEVCNTR2_EL0);
+            case 3: return readSysReg(PMEVCNTR3_EL0);
+            case 4: return readSysReg(PMEVCNTR4_EL0);
+            case 5: return readSysReg(PMEVCNTR5_EL0);
+            default: return 0;
+        }
+    }
+
+    inline void writeEventType(int counter, uint64_t value)
+    {
+        switch (counter)
+        {
+            case 0: writeSysReg(PMEVTYPER0_EL0, value); break;
+            case 1: writeSysReg(PMEVTYPER1_EL0, value); break;
+            case 2: writeSysReg(PMEVTYPER2_EL0, value); break;
+            case 3: writeSysReg(PMEVTYPER3_EL0, value); break;
+            case 4: writeSysReg(PMEVTYPER4_EL0, value); break;
+            case 5: writeSysReg(PMEVTYPER5_EL0, value); break;
+        }
+    }
+
     inline void waitForInterrupt()
     {
         // Ensure all memory accesses have finished & put CPU core to sleep
         __asm__ __volatile__("dsb sy; wfi");
     }
+
+    inline void waitForEvent()
+    {
+        // Like waitForInterrupt, but also wakes up on an event (SEV) from another core
+        __asm__ __volatile__("dsb sy; wfe");
+    }
 }
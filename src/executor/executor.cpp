@@ -6,6 +6,8 @@
 #include "executor.hpp"
 #include "executor_asm.hpp"
 
+#include <cstring>
+
 using namespace bmboot;
 using namespace bmboot::internal;
 
@@ -25,3 +27,200 @@ IpcBlock& internal::getIpcBlock()
         default: abort();
     }
 }
+
+template <uintptr_t address, size_t size>
+static StdoutRegion makeStdoutRegion()
+{
+    return StdoutRegion {
+        .header = (StdoutRingHeader*) address,
+        .buf = (char*) (address + sizeof(StdoutRingHeader)),
+        .capacity = getStdoutRingCapacity(size),
+    };
+}
+
+StdoutRegion internal::getStdoutRegion()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return makeStdoutRegion<bmboot_cpu1_stdout_ADDRESS, bmboot_cpu1_stdout_SIZE>();
+        case 2: return makeStdoutRegion<bmboot_cpu2_stdout_ADDRESS, bmboot_cpu2_stdout_SIZE>();
+        case 3: return makeStdoutRegion<bmboot_cpu3_stdout_ADDRESS, bmboot_cpu3_stdout_SIZE>();
+        default: abort();
+    }
+}
+
+template <uintptr_t address, size_t size>
+static TelemetryRegion makeTelemetryRegion()
+{
+    return TelemetryRegion {
+        .header = (TelemetryRingHeader*) address,
+        .records = (TelemetryRecord*) (address + sizeof(TelemetryRingHeader)),
+        .capacity = getTelemetryRingCapacity(size),
+    };
+}
+
+TelemetryRegion internal::getTelemetryRegion()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return makeTelemetryRegion<bmboot_cpu1_telemetry_ADDRESS, bmboot_cpu1_telemetry_SIZE>();
+        case 2: return makeTelemetryRegion<bmboot_cpu2_telemetry_ADDRESS, bmboot_cpu2_telemetry_SIZE>();
+        case 3: return makeTelemetryRegion<bmboot_cpu3_telemetry_ADDRESS, bmboot_cpu3_telemetry_SIZE>();
+        default: abort();
+    }
+}
+
+template <uintptr_t address, size_t size>
+static LogRegion makeLogRegion()
+{
+    return LogRegion {
+        .header = (LogRingHeader*) address,
+        .records = (LogRecord*) (address + sizeof(LogRingHeader)),
+        .capacity = getLogRingCapacity(size),
+    };
+}
+
+LogRegion internal::getLogRegion()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return makeLogRegion<bmboot_cpu1_log_ADDRESS, bmboot_cpu1_log_SIZE>();
+        case 2: return makeLogRegion<bmboot_cpu2_log_ADDRESS, bmboot_cpu2_log_SIZE>();
+        case 3: return makeLogRegion<bmboot_cpu3_log_ADDRESS, bmboot_cpu3_log_SIZE>();
+        default: abort();
+    }
+}
+
+template <uintptr_t address, size_t size>
+static ProfileRegion makeProfileRegion()
+{
+    return ProfileRegion {
+        .header = (ProfileRingHeader*) address,
+        .samples = (ProfileSample*) (address + sizeof(ProfileRingHeader)),
+        .capacity = getProfileRingCapacity(size),
+    };
+}
+
+ProfileRegion internal::getProfileRegion()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return makeProfileRegion<bmboot_cpu1_profile_ADDRESS, bmboot_cpu1_profile_SIZE>();
+        case 2: return makeProfileRegion<bmboot_cpu2_profile_ADDRESS, bmboot_cpu2_profile_SIZE>();
+        case 3: return makeProfileRegion<bmboot_cpu3_profile_ADDRESS, bmboot_cpu3_profile_SIZE>();
+        default: abort();
+    }
+}
+
+IrqStatsBlock& internal::getIrqStatsBlock()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return *(IrqStatsBlock*) bmboot_cpu1_irq_stats_ADDRESS;
+        case 2: return *(IrqStatsBlock*) bmboot_cpu2_irq_stats_ADDRESS;
+        case 3: return *(IrqStatsBlock*) bmboot_cpu3_irq_stats_ADDRESS;
+        default: abort();
+    }
+}
+
+SchedulerBlock& internal::getSchedulerBlock()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return *(SchedulerBlock*) bmboot_cpu1_scheduler_ADDRESS;
+        case 2: return *(SchedulerBlock*) bmboot_cpu2_scheduler_ADDRESS;
+        case 3: return *(SchedulerBlock*) bmboot_cpu3_scheduler_ADDRESS;
+        default: abort();
+    }
+}
+
+void internal::answerClockSampleRequest()
+{
+    auto& ipc_block = (volatile IpcBlock&) getIpcBlock();
+    auto seq = ipc_block.manager_to_executor.clock_sample_seq;
+
+    if (seq == ipc_block.executor_to_manager.clock_sample_ack)
+    {
+        return;
+    }
+
+    // The ISB keeps the counter read from being performed early (see bmboot::getBuiltinTimerValue)
+    __asm__ volatile("isb" ::: "memory");
+    ipc_block.executor_to_manager.clock_sample_counter = readSysReg(CNTPCT_EL0);
+    ipc_block.executor_to_manager.clock_sample_freq = readSysReg(CNTFRQ_EL0);
+
+    memory_write_reorder_barrier();
+    ipc_block.executor_to_manager.clock_sample_ack = seq;
+}
+
+size_t internal::writeToStdoutRing(char const* data, size_t size)
+{
+    auto ring = getStdoutRegion();
+    auto& header = *ring.header;
+
+    // Here we want to be very conservative to be absolutely certain we will not overflow the buffer
+    if (header.wrpos >= ring.capacity) {
+        header.wrpos = 0;
+
+        // printf bloats the monitor binary too much, so we cannot easily report the observed value
+        char const message[] = "unexpected dom_stdout_wrpos, reset to 0\n";
+        writeToStdoutRing(message, sizeof(message) - 1);
+    }
+
+    auto data_bytes = data;
+    auto requested = size;
+
+    uint64_t deadline = 0;
+
+    while (size > 0) {
+        auto wrpos = header.wrpos;
+        auto rdpos = __atomic_load_n(&header.rdpos, __ATOMIC_ACQUIRE);
+
+        if (rdpos >= ring.capacity) {
+            // The manager will reset its read position by itself; until then, treat the buffer as full
+            rdpos = (wrpos + 1) % ring.capacity;
+        }
+
+        auto space = (rdpos > wrpos) ? (rdpos - wrpos - 1) : (ring.capacity - wrpos + rdpos - 1);
+
+        if (space == 0) {
+            if (header.overflow_mode == StdoutOverflowMode::block) {
+                auto now = readSysReg(CNTPCT_EL0);
+
+                if (deadline == 0) {
+                    // Do not trust the manager-owned value blindly: a long spin would stall the entire core
+                    auto timeout_us = (header.block_timeout_us < MAX_STDOUT_BLOCK_TIMEOUT_US) ? header.block_timeout_us
+                                                                               : MAX_STDOUT_BLOCK_TIMEOUT_US;
+                    deadline = now + (uint64_t) timeout_us * readSysReg(CNTFRQ_EL0) / 1'000'000;
+                }
+
+                if (now < deadline) {
+                    continue;
+                }
+            }
+
+            // Buffer full, abort!
+            // However, we must lie about number of characters written, otherwise stdout error flag will be set and
+            // printf will refuse to print any more
+            // (on a non-rt OS, a write to clogged stdout would just block instead)
+            // At least we keep count, so that the loss can be detected by the manager.
+            header.dropped_bytes += size;
+            break;
+        }
+
+        // Copy as much as fits, in (at most) two contiguous runs
+        auto chunk = (size < space) ? size : space;
+        auto first_run = (chunk < ring.capacity - wrpos) ? chunk : (ring.capacity - wrpos);
+
+        memcpy(ring.buf + wrpos, data_bytes, first_run);
+        memcpy(ring.buf, data_bytes + first_run, chunk - first_run);
+
+        // Publish the data only once it has been written
+        __atomic_store_n(&header.wrpos, (wrpos + chunk) % ring.capacity, __ATOMIC_RELEASE);
+
+        data_bytes += chunk;
+        size -= chunk;
+    }
+
+    return requested;
+}
@@ -9,7 +9,48 @@
 namespace bmboot::internal
 {
 
+struct StdoutRegion
+{
+    StdoutRingHeader* header;
+    char* buf;
+    size_t capacity;
+};
+
+struct TelemetryRegion
+{
+    TelemetryRingHeader* header;
+    TelemetryRecord* records;
+    size_t capacity;
+};
+
+struct LogRegion
+{
+    LogRingHeader* header;
+    LogRecord* records;
+    size_t capacity;
+};
+
+struct ProfileRegion
+{
+    ProfileRingHeader* header;
+    ProfileSample* samples;
+    size_t capacity;
+};
+
 int getCpuIndex();
 IpcBlock& getIpcBlock();
+StdoutRegion getStdoutRegion();
+TelemetryRegion getTelemetryRegion();
+LogRegion getLogRegion();
+ProfileRegion getProfileRegion();
+IrqStatsBlock& getIrqStatsBlock();
+SchedulerBlock& getSchedulerBlock();
+
+// Answer a pending request of the manager to sample the executor's clock, if any. Cheap enough to be polled.
+void answerClockSampleRequest();
+
+// Append to the standard output ring, observing the overflow policy set by the manager.
+// Returns the number of bytes accepted, which is always @p size; see the implementation for why.
+size_t writeToStdoutRing(char const* data, size_t size);
 
 }
@@ -8,6 +8,9 @@
 
 #define memory_write_reorder_barrier() __asm volatile ("dmb ishst" : : : "memory")
 
+// Order all preceding memory accesses, including reads, before any subsequent ones
+#define memory_barrier() __asm volatile ("dmb ish" : : : "memory")
+
 namespace bmboot::internal
 {
 
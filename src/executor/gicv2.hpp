@@ -42,6 +42,9 @@ struct GICC
 
     static constexpr inline uint32_t IAR_CPUID_MASK = 0x00000C00U;
     static constexpr inline uint32_t IAR_INTERRUPT_ID_MASK = 0x000003FFU;
+
+    // Interrupt ID read from IAR when no interrupt is pending at a sufficient priority
+    static constexpr inline uint32_t SPURIOUS_INTERRUPT_ID = 1023;
 };
 
 static_assert(sizeof(GICC)   == 0xE4);
@@ -76,6 +79,14 @@ struct GICD
 
     volatile uint32_t ICFGRn[64];           // Interrupt Configuration Registers
 
+    volatile uint32_t impl_def_d00[64];
+    volatile uint32_t NSACRn[64];           // Non-secure Access Control Registers
+    volatile uint32_t SGIR;                 // Software Generated Interrupt Register
+
+    // per Table 4-21 GICD_SGIR bit assignments
+    static constexpr inline uint32_t SGIR_TargetListFilter_self = (0b10 << 24);
+    static constexpr inline uint32_t SGIR_SGIINTID_MASK = 0x0000000FU;
+
     inline void clearActive(int interrupt_id)
     {
         ICACTIVERn[interrupt_id / 32] = (1 << (interrupt_id % 32));
@@ -91,6 +102,11 @@ struct GICD
         ICPENDRn[interrupt_id / 32] = (1 << (interrupt_id % 32));
     }
 
+    inline void setPending(int interrupt_id)
+    {
+        ISPENDRn[interrupt_id / 32] = (1 << (interrupt_id % 32));
+    }
+
     inline void setEnable(int interrupt_id)
     {
         ISENABLERn[interrupt_id / 32] = (1 << (interrupt_id % 32));
@@ -115,6 +131,6 @@ struct GICD
     }
 };
 
-static_assert(sizeof(GICD) == 0xD00);
+static_assert(sizeof(GICD) == 0xF04);
 
 }
@@ -19,6 +19,7 @@ using namespace bmboot::internal;
 // ************************************************************
 
 static void dummy_payload();
+static void syncPayloadSegments();
 static Response validatePayload(void const* image, size_t image_size, uint32_t crc_expected);
 
 // ************************************************************
@@ -34,10 +35,18 @@ extern "C" int main()
 
     platform::setupInterrupts();
 
+    // Keep profiling and counting across payload restarts (and make sure that the timer is off otherwise).
+    // This is also where the PMU is taken over before any payload gets to run.
+    configurePerfCounters();
+    configureProfiler();
+
     outbox.state = DomainState::monitor_ready;
+    platform::notifyManager();
 
     for (;;)
     {
+        answerClockSampleRequest();
+
         if (inbox.cmd_seq != outbox.cmd_ack)
         {
             // TODO: must check for sequence breaks
@@ -46,15 +55,16 @@ extern "C" int main()
             {
             case Command::noop:
                 outbox.cmd_ack = (outbox.cmd_ack + 1);
+                platform::notifyManager();
                 break;
 
             case Command::start_payload:
                 outbox.state = DomainState::starting_payload;
 
-                // FLush all I-cache. Overkill?
-                // FIXME: Must also flush D-cache, since the binary contains data
-                //        Ah, but what if we have dirty lines? Should flush when payload exits, now's too late!
-                platform::flushICache();
+                // Dirty lines left behind by a previous payload have already been written back when the monitor
+                // was restarted (see invalidate_dcaches in boot.S). What remains is to make sure that the
+                // freshly loaded image is not shadowed by stale cache lines.
+                syncPayloadSegments();
 
                 // TODO: legitimize this h_a_c_k
                 if (inbox.payload_entry_address == 0xbaadf00d)
@@ -70,6 +80,7 @@ extern "C" int main()
                     outbox.cmd_resp = resp;
                     memory_write_reorder_barrier();
                     outbox.cmd_ack = (outbox.cmd_ack + 1);
+                    platform::notifyManager();
 
                     if (resp == Response::crc_ok)
                     {
@@ -78,6 +89,7 @@ extern "C" int main()
                 }
 
                 outbox.state = DomainState::monitor_ready;
+                platform::notifyManager();
                 break;
             }
         }
@@ -132,11 +144,76 @@ static Response validatePayload(void const* image, size_t image_size, uint32_t c
 
 // ************************************************************
 
+void internal::parkPayloadForSnapshot(Aarch64_Regs const& saved_regs)
+{
+    auto& ipc_block = getIpcBlock();
+    volatile const auto& inbox = ipc_block.manager_to_executor;
+    volatile auto& outbox = ipc_block.executor_to_manager;
+
+    auto seq = inbox.snapshot_seq;
+
+    // The payload might have exited or crashed in the meantime (and a crash must not have its registers overwritten)
+    if (outbox.state != DomainState::running_payload)
+    {
+        outbox.snapshot_result = SnapshotResult::snapshot_declined;
+        memory_write_reorder_barrier();
+        outbox.snapshot_ack = seq;
+        platform::notifyManager();
+        return;
+    }
+
+    auto& regs = ipc_block.executor_to_manager.snapshot_regs;
+    regs = saved_regs;
+
+    // The stack pointer saved on exception entry is our own; the payload's is the one selected by SPSR.M[0]
+    regs.sp = (regs.pstate & 1) ? readSysReg(SP_EL1) : readSysReg(SP_EL0);
+
+    // Access to the FP/SIMD registers is trapped while handling an FIQ; lift the trap just to take a copy of them
+    auto cptr = readSysReg(CPTR_EL3);
+    writeSysReg(CPTR_EL3, cptr & ~(1 << 10));
+    __asm__ __volatile__("isb");
+    saveFpuState(ipc_block.executor_to_manager.snapshot_fpregs);
+    writeSysReg(CPTR_EL3, cptr);
+    __asm__ __volatile__("isb");
+
+    outbox.snapshot_result = SnapshotResult::snapshot_parked;
+    memory_write_reorder_barrier();
+    outbox.snapshot_ack = seq;
+    platform::notifyManager();
+
+    // The payload stays frozen while the manager copies its memory. Should the manager go away instead, a subsequent
+    // request (e.g. to terminate the payload) must still get through; it will be taken as soon as we return.
+    while (inbox.snapshot_release != seq && !platform::isManagerRequestPending())
+    {
+    }
+}
+
+// ************************************************************
+
+static void syncPayloadSegments()
+{
+    auto& inbox = getIpcBlock().manager_to_executor;
+
+    if (inbox.num_payload_segments == 0 || inbox.num_payload_segments > MAX_PAYLOAD_SEGMENTS)
+    {
+        // The manager didn't tell us which memory it has written, so flush the entire I-cache
+        platform::flushICache();
+        return;
+    }
+
+    for (uint32_t i = 0; i < inbox.num_payload_segments; i++)
+    {
+        platform::cleanAndInvalidateCacheRange(inbox.payload_segments[i].address, inbox.payload_segments[i].size);
+    }
+}
+
+// ************************************************************
+
 // this exists so that we have *something* to jump to in EL1 when the real payload is to be hot-loaded by a debugger
 static void dummy_payload()
 {
     for (;;)
     {
-        __asm__ volatile("nop");
+        answerClockSampleRequest();
     }
 }
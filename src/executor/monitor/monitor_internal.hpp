@@ -18,6 +18,31 @@ enum class CrashingEntity
 void reportCrash(CrashingEntity who, const char* desc, uintptr_t address);
 void handleSmc(Aarch64_Regs& saved_regs);
 
+//! Capture the state of the interrupted payload for IDomain::snapshot and keep it parked until the manager
+//! releases it (or sends another request).
+void parkPayloadForSnapshot(Aarch64_Regs const& saved_regs);
+
+//! Apply the profiler settings requested by the manager (see ProfileRingHeader)
+void configureProfiler();
+
+//! Record a profile sample of the interrupted payload and schedule the next one
+void takeProfileSample(Aarch64_Regs const& saved_regs);
+
+//! Apply the perf counter settings requested by the manager. The profiler must be reconfigured afterwards, since its
+//! timer also paces the updates of the counter values.
+void configurePerfCounters();
+
+//! Interval at which #updatePerfCounters needs to be called, in timer ticks; 0 if not counting
+uint32_t getPerfCountersUpdateInterval();
+
+//! Publish the counter values to the manager, if due
+void updatePerfCounters();
+
+//! Handle an access to a PMU register by the payload, trapped while the monitor is counting for the manager
+//!
+//! @return false if the access is not one to be handled this way
+bool emulateTrappedPmuAccess(Aarch64_Regs& saved_regs, uint64_t esr);
+
 // Assembly functions
 extern "C" void _boot();
 extern "C" void enterEL1Payload(uintptr_t address);
@@ -0,0 +1,201 @@
+//! @file
+//! @brief  PMU event counting on behalf of the manager
+//! @author Martin Cejp
+
+#include "armv8a.hpp"
+#include "bmboot_internal.hpp"
+#include "executor.hpp"
+#include "executor_asm.hpp"
+#include "monitor_internal.hpp"
+
+using namespace bmboot;
+using namespace bmboot::internal;
+using namespace arm::armv8a;
+
+// ************************************************************
+
+static_assert(MAX_PERF_EVENTS <= PMU_NUM_EVENT_COUNTERS, "readEventCounter and writeEventType must cover all counters");
+
+// MDCR_EL3.TPM: trap accesses to the PMU from EL0-EL2
+static constexpr uint64_t MDCR_TPM = (1 << 6);
+
+// How often the counter values are published. Also the bound on how long the 32-bit counters go without being
+// extended, which is far below the time it takes them to wrap around.
+static constexpr uint32_t UPDATES_PER_SECOND = 100;
+
+static bool active;
+static uint32_t request_seq;                     // perf_request_seq of the settings in effect
+static uint32_t num_events;
+static uint64_t counter_mask;
+static uint64_t upper_halves[MAX_PERF_EVENTS];
+static uint64_t next_update;
+
+// ************************************************************
+
+static void publish()
+{
+    volatile auto& outbox = getIpcBlock().executor_to_manager;
+
+    uint64_t values[MAX_PERF_EVENTS];
+
+    for (uint32_t i = 0; i < num_events; i++)
+    {
+        values[i] = readEventCounter(i);
+    }
+
+    // Extend the counters that have wrapped around (re-reading them, since that might have happened after the read)
+    if (auto overflows = readSysReg(PMOVSCLR_EL0) & counter_mask; overflows != 0)
+    {
+        writeSysReg(PMOVSCLR_EL0, overflows);
+
+        for (uint32_t i = 0; i < num_events; i++)
+        {
+            if (overflows & (1ull << i))
+            {
+                upper_halves[i] += (1ull << 32);
+                values[i] = readEventCounter(i);
+            }
+        }
+    }
+
+    outbox.perf_seq = outbox.perf_seq + 1;
+    memory_write_reorder_barrier();
+
+    outbox.perf_active = active;
+    outbox.perf_request_ack = request_seq;
+    outbox.perf_num_events = num_events;
+    outbox.perf_timer_freq = readSysReg(CNTFRQ_EL0);
+    outbox.perf_timestamp = readSysReg(CNTPCT_EL0);
+    outbox.perf_cycles = readSysReg(PMCCNTR_EL0);
+
+    for (uint32_t i = 0; i < num_events; i++)
+    {
+        outbox.perf_events[i] = upper_halves[i] + values[i];
+    }
+
+    memory_write_reorder_barrier();
+    outbox.perf_seq = outbox.perf_seq + 1;
+}
+
+// ************************************************************
+
+void internal::configurePerfCounters()
+{
+    volatile auto const& inbox = getIpcBlock().manager_to_executor;
+
+    auto num_implemented = (readSysReg(PMCR_EL0) >> PMCR_N_SHIFT) & PMCR_N_MASK;
+
+    // The manager increments the sequence number after changing the settings
+    request_seq = inbox.perf_request_seq;
+    memory_barrier();
+
+    if (!inbox.perf_enabled)
+    {
+        if (active)
+        {
+            writeSysReg(PMCNTENCLR_EL0, counter_mask | PMU_CYCLE_COUNTER_BIT);
+            writeSysReg(MDCR_EL3, readSysReg(MDCR_EL3) & ~MDCR_TPM);
+        }
+
+        active = false;
+        num_events = 0;
+        counter_mask = 0;
+        publish();
+        return;
+    }
+
+    num_events = inbox.perf_num_events;
+    num_events = (num_events < MAX_PERF_EVENTS) ? num_events : MAX_PERF_EVENTS;
+    num_events = (num_events < num_implemented) ? num_events : num_implemented;
+    counter_mask = (1ull << num_events) - 1;
+
+    // From now on, the PMU belongs to us; the payload sees it as unimplemented (see emulateTrappedPmuAccess)
+    writeSysReg(MDCR_EL3, readSysReg(MDCR_EL3) | MDCR_TPM);
+
+    writeSysReg(PMCNTENCLR_EL0, ~0u);
+    writeSysReg(PMINTENCLR_EL1, ~0u);
+
+    for (uint32_t i = 0; i < num_events; i++)
+    {
+        writeEventType(i, PMEVTYPER_M | inbox.perf_events[i]);
+        upper_halves[i] = 0;
+    }
+
+    writeSysReg(PMCCFILTR_EL0, PMEVTYPER_M);
+    writeSysReg(PMOVSCLR_EL0, ~0u);
+    writeSysReg(PMCR_EL0, PMCR_E | PMCR_P | PMCR_C | PMCR_DP | PMCR_LC);
+    writeSysReg(PMCNTENSET_EL0, counter_mask | PMU_CYCLE_COUNTER_BIT);
+    __asm__ __volatile__("isb");
+
+    active = true;
+    next_update = readSysReg(CNTPCT_EL0) + getPerfCountersUpdateInterval();
+
+    // Publish the starting point right away
+    publish();
+}
+
+// ************************************************************
+
+uint32_t internal::getPerfCountersUpdateInterval()
+{
+    return active ? readSysReg(CNTFRQ_EL0) / UPDATES_PER_SECOND : 0;
+}
+
+// ************************************************************
+
+void internal::updatePerfCounters()
+{
+    if (!active)
+    {
+        return;
+    }
+
+    auto now = readSysReg(CNTPCT_EL0);
+
+    // When the profiler is running too, the timer fires more often than necessary
+    if (now < next_update)
+    {
+        return;
+    }
+
+    next_update = now + getPerfCountersUpdateInterval();
+    publish();
+}
+
+// ************************************************************
+
+bool internal::emulateTrappedPmuAccess(Aarch64_Regs& saved_regs, uint64_t esr)
+{
+    // ISS encoding for an exception from MSR, MRS or a System instruction
+    auto is_read = (esr & 1) != 0;
+    auto crm = (esr >> 1) & 0xf;
+    auto rt = (esr >> 5) & 0x1f;
+    auto crn = (esr >> 10) & 0xf;
+    auto op1 = (esr >> 14) & 0x7;
+    auto op0 = (esr >> 20) & 0x3;
+
+    // The registers trapped by MDCR_EL3.TPM:
+    //  - op1=3, CRn=9, CRm=12..14: PMCR_EL0, PMCNTEN*_EL0, PMOVS*_EL0, PMCCNTR_EL0, PMXEV*_EL0, PMUSERENR_EL0 etc.
+    //  - op1=0, CRn=9, CRm=14: PMINTENSET_EL1, PMINTENCLR_EL1
+    //  - op1=3, CRn=14, CRm=8..15: PMEVCNTR<n>_EL0, PMEVTYPER<n>_EL0, PMCCFILTR_EL0
+    // Anything else in CRn=14 (such as CNTPS_*_EL1, at op1=7) is a generic timer register, not ours to emulate.
+    bool is_pmu_register = op0 == 3 &&
+            ((crn == 9 && op1 == 3 && crm >= 12 && crm <= 14) ||
+             (crn == 9 && op1 == 0 && crm == 14) ||
+             (crn == 14 && op1 == 3 && crm >= 8));
+
+    if (!active || !is_pmu_register)
+    {
+        return false;
+    }
+
+    // Reads as zero -- in particular PMCR_EL0.N, so that a well-behaved payload sees no counters to use, and
+    // PMCCNTR_EL0, so that bmboot::getCycleCounterValue returns 0 --, writes are ignored
+    if (is_read && rt != 31)
+    {
+        saved_regs.regs[rt] = 0;
+    }
+
+    writeSysReg(ELR_EL3, readSysReg(ELR_EL3) + 4);
+    return true;
+}
@@ -43,6 +43,13 @@ enum class InterruptTrigger
 
 void flushICache();
 
+//! Clean and invalidate the data cache to the Point of Coherency and invalidate the instruction cache to the Point of
+//! Unification, by virtual address, for the given range only.
+//!
+//! \param address Start of the range
+//! \param size Size of the range in bytes
+void cleanAndInvalidateCacheRange(uintptr_t address, size_t size);
+
 //! Disable all interrupts that have been routed to EL1
 //! This is necessary when the monitor restarts, since the IRQ/FIQ routing options will be reset and the interrupts
 //! would be delivered to EL3 (and we crash pretty hard on any spurious interrupt. that's by design.)
@@ -50,6 +57,20 @@ void teardownEl1Interrupts();
 
 void sendIpiMessage(std::span<const std::byte> message);
 
+//! Signal the manager that the domain state has changed or a command has been acknowledged.
+//! Does nothing unless the manager has requested notifications (see IpcBlock::notify_ipi_mask).
+void notifyManager();
+
+//! Check whether a request (IPI) from the manager is pending, without acknowledging it.
+//! Used to stay responsive while interrupts are masked.
+bool isManagerRequestPending();
+
+//! Route the secure physical timer interrupt to the monitor (as FIQ) and enable it. Used by the profiler.
+void enableSecureTimerInterrupt();
+
+//! Disable the secure physical timer interrupt
+void disableSecureTimerInterrupt();
+
 //void enableCpuInterrupts();
 void setupInterrupts();
 
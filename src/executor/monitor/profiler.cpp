@@ -0,0 +1,152 @@
+//! @file
+//! @brief  Statistical profiler of the payload
+//! @author Martin Cejp
+
+#include "armv8a.hpp"
+#include "bmboot_internal.hpp"
+#include "executor.hpp"
+#include "monitor_internal.hpp"
+#include "platform_interrupt_controller.hpp"
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+// ************************************************************
+
+// Settings in effect, as last picked up from the ring header
+static uint32_t interval_ticks;
+static uint32_t max_stack_depth;
+
+static uint32_t dither_state = 1;
+
+// ************************************************************
+
+// Vary the interval by up to +-1/8, so that the sampling cannot lock on to the period of a control loop in the payload
+static uint32_t nextInterval()
+{
+    // Not profiling; the timer only paces the updates of the perf counters
+    if (interval_ticks == 0)
+    {
+        return getPerfCountersUpdateInterval();
+    }
+
+    // xorshift32
+    dither_state ^= dither_state << 13;
+    dither_state ^= dither_state >> 17;
+    dither_state ^= dither_state << 5;
+
+    auto spread = interval_ticks / 4;
+
+    return interval_ticks - spread / 2 + (spread > 0 ? dither_state % spread : 0);
+}
+
+static MemoryRange getPayloadRange()
+{
+    switch (getCpuIndex())
+    {
+        case 1: return { bmboot_cpu1_payload_ADDRESS, bmboot_cpu1_payload_SIZE };
+        case 2: return { bmboot_cpu2_payload_ADDRESS, bmboot_cpu2_payload_SIZE };
+        case 3: return { bmboot_cpu3_payload_ADDRESS, bmboot_cpu3_payload_SIZE };
+        default: abort();
+    }
+}
+
+// Follow the chain of AAPCS64 frame records ({caller's x29, x30}, pointed to by x29) for as long as it stays within the
+// payload memory. Nothing prevents the payload from using x29 for something else, so every step is validated.
+// This relies on the payload running with an identity mapping, as is the case with the standard BSP.
+static uint32_t walkStack(uint64_t fp, uint64_t* frames, uint32_t max_depth)
+{
+    auto payload = getPayloadRange();
+    uint32_t depth = 0;
+
+    while (depth < max_depth &&
+           fp % 8 == 0 &&
+           fp >= payload.address && fp + 16 <= payload.address + payload.size)
+    {
+        auto record = (uint64_t const*) fp;
+
+        if (record[1] == 0)
+        {
+            break;
+        }
+
+        frames[depth++] = record[1];
+
+        // The stack grows downwards, so the caller's frame record must be higher up; this also rules out loops
+        if (record[0] <= fp)
+        {
+            break;
+        }
+
+        fp = record[0];
+    }
+
+    return depth;
+}
+
+// ************************************************************
+
+void internal::configureProfiler()
+{
+    auto& header = *(ProfileRingHeader volatile*) getProfileRegion().header;
+
+    interval_ticks = header.interval_ticks;
+    max_stack_depth = (header.max_stack_depth < ProfileSample::MAX_FRAMES) ? header.max_stack_depth
+                                                                            : ProfileSample::MAX_FRAMES;
+
+    // The secure physical timer is only accessible from EL3, so the payload cannot interfere with it
+    if (interval_ticks > 0 || getPerfCountersUpdateInterval() > 0)
+    {
+        writeSysReg(CNTPS_TVAL_EL1, nextInterval());
+        writeSysReg(CNTPS_CTL_EL1, 1);      // ENABLE=1, IMASK=0
+        platform::enableSecureTimerInterrupt();
+    }
+    else
+    {
+        writeSysReg(CNTPS_CTL_EL1, 0);
+        platform::disableSecureTimerInterrupt();
+    }
+}
+
+// ************************************************************
+
+void internal::takeProfileSample(Aarch64_Regs const& saved_regs)
+{
+    // Re-arm first, so that the time spent here is not added to the interval (this also clears the interrupt)
+    writeSysReg(CNTPS_TVAL_EL1, nextInterval());
+
+    if (interval_ticks == 0)
+    {
+        return;
+    }
+
+    // Only the payload is of interest. Going by the exception level that was interrupted (SPSR.M[3:2]) rather than by
+    // the domain state also leaves out the monitor when it is running on behalf of a payload, whose stack we must not
+    // attribute to the payload
+    auto interrupted_el = (saved_regs.pstate >> 2) & 3;
+
+    if (interrupted_el != 1 && interrupted_el != 0)
+    {
+        return;
+    }
+
+    auto region = getProfileRegion();
+    auto& ring = *region.header;
+
+    auto wrpos = ring.wrpos;
+    auto wrpos_new = (wrpos + 1 < region.capacity) ? wrpos + 1 : 0;
+
+    if (wrpos >= region.capacity || wrpos_new == __atomic_load_n(&ring.rdpos, __ATOMIC_ACQUIRE))
+    {
+        ring.dropped++;
+        return;
+    }
+
+    auto& sample = region.samples[wrpos];
+    sample.timestamp = readSysReg(CNTPCT_EL0);
+    sample.pc = saved_regs.pc;
+    sample.num_frames = walkStack(saved_regs.regs[29], sample.frames, max_stack_depth);
+
+    // Publish the sample only once it is complete
+    __atomic_store_n(&ring.wrpos, wrpos_new, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,327 @@
+//! @file
+//! @brief  Coroutines driven by interrupts, timers and channels
+//! @author Martin Cejp
+
+#include <bmboot/coroutines.hpp>
+
+#include "armv8a.hpp"
+#include "executor.hpp"
+#include "payload_runtime_internal.hpp"
+
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+static_assert(CoroutineExecutor::MAX_COROUTINES <= 32, "frame pool occupancy must fit in a word");
+
+alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__)
+static std::byte frame_pool[CoroutineExecutor::MAX_COROUTINES][CoroutineExecutor::FRAME_SIZE];
+static uint32_t used_frames;                    // bit N set if frame_pool[N] is allocated
+
+static size_t num_spawned;                      // spawned coroutines that have not finished yet
+
+// Coroutines to be resumed, in the order in which they have been woken up. Every spawned coroutine (together with the
+// ones it awaits) is suspended at most once at a time, so there can never be more entries than frames.
+static std::coroutine_handle<> ready_queue[CoroutineExecutor::MAX_COROUTINES];
+static size_t ready_head;
+static size_t ready_count;
+
+// Coroutines waiting in bmboot::interrupt
+static std::coroutine_handle<> interrupt_waiters[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
+
+// ************************************************************
+
+[[noreturn]] static void crash(char const* desc)
+{
+    notifyPayloadCrashed(desc, 0);
+    abort();
+}
+
+static std::coroutine_handle<> popReady()
+{
+    IrqMask mask;
+
+    if (ready_count == 0)
+    {
+        return {};
+    }
+
+    auto coroutine = ready_queue[ready_head];
+    ready_head = (ready_head + 1) % CoroutineExecutor::MAX_COROUTINES;
+    ready_count--;
+
+    return coroutine;
+}
+
+// ************************************************************
+
+void* Coroutine::promise_type::operator new(size_t size) noexcept
+{
+    return CoroutineExecutor::allocateFrame(size);
+}
+
+void Coroutine::promise_type::operator delete(void* frame) noexcept
+{
+    CoroutineExecutor::freeFrame(frame);
+}
+
+void Coroutine::promise_type::unhandled_exception() noexcept
+{
+    crash("unhandled exception in coroutine");
+}
+
+Coroutine::~Coroutine()
+{
+    if (m_handle)
+    {
+        m_handle.destroy();
+    }
+}
+
+Coroutine& Coroutine::operator=(Coroutine&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+
+        m_handle = std::exchange(other.m_handle, {});
+    }
+
+    return *this;
+}
+
+std::coroutine_handle<> Coroutine::await_suspend(std::coroutine_handle<> caller) noexcept
+{
+    // There is no way to report the failure to the caller; carrying on without running the coroutine would be worse
+    if (!m_handle)
+    {
+        crash("coroutine frame pool exhausted");
+    }
+
+    m_handle.promise().m_continuation = caller;
+    return m_handle;
+}
+
+std::coroutine_handle<> Coroutine::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+{
+    auto& promise = coroutine.promise();
+
+    // Continue directly in the awaiting coroutine, which will destroy this one through its Coroutine object
+    if (promise.m_continuation)
+    {
+        return promise.m_continuation;
+    }
+
+    if (promise.m_spawned)
+    {
+        CoroutineExecutor::finish(coroutine);
+    }
+
+    return std::noop_coroutine();
+}
+
+// ************************************************************
+
+void* CoroutineExecutor::allocateFrame(size_t size)
+{
+    IrqMask mask;
+
+    if (size > FRAME_SIZE || used_frames == (uint32_t) ((1ull << MAX_COROUTINES) - 1))
+    {
+        return nullptr;
+    }
+
+    auto index = std::countr_one(used_frames);
+    used_frames |= (1u << index);
+
+    return frame_pool[index];
+}
+
+void CoroutineExecutor::freeFrame(void* frame)
+{
+    IrqMask mask;
+
+    auto index = (static_cast<std::byte*>(frame) - frame_pool[0]) / FRAME_SIZE;
+    used_frames &= ~(1u << index);
+}
+
+size_t CoroutineExecutor::getFrameCount()
+{
+    return std::popcount(used_frames);
+}
+
+void CoroutineExecutor::finish(std::coroutine_handle<Coroutine::promise_type> coroutine)
+{
+    coroutine.destroy();
+    num_spawned--;
+}
+
+// ************************************************************
+
+bool CoroutineExecutor::spawn(Coroutine coroutine)
+{
+    if (!coroutine)
+    {
+        return false;
+    }
+
+    auto handle = std::exchange(coroutine.m_handle, {});
+    handle.promise().m_spawned = true;
+    num_spawned++;
+
+    wake(handle);
+    return true;
+}
+
+void CoroutineExecutor::run()
+{
+    if (!TimerService::isRunning())
+    {
+        TimerService::start();
+    }
+
+    while (num_spawned > 0)
+    {
+        if (auto coroutine = popReady())
+        {
+            coroutine.resume();
+            continue;
+        }
+
+        flushStdout();
+        answerClockSampleRequest();
+
+        // WFI wakes up for a pending interrupt even while IRQs are masked, so one arriving after the check is not
+        // missed; it is taken as soon as they are unmasked again
+        IrqMask mask;
+
+        if (ready_count == 0)
+        {
+            arm::armv8a::waitForInterrupt();
+        }
+    }
+}
+
+void CoroutineExecutor::wake(std::coroutine_handle<> coroutine)
+{
+    IrqMask mask;
+
+    ready_queue[(ready_head + ready_count) % MAX_COROUTINES] = coroutine;
+    ready_count++;
+}
+
+// ************************************************************
+
+static void handleInterrupt(void* context)
+{
+    auto interrupt_id = (int) (intptr_t) context;
+
+    // Keep a level-sensitive interrupt from firing again before the coroutine has serviced the peripheral
+    disableInterruptHandling(interrupt_id);
+
+    auto& waiter = interrupt_waiters[interrupt_id - GIC_MIN_USER_INTERRUPT_ID];
+
+    if (waiter)
+    {
+        CoroutineExecutor::wake(std::exchange(waiter, {}));
+    }
+}
+
+bool InterruptAwaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+    if (m_interrupt_id < GIC_MIN_USER_INTERRUPT_ID || m_interrupt_id > GIC_MAX_USER_INTERRUPT_ID)
+    {
+        return false;
+    }
+
+    auto index = m_interrupt_id - GIC_MIN_USER_INTERRUPT_ID;
+
+    m_valid = true;
+    interrupt_waiters[index] = coroutine;
+
+    // Look at the dispatch table rather than remembering the configuration, since bmboot::setupInterruptHandling
+    // might have replaced our handler in the meantime
+    if (user_interrupt_handlers[index].function != handleInterrupt)
+    {
+        setupInterruptHandling(m_interrupt_id, PayloadInterruptPriority::p0_min, handleInterrupt,
+                               (void*) (intptr_t) m_interrupt_id);
+    }
+
+    enableInterruptHandling(m_interrupt_id);
+    return true;
+}
+
+// ************************************************************
+
+static void wakeAfterSleep(void* context)
+{
+    CoroutineExecutor::wake(std::coroutine_handle<>::from_address(context));
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+    // If the deadline has passed in the meantime, the timer expires right away
+    m_timer.setCallback(wakeAfterSleep, coroutine.address());
+    TimerService::startAt(m_timer, m_deadline);
+}
+
+// ************************************************************
+
+bool ChannelBase::send(void const* element)
+{
+    IrqMask mask;
+
+    // Hand the element over directly, so that it does not have to be copied twice
+    if (m_receiver)
+    {
+        memcpy(m_receiver_element, element, m_element_size);
+        CoroutineExecutor::wake(std::exchange(m_receiver, {}));
+        return true;
+    }
+
+    if (m_count == m_capacity)
+    {
+        return false;
+    }
+
+    memcpy(m_storage + ((m_head + m_count) % m_capacity) * m_element_size, element, m_element_size);
+    m_count++;
+    return true;
+}
+
+bool ChannelBase::tryReceive(void* element)
+{
+    IrqMask mask;
+
+    if (m_count == 0)
+    {
+        return false;
+    }
+
+    memcpy(element, m_storage + m_head * m_element_size, m_element_size);
+    m_head = (m_head + 1) % m_capacity;
+    m_count--;
+    return true;
+}
+
+bool ChannelBase::suspendReceiver(std::coroutine_handle<> receiver, void* element)
+{
+    IrqMask mask;
+
+    // An element might have arrived since the channel was found empty
+    if (tryReceive(element))
+    {
+        return false;
+    }
+
+    m_receiver = receiver;
+    m_receiver_element = element;
+    return true;
+}
@@ -10,13 +10,47 @@
 #include "payload_runtime_internal.hpp"
 #include "zynqmp.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 using namespace bmboot;
 using namespace bmboot::internal;
+using arm::armv8a::CNTP_CTL_ISTATUS;
+using arm::armv8a::DAIF_F_MASK;
+using arm::armv8a::DAIF_I_MASK;
+using arm::armv8a::PMCR_C;
+using arm::armv8a::PMCR_E;
+using arm::armv8a::PMU_CYCLE_COUNTER_BIT;
 
 static uint64_t timer_period_ticks;
+static InterruptHandlerFunction timer_irq_function;
+static void* timer_irq_context;
+
+// Output is collected here and copied into the shared ring in one go, saving a trap to the monitor per write
+static constexpr size_t STDOUT_BUFFER_SIZE = 512;
+
+static char stdout_buffer[STDOUT_BUFFER_SIZE];
+static size_t stdout_buffer_used;
+static StdoutBuffering stdout_buffering = StdoutBuffering::line;
+
+InterruptDispatchEntry internal::user_interrupt_handlers[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
+
+// Handlers registered as std::function are kept here and called through a trampoline in the dispatch table
+static InterruptHandler user_interrupt_functions[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
 static InterruptHandler timer_irq_handler;
 
-InterruptHandler internal::user_interrupt_handlers[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
+static void callInterruptHandler(void* context)
+{
+    (*static_cast<InterruptHandler*>(context))();
+}
+
+static void setDispatchEntry(int interruptId, InterruptHandlerFunction handler, void* context)
+{
+    // The interrupt might be enabled already, so the entry must not be seen half-updated
+    IrqMask mask;
+
+    user_interrupt_handlers[interruptId - GIC_MIN_USER_INTERRUPT_ID] = {handler, context};
+}
 
 void bmboot::disableInterruptHandling(int interruptId)
 {
@@ -28,6 +62,42 @@ void bmboot::enableInterruptHandling(int interruptId)
     smc(SMC_ZYNQMP_GIC_IRQ_ENABLE, interruptId);
 }
 
+void bmboot::raiseInterrupt(int interruptId)
+{
+    using arm::gicv2::GICD;
+
+    if (interruptId < GIC_MIN_USER_INTERRUPT_ID || interruptId > GIC_MAX_USER_INTERRUPT_ID)
+    {
+        return;
+    }
+
+    // Non-secure accesses to the distributor only take effect for Group 1 interrupts, i.e. those configured for us
+    if (interruptId <= (int) GICD::SGIR_SGIINTID_MASK)
+    {
+        zynqmp::scugic::GICD->SGIR = GICD::SGIR_TargetListFilter_self | interruptId;
+    }
+    else
+    {
+        zynqmp::scugic::GICD->setPending(interruptId);
+    }
+}
+
+// The payload sees the priority fields of the CPU interface as a non-secure agent: its view of a priority is the
+// secure one shifted left by one bit, and its writes can only reach the lower half of the secure range (see ARM IHI
+// 0048B.b, "Software views of interrupt priority in a GIC that includes the Security Extensions")
+uint32_t bmboot::getInterruptPriorityMask()
+{
+    return (zynqmp::scugic::GICC->PMR >> 1) | 0x80;
+}
+
+void bmboot::setInterruptPriorityMask(uint32_t mask)
+{
+    zynqmp::scugic::GICC->PMR = (std::max<uint32_t>(mask, (uint32_t) PayloadInterruptPriority::p7_max) << 1) & 0xFF;
+
+    // Make sure that the write has reached the interrupt controller before the caller goes on
+    (void) zynqmp::scugic::GICC->PMR;
+}
+
 AbiVersion bmboot::getMonitorAbiVersion()
 {
     int major_minor = smc(SMC_GET_ABI_VERSION);
@@ -36,40 +106,68 @@ AbiVersion bmboot::getMonitorAbiVersion()
                        .minor = major_minor & 0xff};
 }
 
-bool bmboot::setupInterruptHandling(int interruptId, PayloadInterruptPriority priority, InterruptHandler handler)
+bool bmboot::setupInterruptHandling(int interruptId, PayloadInterruptPriority priority,
+                                    InterruptHandlerFunction handler, void* context)
 {
     if (interruptId < GIC_MIN_USER_INTERRUPT_ID || interruptId > GIC_MAX_USER_INTERRUPT_ID)
     {
         return false;
     }
 
-    user_interrupt_handlers[interruptId - GIC_MIN_USER_INTERRUPT_ID] = std::move(handler);
+    setDispatchEntry(interruptId, handler, context);
 
     smc(SMC_ZYNQMP_GIC_IRQ_CONFIGURE, interruptId, (int) priority);
 
     return true;
 }
 
-void bmboot::setupPeriodicInterrupt(std::chrono::microseconds period_us, InterruptHandler handler)
+bool bmboot::setupInterruptHandling(int interruptId, PayloadInterruptPriority priority, InterruptHandler handler)
 {
-    // ticks = duration_us * timer_freq_Hz / 1e6
-    timer_period_ticks = (uint64_t) period_us.count() * readSysReg(CNTFRQ_EL0) / 1'000'000;
-    timer_irq_handler = std::move(handler);
+    if (interruptId < GIC_MIN_USER_INTERRUPT_ID || interruptId > GIC_MAX_USER_INTERRUPT_ID)
+    {
+        return false;
+    }
+
+    auto& function = user_interrupt_functions[interruptId - GIC_MIN_USER_INTERRUPT_ID];
+
+    // Unregister the previous handler before replacing it, in case the interrupt fires in the meantime
+    setDispatchEntry(interruptId, nullptr, nullptr);
+    function = std::move(handler);
+
+    return setupInterruptHandling(interruptId, priority, function ? callInterruptHandler : nullptr, &function);
+}
 
+void bmboot::setupPeriodicInterrupt(std::chrono::microseconds period_us,
+                                    InterruptHandlerFunction handler, void* context)
+{
     // stop timer if already running
     writeSysReg(CNTP_CTL_EL0, 0);
 
+    // ticks = duration_us * timer_freq_Hz / 1e6
+    timer_period_ticks = (uint64_t) period_us.count() * readSysReg(CNTFRQ_EL0) / 1'000'000;
+    timer_irq_function = handler;
+    timer_irq_context = context;
+
     setupInterruptHandling(zynqmp::scugic::CNTPNS_INTERRUPT_ID,
                            PayloadInterruptPriority::p7_max,
-                           handleTimerIrq);
+                           handleTimerIrq, nullptr);
+}
+
+void bmboot::setupPeriodicInterrupt(std::chrono::microseconds period_us, InterruptHandler handler)
+{
+    // The timer must be stopped before the handler is replaced
+    writeSysReg(CNTP_CTL_EL0, 0);
+    timer_irq_handler = std::move(handler);
+
+    setupPeriodicInterrupt(period_us, timer_irq_handler ? callInterruptHandler : nullptr, &timer_irq_handler);
 }
 
 void bmboot::startCycleCounter()
 {
     // Set Enable bit & clear count
-    writeSysReg(PMCR_EL0, readSysReg(PMCR_EL0) | (1<<0) | (1<<2));
+    writeSysReg(PMCR_EL0, readSysReg(PMCR_EL0) | PMCR_E | PMCR_C);
     // Set C bit (enable cycle counter)
-    writeSysReg(PMCNTENSET_EL0, readSysReg(PMCNTENSET_EL0) | (1<<31));
+    writeSysReg(PMCNTENSET_EL0, readSysReg(PMCNTENSET_EL0) | PMU_CYCLE_COUNTER_BIT);
 
     asm volatile("isb");
 }
@@ -90,16 +188,16 @@ void bmboot::stopPeriodicInterrupt()
     disableInterruptHandling(zynqmp::scugic::CNTPNS_INTERRUPT_ID);
 }
 
-void internal::handleTimerIrq()
+void internal::handleTimerIrq(void* context)
 {
-    if ((readSysReg(CNTP_CTL_EL0) & 4) == 0)  // check that the timer is really signalled -- just for good measure
+    if ((readSysReg(CNTP_CTL_EL0) & CNTP_CTL_ISTATUS) == 0)  // check that the timer is really signalled -- just for good measure
     {
         return;
     }
 
-    if (timer_irq_handler)
+    if (timer_irq_function)
     {
-        timer_irq_handler();
+        timer_irq_function(timer_irq_context);
     }
     else
     {
@@ -124,17 +222,229 @@ uintptr_t bmboot::getPayloadArgument()
 
 void bmboot::notifyPayloadCrashed(const char* desc, uintptr_t address)
 {
+    // Whatever the payload managed to print before crashing is likely the most relevant part
+    flushStdout();
+
     smc(SMC_NOTIFY_PAYLOAD_CRASHED, desc, address);
 }
 
 void bmboot::notifyPayloadStarted()
 {
+#if BMBOOT_IRQ_STATS
+    initIrqStatistics();
+#endif
+
     smc(SMC_NOTIFY_PAYLOAD_STARTED);
 }
 
+void internal::initIrqStatistics()
+{
+    // The manager has zeroed the statistics already; all that remains is to tell it that they are being collected
+    getIrqStatsBlock().instrumented = 1;
+}
+
+// Must be called with IRQs masked
+void internal::recordIrqStatistics(IrqStatsRecord& record, uint64_t ticks)
+{
+    auto generation = __atomic_load_n(&getIrqStatsBlock().generation, __ATOMIC_RELAXED);
+    auto& histogram = record.histogram;
+
+    record.seq++;
+    memory_write_reorder_barrier();
+
+    // Either this is the first measurement, or the manager asked for a fresh start since the previous one (the
+    // records are cleared lazily, so that a reset costs the payload nothing up-front)
+    if (record.generation != generation || histogram.count == 0)
+    {
+        histogram = {};
+        histogram.min = UINT32_MAX;
+        record.generation = generation;
+    }
+
+    auto ticks32 = (uint32_t) std::min<uint64_t>(ticks, UINT32_MAX);
+
+    histogram.count++;
+    histogram.total += ticks;
+    histogram.min = std::min(histogram.min, ticks32);
+    histogram.max = std::max(histogram.max, ticks32);
+    histogram.bins[TickHistogram::getBin(ticks)]++;
+
+    memory_write_reorder_barrier();
+    record.seq++;
+}
+
+bool Telemetry::push(uint16_t type, void const* data, size_t size)
+{
+    if (size > TelemetryRecord::MAX_DATA_SIZE)
+    {
+        return false;
+    }
+
+    auto region = getTelemetryRegion();
+    auto& ring = *region.header;
+
+    // The ring has a single producer: mask interrupts so that a handler cannot push in the middle of our update
+    auto daif = readSysReg(DAIF);
+    writeSysReg(DAIF, daif | DAIF_I_MASK | DAIF_F_MASK);
+
+    auto wrpos = ring.wrpos;
+    auto wrpos_new = (wrpos + 1 < region.capacity) ? wrpos + 1 : 0;
+
+    bool pushed = false;
+
+    if (wrpos < region.capacity && wrpos_new != __atomic_load_n(&ring.rdpos, __ATOMIC_ACQUIRE))
+    {
+        auto& record = region.records[wrpos];
+        record.timestamp = getBuiltinTimerValue();
+        record.type = type;
+        record.size = size;
+        memcpy(record.data, data, size);
+
+        // Publish the record only once it is complete
+        __atomic_store_n(&ring.wrpos, wrpos_new, __ATOMIC_RELEASE);
+        pushed = true;
+    }
+    else
+    {
+        ring.dropped++;
+    }
+
+    writeSysReg(DAIF, daif);
+    return pushed;
+}
+
+uint32_t Telemetry::getDroppedCount()
+{
+    return getTelemetryRegion().header->dropped;
+}
+
+bool Log::isEnabled(LogLevel level)
+{
+    return level <= getLogRegion().header->level;
+}
+
+bool Log::writeEncoded(LogLevel level, char const* format, uint64_t const* args, size_t num_args)
+{
+    auto region = getLogRegion();
+    auto& ring = *region.header;
+
+    num_args = std::min(num_args, LogRecord::MAX_ARGS);
+
+    // Same as Telemetry::push
+    auto daif = readSysReg(DAIF);
+    writeSysReg(DAIF, daif | DAIF_I_MASK | DAIF_F_MASK);
+
+    auto wrpos = ring.wrpos;
+    auto wrpos_new = (wrpos + 1 < region.capacity) ? wrpos + 1 : 0;
+
+    bool written = false;
+
+    if (wrpos < region.capacity && wrpos_new != __atomic_load_n(&ring.rdpos, __ATOMIC_ACQUIRE))
+    {
+        auto& record = region.records[wrpos];
+        record.timestamp = getBuiltinTimerValue();
+        record.format = (uintptr_t) format;
+        record.level = level;
+        record.num_args = num_args;
+        memcpy(record.args, args, num_args * sizeof(uint64_t));
+
+        __atomic_store_n(&ring.wrpos, wrpos_new, __ATOMIC_RELEASE);
+        written = true;
+    }
+    else
+    {
+        ring.dropped++;
+    }
+
+    writeSysReg(DAIF, daif);
+    return written;
+}
+
+uint32_t Log::getDroppedCount()
+{
+    return getLogRegion().header->dropped;
+}
+
+// Must be called with interrupts masked
+static void flushStdoutBuffer()
+{
+    if (stdout_buffer_used > 0)
+    {
+        writeToStdoutRing(stdout_buffer, stdout_buffer_used);
+        stdout_buffer_used = 0;
+    }
+}
+
+void bmboot::flushStdout()
+{
+    auto daif = readSysReg(DAIF);
+    writeSysReg(DAIF, daif | DAIF_I_MASK | DAIF_F_MASK);
+
+    flushStdoutBuffer();
+
+    writeSysReg(DAIF, daif);
+}
+
+void bmboot::idle()
+{
+    flushStdout();
+    answerClockSampleRequest();
+
+    // The manager signals an event when it wants a clock sample, so that it does not have to wait for an interrupt.
+    // An interrupt handler which writes output after the flush above ends with an exception return, which sets the
+    // event register; the WFE then falls through immediately, and the output is flushed before returning.
+    arm::armv8a::waitForEvent();
+
+    flushStdout();
+}
+
+void bmboot::setStdoutBuffering(StdoutBuffering mode)
+{
+    flushStdout();
+    stdout_buffering = mode;
+}
+
 int bmboot::writeToStdout(void const* data, size_t size)
 {
-    return smc(SMC_WRITE_STDOUT, data, size);
+    if (stdout_buffering == StdoutBuffering::unbuffered)
+    {
+        return smc(SMC_WRITE_STDOUT, data, size);
+    }
+
+    auto bytes = static_cast<char const*>(data);
+
+    // The buffer is shared by all contexts: mask interrupts so that a handler cannot write in the middle of our update
+    auto daif = readSysReg(DAIF);
+    writeSysReg(DAIF, daif | DAIF_I_MASK | DAIF_F_MASK);
+
+    if (size >= STDOUT_BUFFER_SIZE)
+    {
+        // No point in copying large writes twice
+        flushStdoutBuffer();
+        writeToStdoutRing(bytes, size);
+    }
+    else
+    {
+        auto first_run = std::min(size, STDOUT_BUFFER_SIZE - stdout_buffer_used);
+        memcpy(stdout_buffer + stdout_buffer_used, bytes, first_run);
+        stdout_buffer_used += first_run;
+
+        if (first_run < size)
+        {
+            flushStdoutBuffer();
+            memcpy(stdout_buffer, bytes + first_run, size - first_run);
+            stdout_buffer_used = size - first_run;
+        }
+
+        if (stdout_buffer_used == STDOUT_BUFFER_SIZE ||
+            (stdout_buffering == StdoutBuffering::line && memchr(bytes, '\n', size) != nullptr))
+        {
+            flushStdoutBuffer();
+        }
+    }
+
+    writeSysReg(DAIF, daif);
+    return size;
 }
 
 extern "C" void bmNotifyPayloadStarted()
@@ -4,13 +4,39 @@
 
 #pragma once
 
+#include "armv8a.hpp"
 #include "bmboot_internal.hpp"
 
 namespace bmboot::internal
 {
 
-extern InterruptHandler user_interrupt_handlers[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
+// An entry of the interrupt dispatch table; a null function means the interrupt is not handled
+struct InterruptDispatchEntry
+{
+    InterruptHandlerFunction function;
+    void* context;
+};
+
+extern InterruptDispatchEntry user_interrupt_handlers[(GIC_MAX_USER_INTERRUPT_ID + 1) - GIC_MIN_USER_INTERRUPT_ID];
+
+void handleTimerIrq(void* context);
+
+// Masks IRQs for the lifetime of the object
+class IrqMask
+{
+public:
+    IrqMask() : m_daif(readSysReg(DAIF)) { writeSysReg(DAIF, m_daif | arm::armv8a::DAIF_I_MASK); }
+    ~IrqMask() { writeSysReg(DAIF, m_daif); }
+
+    IrqMask(IrqMask const&) = delete;
+    IrqMask& operator=(IrqMask const&) = delete;
+
+private:
+    uint64_t m_daif;
+};
 
-void handleTimerIrq();
+// Interrupt statistics (see IrqStatsBlock); only used if the runtime is built with BMBOOT_IRQ_STATS
+void initIrqStatistics();
+void recordIrqStatistics(IrqStatsRecord& record, uint64_t ticks);
 
 }
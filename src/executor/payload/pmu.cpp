@@ -0,0 +1,258 @@
+//! @file
+//! @brief  Performance Monitor Unit event counters for the payload
+//! @author Martin Cejp
+
+#include <bmboot/payload_runtime.hpp>
+#include <bmboot/pmu.hpp>
+
+#include "armv8a.hpp"
+#include "payload_runtime_internal.hpp"
+#include "zynqmp.hpp"
+
+#include <cstdio>
+
+using namespace bmboot;
+using namespace bmboot::pmu;
+using namespace bmboot::internal;
+using namespace arm::armv8a;
+
+static_assert(MAX_COUNTERS <= PMU_NUM_EVENT_COUNTERS, "readEventCounter and writeEventType must cover all counters");
+
+static Event configured_events[MAX_COUNTERS];
+static size_t num_counters;
+static uint64_t counter_mask;
+
+// Upper 32 bits of each event counter, advanced on overflow
+static uint64_t upper_halves[MAX_COUNTERS];
+
+static Region* all_regions;
+
+// ************************************************************
+
+static int getOverflowInterruptId()
+{
+    return zynqmp::scugic::APU_PMU0_INTERRUPT_ID + getCpuIndex();
+}
+
+static void handleOverflowIrq(void* context)
+{
+    // Reading the counters is all it takes to fold the overflows into the upper halves (and acknowledge them)
+    read();
+}
+
+// ************************************************************
+
+bool pmu::configure(std::span<Event const> events)
+{
+    return configure(events, PayloadInterruptPriority::p7_max);
+}
+
+bool pmu::configure(std::span<Event const> events, PayloadInterruptPriority overflow_priority)
+{
+    auto num_implemented = (readSysReg(PMCR_EL0) >> PMCR_N_SHIFT) & PMCR_N_MASK;
+
+    if (events.size() > MAX_COUNTERS || events.size() > num_implemented)
+    {
+        return false;
+    }
+
+    stop();
+
+    num_counters = events.size();
+    counter_mask = (1ull << num_counters) - 1;
+
+    for (size_t i = 0; i < num_counters; i++)
+    {
+        configured_events[i] = events[i];
+        upper_halves[i] = 0;
+        writeEventType(i, PMEVTYPER_M | (uint64_t) events[i]);
+    }
+
+    writeSysReg(PMCCFILTR_EL0, PMEVTYPER_M);
+
+    // Reset and start everything; the cycle counter is made 64 bits wide, so it never needs to be extended
+    writeSysReg(PMOVSCLR_EL0, counter_mask | PMU_CYCLE_COUNTER_BIT);
+    writeSysReg(PMCR_EL0, readSysReg(PMCR_EL0) | PMCR_E | PMCR_P | PMCR_C | PMCR_LC);
+
+    if (num_counters > 0)
+    {
+        setupInterruptHandling(getOverflowInterruptId(), overflow_priority, handleOverflowIrq, nullptr);
+        enableInterruptHandling(getOverflowInterruptId());
+        writeSysReg(PMINTENSET_EL1, counter_mask);
+    }
+
+    writeSysReg(PMCNTENSET_EL0, counter_mask | PMU_CYCLE_COUNTER_BIT);
+    asm volatile("isb");
+
+    return true;
+}
+
+// ************************************************************
+
+void pmu::stop()
+{
+    if (num_counters > 0)
+    {
+        writeSysReg(PMCNTENCLR_EL0, counter_mask);
+        writeSysReg(PMINTENCLR_EL1, counter_mask);
+        disableInterruptHandling(getOverflowInterruptId());
+    }
+
+    // The cycle counter is left running, since bmboot::getCycleCounterValue might rely on it
+    num_counters = 0;
+    counter_mask = 0;
+}
+
+// ************************************************************
+
+Counts pmu::read()
+{
+    Counts counts {};
+
+    // The overflow interrupt updates the upper halves too
+    IrqMask mask;
+
+    // See getBuiltinTimerValue for discussion of the ISB
+    asm volatile("isb");
+
+    counts.cycles = readSysReg(PMCCNTR_EL0);
+
+    uint64_t lower_halves[MAX_COUNTERS];
+
+    for (size_t i = 0; i < num_counters; i++)
+    {
+        lower_halves[i] = readEventCounter(i);
+    }
+
+    // A counter that has wrapped around -- before or after it was read above -- is read again, now that its upper
+    // half is up to date
+    if (auto overflows = readSysReg(PMOVSCLR_EL0) & counter_mask; overflows != 0)
+    {
+        writeSysReg(PMOVSCLR_EL0, overflows);
+
+        for (size_t i = 0; i < num_counters; i++)
+        {
+            if (overflows & (1ull << i))
+            {
+                upper_halves[i] += (1ull << 32);
+                lower_halves[i] = readEventCounter(i);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_counters; i++)
+    {
+        counts.events[i] = upper_halves[i] + lower_halves[i];
+    }
+
+    return counts;
+}
+
+// ************************************************************
+
+Counts Counts::operator-(Counts const& other) const
+{
+    Counts difference;
+    difference.cycles = cycles - other.cycles;
+
+    for (size_t i = 0; i < MAX_COUNTERS; i++)
+    {
+        difference.events[i] = events[i] - other.events[i];
+    }
+
+    return difference;
+}
+
+// ************************************************************
+
+void Statistics::add(uint64_t value)
+{
+    min = (value < min) ? value : min;
+    max = (value > max) ? value : max;
+    total += value;
+}
+
+// ************************************************************
+
+Region::Region(char const* name) : m_name(name), m_next(all_regions)
+{
+    all_regions = this;
+}
+
+Region::~Region()
+{
+    for (Region** link = &all_regions; *link != nullptr; link = &(*link)->m_next)
+    {
+        if (*link == this)
+        {
+            *link = m_next;
+            break;
+        }
+    }
+}
+
+void Region::add(Counts const& delta)
+{
+    m_num_samples++;
+    m_cycles.add(delta.cycles);
+
+    for (size_t i = 0; i < num_counters; i++)
+    {
+        m_events[i].add(delta.events[i]);
+    }
+}
+
+void Region::reset()
+{
+    m_num_samples = 0;
+    m_cycles = {};
+
+    for (auto& statistics : m_events)
+    {
+        statistics = {};
+    }
+}
+
+// ************************************************************
+
+void Region::print() const
+{
+    printf("%s: %u samples\n", m_name, (unsigned) m_num_samples);
+
+    if (m_num_samples == 0)
+    {
+        return;
+    }
+
+    auto printStatistics = [this](char const* name, Statistics const& statistics)
+    {
+        printf("  %-22s min %10llu  mean %10llu  max %10llu\n", name,
+               (unsigned long long) statistics.min,
+               (unsigned long long) statistics.mean(m_num_samples),
+               (unsigned long long) statistics.max);
+    };
+
+    printStatistics("cycles", m_cycles);
+
+    for (size_t i = 0; i < num_counters; i++)
+    {
+        char name_buffer[16];
+        auto name = toString(configured_events[i]);
+
+        if (name == nullptr)
+        {
+            snprintf(name_buffer, sizeof(name_buffer), "event 0x%02x", (unsigned) configured_events[i]);
+            name = name_buffer;
+        }
+
+        printStatistics(name, m_events[i]);
+    }
+}
+
+void Region::printAll()
+{
+    for (auto region = all_regions; region != nullptr; region = region->m_next)
+    {
+        region->print();
+    }
+}
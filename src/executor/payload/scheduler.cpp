@@ -0,0 +1,354 @@
+//! @file
+//! @brief  Fixed-priority scheduler of periodic tasks
+//! @author Martin Cejp
+
+#include <bmboot/scheduler.hpp>
+
+#include "armv8a.hpp"
+#include "executor.hpp"
+#include "executor_asm.hpp"
+#include "payload_runtime_internal.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+static_assert(Scheduler::MAX_TASKS == SchedulerBlock::MAX_TASKS);
+
+// Priority levels available to tasks, from the highest; level N is driven by SGI FIRST_LEVEL_SGI + N
+static constexpr PayloadInterruptPriority LEVEL_PRIORITIES[] = {
+    PayloadInterruptPriority::p6,
+    PayloadInterruptPriority::p5,
+    PayloadInterruptPriority::p4,
+    PayloadInterruptPriority::p3,
+    PayloadInterruptPriority::p2,
+    PayloadInterruptPriority::p1,
+    PayloadInterruptPriority::p0_min,
+};
+
+static constexpr int NUM_LEVELS = std::size(LEVEL_PRIORITIES);
+static constexpr int FIRST_LEVEL_SGI = 8;
+
+// Sorted by decreasing priority once the scheduler has been started
+static Task* tasks[Scheduler::MAX_TASKS];
+static size_t num_tasks;
+static bool running;
+
+static uint32_t level_tasks[NUM_LEVELS];        // bit N set if tasks[N] executes at the level
+static uint32_t ready_tasks;                    // bit N set if a job of tasks[N] has been released but not started
+
+// Time spent in jobs that have preempted the current one, so that it can be excluded from its execution time
+static uint64_t preempted_ticks;
+
+// ************************************************************
+
+static int getLevel(PayloadInterruptPriority priority)
+{
+    return ((int) priority - (int) PayloadInterruptPriority::p6) / 0x10;
+}
+
+static void clearStatistics(TaskStatistics& statistics)
+{
+    statistics = {};
+    statistics.min_execution = UINT32_MAX;
+    statistics.max_lateness = INT64_MIN;
+}
+
+// Must be called with IRQs masked, and followed by endUpdate
+static TaskStatistics& beginUpdate(SchedulerTaskRecord& record)
+{
+    auto generation = __atomic_load_n(&getSchedulerBlock().generation, __ATOMIC_RELAXED);
+
+    record.seq++;
+    memory_write_reorder_barrier();
+
+    // The manager asked for a fresh start since the previous update (see IrqStatsBlock for the same approach)
+    if (record.generation != generation)
+    {
+        clearStatistics(record.statistics);
+        record.generation = generation;
+    }
+
+    return record.statistics;
+}
+
+static void endUpdate(SchedulerTaskRecord& record)
+{
+    memory_write_reorder_barrier();
+    record.seq++;
+}
+
+// ************************************************************
+
+bool Scheduler::addTask(Task& task)
+{
+    if (running || num_tasks == MAX_TASKS || task.m_requested_priority == PayloadInterruptPriority::p7_max)
+    {
+        return false;
+    }
+
+    tasks[num_tasks++] = &task;
+    return true;
+}
+
+// ************************************************************
+
+void Scheduler::assignPriorities()
+{
+    // Rate-monotonic: by period, shortest first; the sort is stable, so tasks of equal period keep their order
+    std::stable_sort(tasks, tasks + num_tasks, [](Task const* a, Task const* b) { return a->m_period < b->m_period; });
+
+    int next_level = -1;
+    std::chrono::microseconds previous_period {-1};
+
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        auto& task = *tasks[i];
+
+        if (task.m_requested_priority.has_value())
+        {
+            task.m_level = getLevel(*task.m_requested_priority);
+            continue;
+        }
+
+        if (task.m_period != previous_period)
+        {
+            next_level = std::min(next_level + 1, NUM_LEVELS - 1);
+            previous_period = task.m_period;
+        }
+
+        task.m_level = next_level;
+    }
+
+    // Now by level, which is the order in which jobs are picked
+    std::stable_sort(tasks, tasks + num_tasks, [](Task const* a, Task const* b) { return a->m_level < b->m_level; });
+
+    std::fill(std::begin(level_tasks), std::end(level_tasks), 0);
+
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        tasks[i]->m_index = i;
+        tasks[i]->m_priority = LEVEL_PRIORITIES[tasks[i]->m_level];
+        level_tasks[tasks[i]->m_level] |= (1u << i);
+    }
+}
+
+// ************************************************************
+
+bool Scheduler::start()
+{
+    if (running || num_tasks == 0)
+    {
+        return false;
+    }
+
+    assignPriorities();
+
+    // Publish the configuration of the tasks to the manager
+    auto& block = getSchedulerBlock();
+
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        auto& task = *tasks[i];
+        auto& record = block.tasks[i];
+
+        record.generation = block.generation;
+        strncpy(record.name, task.m_name, sizeof(record.name) - 1);
+        record.name[sizeof(record.name) - 1] = 0;
+        record.period = TimerService::toTicks(task.m_period);
+        record.offset = TimerService::toTicks(task.m_offset);
+        record.priority = (uint32_t) task.m_priority;
+        clearStatistics(record.statistics);
+    }
+
+    memory_write_reorder_barrier();
+    block.num_tasks = num_tasks;
+
+    for (int level = 0; level < NUM_LEVELS; level++)
+    {
+        if (level_tasks[level] != 0)
+        {
+            setupInterruptHandling(FIRST_LEVEL_SGI + level, LEVEL_PRIORITIES[level], runLevel,
+                                   (void*) (intptr_t) level);
+            enableInterruptHandling(FIRST_LEVEL_SGI + level);
+        }
+    }
+
+    ready_tasks = 0;
+    running = true;
+
+    if (!TimerService::isRunning())
+    {
+        TimerService::start();
+    }
+
+    // A common time base, so that the offsets are honored
+    auto start_time = getBuiltinTimerValue();
+
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        auto& task = *tasks[i];
+
+        task.m_job_pending = false;
+        task.m_timer_overruns = 0;
+        task.m_release_timer.setCallback(releaseJob, &task);
+
+        TimerService::startAt(task.m_release_timer,
+                              start_time + TimerService::toTicks(task.m_offset),
+                              TimerService::toTicks(task.m_period));
+    }
+
+    return true;
+}
+
+void Scheduler::stop()
+{
+    running = false;
+
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        TimerService::cancel(tasks[i]->m_release_timer);
+    }
+}
+
+bool Scheduler::isRunning()
+{
+    return running;
+}
+
+// ************************************************************
+
+// Called by the timer service, at the highest payload priority
+void Scheduler::releaseJob(void* context)
+{
+    auto& task = *static_cast<Task*>(context);
+    auto& timer = task.m_release_timer;
+    auto& record = getSchedulerBlock().tasks[task.m_index];
+
+    auto& statistics = beginUpdate(record);
+    statistics.releases++;
+
+    // Releases that the timer service had to skip, because it could not keep up
+    statistics.dropped += timer.getOverrunCount() - task.m_timer_overruns;
+    task.m_timer_overruns = timer.getOverrunCount();
+
+    if (task.m_job_pending)
+    {
+        statistics.dropped++;
+        endUpdate(record);
+        return;
+    }
+
+    endUpdate(record);
+
+    // The timer has been re-armed already
+    task.m_release = timer.getDeadline() - timer.getPeriod();
+    task.m_job_pending = true;
+    ready_tasks |= (1u << task.m_index);
+
+    raiseInterrupt(FIRST_LEVEL_SGI + task.m_level);
+}
+
+// Handler of the SGI of a priority level
+void Scheduler::runLevel(void* context)
+{
+    auto level = (int) (intptr_t) context;
+
+    for (;;)
+    {
+        uint32_t ready;
+        int next;
+
+        {
+            // Releases happen at a higher priority, so the ready set might change under our hands
+            IrqMask mask;
+
+            ready = ready_tasks & level_tasks[level];
+            next = std::countr_zero(ready);
+
+            if (ready != 0)
+            {
+                ready_tasks &= ~(1u << next);
+            }
+        }
+
+        if (ready == 0)
+        {
+            return;
+        }
+
+        runJob(*tasks[next]);
+    }
+}
+
+void Scheduler::runJob(Task& task)
+{
+    auto start = getBuiltinTimerValue();
+
+    auto outer_preempted_ticks = preempted_ticks;
+    preempted_ticks = 0;
+
+    task.m_function(task.m_context);
+
+    // With IRQs masked, so that no other job can slip in between the measurement and the accounting
+    IrqMask mask;
+
+    auto end = getBuiltinTimerValue();
+    auto execution = (end - start) - preempted_ticks;
+    preempted_ticks = outer_preempted_ticks + (end - start);
+
+    auto deadline = task.m_release + task.m_release_timer.getPeriod();
+    auto lateness = (int64_t) (end - deadline);
+
+    auto& record = getSchedulerBlock().tasks[task.m_index];
+    auto& statistics = beginUpdate(record);
+
+    statistics.completions++;
+    statistics.total_execution += execution;
+    statistics.min_execution = std::min<uint64_t>(statistics.min_execution, execution);
+    statistics.max_execution = std::max<uint64_t>(statistics.max_execution, std::min<uint64_t>(execution, UINT32_MAX));
+    statistics.max_start_delay = std::max<uint64_t>(statistics.max_start_delay,
+                                                    std::min<uint64_t>(start - task.m_release, UINT32_MAX));
+    statistics.max_lateness = std::max(statistics.max_lateness, lateness);
+
+    if (lateness > 0)
+    {
+        statistics.overruns++;
+    }
+
+    endUpdate(record);
+
+    task.m_job_pending = false;
+}
+
+// ************************************************************
+
+TaskStatistics Task::getStatistics() const
+{
+    TaskStatistics statistics;
+
+    if (m_index < 0)
+    {
+        clearStatistics(statistics);
+        return statistics;
+    }
+
+    auto& block = getSchedulerBlock();
+    auto& record = block.tasks[m_index];
+
+    IrqMask mask;
+
+    if (record.generation == __atomic_load_n(&block.generation, __ATOMIC_RELAXED))
+    {
+        statistics = record.statistics;
+    }
+    else
+    {
+        clearStatistics(statistics);
+    }
+
+    return statistics;
+}
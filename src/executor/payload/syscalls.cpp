@@ -91,9 +91,12 @@ extern "C" int _fstat(int fd, struct stat* st)
 
 // **********************************************************
 
-//extern "C" void _exit(int code)
-//{
-//    // TODO: inform manager before/instead of hanging
-//
-//    while(1) ;
-//}
+extern "C" void _exit(int code)
+{
+    // stdio has been flushed by exit() at this point, but our own buffer has not; idle() takes care of that.
+    // There is no notion of a finished payload: as far as the manager is concerned, it keeps running until it is
+    // terminated. Interrupt handlers might still be active, so keep their output flowing.
+    for (;;) {
+        idle();
+    }
+}
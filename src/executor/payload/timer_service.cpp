@@ -0,0 +1,329 @@
+//! @file
+//! @brief  Software timers multiplexed onto the built-in timer
+//! @author Martin Cejp
+//!
+//! The timers are kept in a hierarchical timer wheel. Level L has 64 slots, each spanning 64^L ticks; together they
+//! cover the 64^(L+1)-tick block that contains the wheel's current time (@c wheel_time). A timer is placed at the
+//! level of the most significant 6-bit digit in which its deadline differs from @c wheel_time, in the slot given by
+//! that digit of the deadline. The slot is therefore always later than the current one, and the first occupied slot
+//! of the lowest occupied level marks the next point in time at which something must be done: at level 0, that is an
+//! exact deadline; at higher levels, the timers in the slot are redistributed to lower levels (cascaded).
+//!
+//! Starting and cancelling a timer are O(1); each timer is cascaded at most once per level, and 11 levels cover the
+//! entire 64-bit range of the built-in timer.
+
+#include <bmboot/timer_service.hpp>
+
+#include "armv8a.hpp"
+#include "payload_runtime_internal.hpp"
+#include "zynqmp.hpp"
+
+#include <bit>
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+static constexpr int BITS_PER_LEVEL = 6;
+static constexpr int SLOTS_PER_LEVEL = (1 << BITS_PER_LEVEL);
+static constexpr int NUM_LEVELS = (64 + BITS_PER_LEVEL - 1) / BITS_PER_LEVEL;
+
+// Pseudo-level for timers that have expired and whose callback is yet to be called
+static constexpr int8_t EXPIRED_LEVEL = NUM_LEVELS;
+
+static constexpr uint64_t CNTP_CTL_ENABLE = (1 << 0);
+
+// The wheel is used from the timer interrupt as well as from other contexts; outside of the interrupt, it is only
+// touched with IRQs masked (see IrqMask)
+static Timer* wheel[NUM_LEVELS][SLOTS_PER_LEVEL];
+static uint64_t occupied_slots[NUM_LEVELS];         // bit N set if wheel[level][N] is not empty
+static Timer* expired_timers;
+static uint64_t wheel_time;
+static bool running;
+static bool in_callback;
+
+// ************************************************************
+
+static int getShift(int level)
+{
+    return level * BITS_PER_LEVEL;
+}
+
+// Time at which a slot of a level begins, given the current wheel time
+static uint64_t getSlotStart(int level, int slot)
+{
+    auto block_bits = getShift(level) + BITS_PER_LEVEL;
+    auto block_start = (block_bits < 64) ? (wheel_time & ~((1ull << block_bits) - 1)) : 0;
+
+    return block_start + ((uint64_t) slot << getShift(level));
+}
+
+static Timer*& getListHead(int level, int slot)
+{
+    return (level == EXPIRED_LEVEL) ? expired_timers : wheel[level][slot];
+}
+
+// ************************************************************
+
+Timer::~Timer()
+{
+    TimerService::cancel(*this);
+}
+
+// ************************************************************
+
+void TimerService::insert(Timer& timer)
+{
+    int level;
+    int slot;
+
+    if (timer.m_deadline <= wheel_time)
+    {
+        level = EXPIRED_LEVEL;
+        slot = 0;
+    }
+    else
+    {
+        level = (std::bit_width(timer.m_deadline ^ wheel_time) - 1) / BITS_PER_LEVEL;
+        slot = (timer.m_deadline >> getShift(level)) & (SLOTS_PER_LEVEL - 1);
+        occupied_slots[level] |= (1ull << slot);
+    }
+
+    auto& head = getListHead(level, slot);
+
+    timer.m_level = level;
+    timer.m_slot = slot;
+    timer.m_prev = nullptr;
+    timer.m_next = head;
+
+    if (head != nullptr)
+    {
+        head->m_prev = &timer;
+    }
+
+    head = &timer;
+}
+
+void TimerService::remove(Timer& timer)
+{
+    if (timer.m_prev != nullptr)
+    {
+        timer.m_prev->m_next = timer.m_next;
+    }
+    else
+    {
+        getListHead(timer.m_level, timer.m_slot) = timer.m_next;
+    }
+
+    if (timer.m_next != nullptr)
+    {
+        timer.m_next->m_prev = timer.m_prev;
+    }
+
+    if (timer.m_level != EXPIRED_LEVEL && wheel[timer.m_level][timer.m_slot] == nullptr)
+    {
+        occupied_slots[timer.m_level] &= ~(1ull << timer.m_slot);
+    }
+
+    timer.m_level = Timer::INACTIVE;
+    timer.m_next = nullptr;
+    timer.m_prev = nullptr;
+}
+
+// ************************************************************
+
+void TimerService::advance(uint64_t now)
+{
+    // Take out every slot that has begun by now; these are the only ones whose position depends on the wheel time
+    Timer* due = nullptr;
+
+    for (int level = 0; level < NUM_LEVELS; level++)
+    {
+        for (auto slots = occupied_slots[level]; slots != 0; slots &= slots - 1)
+        {
+            auto slot = std::countr_zero(slots);
+
+            // Slots are visited in chronological order
+            if (getSlotStart(level, slot) > now)
+            {
+                break;
+            }
+
+            // Splice the slot onto the list of due timers
+            auto last = wheel[level][slot];
+
+            while (last->m_next != nullptr)
+            {
+                last = last->m_next;
+            }
+
+            last->m_next = due;
+            due = wheel[level][slot];
+
+            wheel[level][slot] = nullptr;
+            occupied_slots[level] &= ~(1ull << slot);
+        }
+    }
+
+    wheel_time = now;
+
+    // Re-insert them relative to the new time: either as expired, or at a lower level
+    while (due != nullptr)
+    {
+        auto next = due->m_next;
+        insert(*due);
+        due = next;
+    }
+}
+
+void TimerService::reprogram()
+{
+    if (!running)
+    {
+        return;
+    }
+
+    if (expired_timers != nullptr)
+    {
+        // Some callbacks have yet to be called; have the interrupt taken again as soon as possible
+        writeSysReg(CNTP_CVAL_EL0, wheel_time);
+        writeSysReg(CNTP_CTL_EL0, CNTP_CTL_ENABLE);
+        return;
+    }
+
+    for (int level = 0; level < NUM_LEVELS; level++)
+    {
+        if (occupied_slots[level] != 0)
+        {
+            writeSysReg(CNTP_CVAL_EL0, getSlotStart(level, std::countr_zero(occupied_slots[level])));
+            writeSysReg(CNTP_CTL_EL0, CNTP_CTL_ENABLE);
+            return;
+        }
+    }
+
+    // Nothing to wait for; disabling the timer also de-asserts its interrupt
+    writeSysReg(CNTP_CTL_EL0, 0);
+}
+
+// ************************************************************
+
+void TimerService::handleIrq(void* context)
+{
+    // Nothing can preempt the highest payload priority, so the wheel is safe to use without masking IRQs
+    auto now = getBuiltinTimerValue();
+    advance(now);
+
+    while (expired_timers != nullptr)
+    {
+        auto& timer = *expired_timers;
+        remove(timer);
+
+        // Re-arm before calling back, so that the callback can cancel or restart the timer
+        if (timer.m_period != 0)
+        {
+            timer.m_deadline += timer.m_period;
+
+            if (timer.m_deadline <= now)
+            {
+                auto skipped = (now - timer.m_deadline) / timer.m_period + 1;
+                timer.m_deadline += skipped * timer.m_period;
+                timer.m_overruns += skipped;
+            }
+
+            insert(timer);
+        }
+
+        if (timer.m_callback != nullptr)
+        {
+            in_callback = true;
+            timer.m_callback(timer.m_context);
+            in_callback = false;
+        }
+    }
+
+    reprogram();
+}
+
+// ************************************************************
+
+void TimerService::start()
+{
+    IrqMask mask;
+
+    writeSysReg(CNTP_CTL_EL0, 0);
+
+    setupInterruptHandling(zynqmp::scugic::CNTPNS_INTERRUPT_ID, PayloadInterruptPriority::p7_max, handleIrq, nullptr);
+    enableInterruptHandling(zynqmp::scugic::CNTPNS_INTERRUPT_ID);
+
+    running = true;
+    reprogram();
+}
+
+void TimerService::stop()
+{
+    IrqMask mask;
+
+    running = false;
+    writeSysReg(CNTP_CTL_EL0, 0);
+
+    disableInterruptHandling(zynqmp::scugic::CNTPNS_INTERRUPT_ID);
+}
+
+bool TimerService::isRunning()
+{
+    return running;
+}
+
+bool TimerService::isInCallback()
+{
+    return in_callback;
+}
+
+// ************************************************************
+
+void TimerService::startOneShot(Timer& timer, std::chrono::microseconds delay)
+{
+    startAt(timer, getBuiltinTimerValue() + toTicks(delay), 0);
+}
+
+void TimerService::startPeriodic(Timer& timer, std::chrono::microseconds period)
+{
+    auto period_ticks = toTicks(period);
+    startAt(timer, getBuiltinTimerValue() + period_ticks, period_ticks);
+}
+
+void TimerService::startAt(Timer& timer, uint64_t deadline, uint64_t period)
+{
+    IrqMask mask;
+
+    if (timer.isActive())
+    {
+        remove(timer);
+    }
+
+    timer.m_deadline = deadline;
+    timer.m_period = period;
+    timer.m_overruns = 0;
+
+    insert(timer);
+    reprogram();
+}
+
+void TimerService::cancel(Timer& timer)
+{
+    IrqMask mask;
+
+    if (timer.isActive())
+    {
+        remove(timer);
+    }
+
+    // Not reprogramming the hardware costs at most one spurious interrupt
+}
+
+// ************************************************************
+
+uint64_t TimerService::toTicks(std::chrono::microseconds duration)
+{
+    // ticks = duration_us * timer_freq_Hz / 1e6, rounded up
+    return ((uint64_t) duration.count() * getBuiltinTimerFrequency() + 999'999) / 1'000'000;
+}
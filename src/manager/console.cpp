@@ -0,0 +1,422 @@
+//! @file
+//! @brief  Console displaying the standard output of executor domains
+//! @author Martin Cejp
+
+#include "bmboot/console.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace bmboot;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+// ************************************************************
+
+static void throwSystemError(char const* what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+static void armTimer(int timer_fd, microseconds interval)
+{
+    itimerspec spec {};
+    spec.it_value.tv_sec = interval.count() / 1'000'000;
+    spec.it_value.tv_nsec = (interval.count() % 1'000'000) * 1'000;
+
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+// Write out all the buffers, resuming after short writes
+static void writeAll(int fd, iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        auto written = writev(fd, iov, iovcnt);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return;
+        }
+
+        while (iovcnt > 0 && (size_t) written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char*) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// ************************************************************
+
+Console::Console(microseconds min_poll_interval, microseconds max_poll_interval)
+        : m_start(steady_clock::now()),
+          // A zero expiry would disarm the timer instead of firing it right away
+          m_min_poll_interval(std::max(min_poll_interval, microseconds(1))),
+          m_max_poll_interval(std::max(m_min_poll_interval, max_poll_interval))
+{
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (m_epoll_fd < 0 || m_timer_fd < 0 || m_event_fd < 0)
+    {
+        auto error = errno;
+        closeAll();
+        errno = error;
+        throwSystemError("Console");
+    }
+
+    for (int fd : { m_timer_fd, m_event_fd })
+    {
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            auto error = errno;
+            closeAll();
+            errno = error;
+            throwSystemError("epoll_ctl");
+        }
+    }
+
+    // There are only so many domains, so the pending list never needs to grow after this
+    m_pending_domains.reserve(m_slots.size());
+}
+
+Console::~Console()
+{
+    closeAll();
+}
+
+void Console::closeAll()
+{
+    for (int* fd : { &m_epoll_fd, &m_timer_fd, &m_event_fd })
+    {
+        if (*fd >= 0)
+        {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+// ************************************************************
+
+void Console::addDomain(IDomain& domain, std::shared_ptr<LogDecoder const> log_decoder)
+{
+    {
+        std::lock_guard lock(m_pending_mutex);
+
+        if (std::find_if(m_pending_domains.begin(), m_pending_domains.end(),
+                         [&](PendingDomain const& pending) { return pending.domain == &domain; }) == m_pending_domains.end())
+        {
+            m_pending_domains.push_back(PendingDomain { &domain, std::move(log_decoder) });
+        }
+    }
+
+    // Wake up the console thread to pick up the new domain
+    uint64_t one = 1;
+    [[maybe_unused]] auto rc = ::write(m_event_fd, &one, sizeof(one));
+}
+
+// ************************************************************
+
+void Console::stop()
+{
+    m_stop_requested = true;
+
+    uint64_t one = 1;
+    [[maybe_unused]] auto rc = ::write(m_event_fd, &one, sizeof(one));
+}
+
+// ************************************************************
+
+void Console::run()
+{
+    auto interval = m_min_poll_interval;
+
+    acceptPendingDomains();
+    armTimer(m_timer_fd, interval);
+
+    while (!m_stop_requested)
+    {
+        epoll_event events[2];
+        auto num_events = epoll_wait(m_epoll_fd, events, std::size(events), -1);
+
+        for (int i = 0; i < num_events; i++)
+        {
+            uint64_t counter;
+            [[maybe_unused]] auto rc = ::read(events[i].data.fd, &counter, sizeof(counter));
+
+            if (events[i].data.fd == m_event_fd)
+            {
+                acceptPendingDomains();
+            }
+            else if (events[i].data.fd == m_timer_fd)
+            {
+                // Poll again soon while output is flowing, back off when it is not
+                if (drainAll(false))
+                {
+                    interval = m_min_poll_interval;
+                }
+                else
+                {
+                    interval = std::min(interval * 2, m_max_poll_interval);
+                }
+
+                armTimer(m_timer_fd, interval);
+            }
+        }
+    }
+
+    // Print whatever is left over, even if not terminated by a newline. Only what has been written so far, though;
+    // a payload that keeps printing must not keep us from returning.
+    for (size_t i = 0; i < m_num_slots; i++)
+    {
+        m_slots[i].final_stdout_bytes = m_slots[i].domain->getStdoutPendingBytes();
+        m_slots[i].final_log_messages = m_slots[i].domain->getLogPendingCount();
+    }
+
+    while (drainAll(true))
+    {
+    }
+
+    m_stop_requested = false;
+}
+
+// ************************************************************
+
+void Console::acceptPendingDomains()
+{
+    std::lock_guard lock(m_pending_mutex);
+
+    // Without a proper decoder, log messages are still displayed, but only raw
+    static auto const raw_log_decoder = std::make_shared<LogDecoder const>();
+
+    for (auto& [domain, log_decoder] : m_pending_domains)
+    {
+        auto slots_end = m_slots.begin() + m_num_slots;
+
+        if (m_num_slots == m_slots.size() ||
+            std::find_if(m_slots.begin(), slots_end, [&](Slot const& slot) { return slot.domain == domain; }) != slots_end)
+        {
+            continue;
+        }
+
+        auto& slot = m_slots[m_num_slots++];
+        slot.domain = domain;
+        slot.log_decoder = log_decoder ? std::move(log_decoder) : raw_log_decoder;
+        slot.dropped_bytes = domain->getStdoutDroppedBytes();
+        slot.dropped_log_messages = domain->getLogDroppedCount();
+        slot.time_correlation.reset();
+        slot.next_clock_sample = {};
+        slot.clock_sample_interval = CLOCK_SAMPLE_INTERVAL;
+        snprintf(slot.name, sizeof(slot.name), "%s", toString(domain->getIndex()).c_str());
+    }
+
+    m_pending_domains.clear();
+}
+
+// ************************************************************
+
+bool Console::drainAll(bool final)
+{
+    auto now = steady_clock::now();
+    auto timestamp = std::chrono::duration<float>(now - m_start).count();
+
+    // Keep the correlation of the executors' clocks with ours up to date. Only a payload that idles answers; since an
+    // unanswered request means busy-waiting for the timeout, back off as long as the requests keep going unanswered.
+    for (size_t i = 0; i < m_num_slots; i++)
+    {
+        auto& slot = m_slots[i];
+
+        if (now < slot.next_clock_sample)
+        {
+            continue;
+        }
+
+        if (slot.domain->getState() != DomainState::running_payload)
+        {
+            slot.clock_sample_interval = CLOCK_SAMPLE_INTERVAL;
+        }
+        else if (auto sample = slot.domain->sampleExecutorClock(CLOCK_SAMPLE_TIMEOUT); sample.has_value())
+        {
+            slot.time_correlation.addSample(*sample);
+            slot.clock_sample_interval = CLOCK_SAMPLE_INTERVAL;
+        }
+        else
+        {
+            slot.clock_sample_interval = std::min(slot.clock_sample_interval * 2, MAX_CLOCK_SAMPLE_INTERVAL);
+        }
+
+        slot.next_clock_sample = now + slot.clock_sample_interval;
+    }
+
+    iovec iov[DomainIndex::max_domain];
+    int iovcnt = 0;
+
+    for (size_t i = 0; i < m_num_slots; i++)
+    {
+        auto length = drain(m_slots[i], timestamp, final);
+
+        if (length > 0)
+        {
+            iov[iovcnt++] = { m_slots[i].output, length };
+        }
+    }
+
+    if (iovcnt == 0)
+    {
+        return false;
+    }
+
+    // Anything printed through stdio must come out before
+    fflush(stdout);
+
+    writeAll(STDOUT_FILENO, iov, iovcnt);
+    return true;
+}
+
+// ************************************************************
+
+// Collect as many complete lines as fit in the output buffer, each with its own prefix
+size_t Console::drain(Slot& slot, float timestamp, bool final)
+{
+    static constexpr size_t MAX_PREFIX_LENGTH = 32;
+
+    size_t used = 0;
+
+    // Let the user know if output has been lost since the last time
+    if (auto dropped_bytes = slot.domain->getStdoutDroppedBytes(); dropped_bytes != slot.dropped_bytes)
+    {
+        auto length = snprintf(slot.output, MAX_PREFIX_LENGTH + MAX_LINE_LENGTH,
+                               "[%s %7.3f] *** %llu bytes of output dropped ***\n",
+                               slot.name, timestamp, (unsigned long long) (dropped_bytes - slot.dropped_bytes));
+        used += std::min<size_t>(length, MAX_PREFIX_LENGTH + MAX_LINE_LENGTH - 1);
+        slot.dropped_bytes = dropped_bytes;
+    }
+
+    while (used + MAX_PREFIX_LENGTH + MAX_LINE_LENGTH + 1 <= sizeof(slot.output))
+    {
+        std::span<char> line = slot.line;
+
+        if (final)
+        {
+            line = line.first(std::min(line.size(), slot.final_stdout_bytes));
+        }
+
+        auto length = slot.domain->readStdoutLine(line);
+
+        if (length == 0 && final)
+        {
+            length = slot.domain->readStdout(line);
+        }
+
+        if (length == 0)
+        {
+            break;
+        }
+
+        if (final)
+        {
+            slot.final_stdout_bytes -= length;
+        }
+
+        if (slot.line[length - 1] == '\n')
+        {
+            length--;
+        }
+
+        auto prefix_length = snprintf(slot.output + used, MAX_PREFIX_LENGTH, "[%s %7.3f] ", slot.name, timestamp);
+        used += std::min<size_t>(prefix_length, MAX_PREFIX_LENGTH - 1);
+
+        memcpy(slot.output + used, slot.line, length);
+        used += length;
+        slot.output[used++] = '\n';
+    }
+
+    return drainLog(slot, timestamp, used, final);
+}
+
+// ************************************************************
+
+// Render as many log messages as fit in the rest of the output buffer
+size_t Console::drainLog(Slot& slot, float timestamp, size_t used, bool final)
+{
+    static constexpr size_t MAX_PREFIX_LENGTH = 48;
+
+    if (auto dropped = slot.domain->getLogDroppedCount(); dropped != slot.dropped_log_messages)
+    {
+        if (used + MAX_PREFIX_LENGTH + MAX_LINE_LENGTH + 1 > sizeof(slot.output))
+        {
+            return used;
+        }
+
+        auto length = snprintf(slot.output + used, MAX_PREFIX_LENGTH + MAX_LINE_LENGTH,
+                               "[%s %7.3f] *** %u log messages dropped ***\n",
+                               slot.name, timestamp, (unsigned) (dropped - slot.dropped_log_messages));
+        used += std::min<size_t>(length, MAX_PREFIX_LENGTH + MAX_LINE_LENGTH - 1);
+        slot.dropped_log_messages = dropped;
+    }
+
+    while (used + MAX_PREFIX_LENGTH + MAX_LINE_LENGTH + 1 <= sizeof(slot.output))
+    {
+        LogRecord record;
+
+        if ((final && slot.final_log_messages == 0) || slot.domain->readLog({ &record, 1 }) == 0)
+        {
+            break;
+        }
+
+        if (final)
+        {
+            slot.final_log_messages--;
+        }
+
+        // Prefer the time at which the message was logged over the time at which we got to see it
+        auto record_timestamp = timestamp;
+
+        if (auto host_time = slot.time_correlation.toHostTime(record.timestamp); host_time.has_value())
+        {
+            record_timestamp = std::chrono::duration<float>(host_time->time - m_start).count();
+        }
+
+        auto prefix_length = snprintf(slot.output + used, MAX_PREFIX_LENGTH, "[%s %7.3f] %s: ",
+                                      slot.name, record_timestamp, toString(record.level).c_str());
+        used += std::min<size_t>(prefix_length, MAX_PREFIX_LENGTH - 1);
+
+        // Overlong messages are truncated, like any other line
+        auto text = slot.log_decoder->format(record);
+        auto length = std::min(text.size(), MAX_LINE_LENGTH);
+
+        memcpy(slot.output + used, text.data(), length);
+        used += length;
+        slot.output[used++] = '\n';
+    }
+
+    return used;
+}
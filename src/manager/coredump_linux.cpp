@@ -38,10 +38,15 @@
 
 #include "coredump_linux.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
 #include <elf.h>
 #include <signal.h>
-#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace bmboot;
 using namespace bmboot::internal;
@@ -50,6 +55,16 @@ using std::as_bytes;
 using std::byte;
 using std::span;
 
+// Granularity of zero-page detection, and alignment of the segment contents in the file
+static constexpr size_t PAGESIZE = 4096;
+
+// Runs of zero pages shorter than this are kept inside the surrounding segment (as file holes, if possible),
+// to keep the number of program headers in check
+static constexpr size_t MIN_SPLIT_GAP = 16 * PAGESIZE;
+
+// Maximum size of a single write of segment contents
+static constexpr size_t MAX_WRITE_SIZE = 1024 * 1024;
+
 // ************************************************************
 
 template<size_t alignment>
@@ -61,44 +76,203 @@ static auto make_padding_span(size_t length)
     return span{zeros, padding_needed};
 }
 
-static bool write_note(FILE* f, const char* name, Elf64_Word type, span<byte const> desc)
+static void append(std::vector<byte>& buffer, span<byte const> data)
+{
+    buffer.insert(buffer.end(), data.begin(), data.end());
+}
+
+static void write_note(std::vector<byte>& buffer, const char* name, Elf64_Word type, span<byte const> desc)
 {
     auto terminated_name_len = strlen(name) + 1;
     auto nhdr = Elf64_Nhdr { .n_namesz = (Elf64_Word) terminated_name_len,
                              .n_descsz = (Elf64_Word) desc.size(),
                              .n_type = type };
 
-    auto name_padding = make_padding_span<4>(terminated_name_len);
+    append(buffer, as_bytes(span{&nhdr, 1}));
+    append(buffer, as_bytes(span{name, terminated_name_len}));
+    append(buffer, make_padding_span<4>(terminated_name_len));
+    append(buffer, desc);
+    append(buffer, make_padding_span<4>(desc.size()));
+}
 
-    if (fwrite(&nhdr, 1, sizeof(nhdr), f) != sizeof(nhdr)
-            || fwrite(name, 1, terminated_name_len, f) != terminated_name_len
-            || fwrite(name_padding.data(), 1, name_padding.size(), f) != name_padding.size()
-            || fwrite(desc.data(), 1, desc.size(), f) != desc.size())
+bool internal::isZeroMemory(void const* ptr, size_t size)
+{
+    auto bytes = (byte const*) ptr;
+    auto words = (uint64_t const*) ptr;
+
+    for (size_t i = 0; i < size / sizeof(uint64_t); i++)
     {
-        return false;
+        if (words[i] != 0)
+        {
+            return false;
+        }
+    }
+
+    return std::all_of(bytes + size / sizeof(uint64_t) * sizeof(uint64_t), bytes + size,
+                       [](byte b) { return b == byte {0}; });
+}
+
+// ************************************************************
+
+namespace
+{
+
+// Sequential output to a regular file, pipe or socket. On regular files, skipped ranges become holes.
+class CoreWriter
+{
+public:
+    explicit CoreWriter(int fd) : m_fd(fd)
+    {
+        // A hole only reads as zeros if there was nothing in the file before, so the file is emptied first.
+        // If that is not possible, the skipped ranges are written out like on a pipe.
+        struct stat st;
+        m_seekable = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && lseek(fd, 0, SEEK_CUR) == 0 &&
+                      ftruncate(fd, 0) == 0);
+    }
+
+    bool write(span<byte const> data)
+    {
+        while (!data.empty())
+        {
+            auto written = m_seekable ? ::pwrite(m_fd, data.data(), data.size(), m_offset)
+                                      : ::write(m_fd, data.data(), data.size());
+
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (written <= 0)
+            {
+                return false;
+            }
+
+            m_offset += written;
+            data = data.subspan(written);
+        }
+
+        return true;
+    }
+
+    bool skip(size_t length)
+    {
+        if (m_seekable)
+        {
+            m_offset += length;
+            return true;
+        }
+
+        static const byte zeros[PAGESIZE] {};
+
+        for (; length > 0; length -= std::min(length, sizeof(zeros)))
+        {
+            if (!write(span{zeros, std::min(length, sizeof(zeros))}))
+            {
+                return false;
+            }
+        }
+
+        return true;
     }
 
-    return true;
+    bool finish()
+    {
+        // A trailing hole does not extend the file by itself
+        return !m_seekable || ftruncate(m_fd, m_offset) == 0;
+    }
+
+private:
+    int m_fd;
+    bool m_seekable;
+    off_t m_offset = 0;
+};
+
+// A range of a memory segment, described by one PT_LOAD program header
+struct LoadSegment
+{
+    intptr_t start_address;
+    size_t size;
+    byte const* ptr;            // nullptr if all zeros (no contents in the file)
+    size_t first_page;          // index into zero_pages
+};
+
 }
 
 // ************************************************************
 
-void internal::writeCoreDump(char const *fn,
+bool internal::writeCoreDump(int fd,
                              span<MemorySegment const> segments,
                              Aarch64_Regs const& the_regs,
                              Aarch64_FpRegs const& fpregs)
 {
-    // Note: This code is derived from an older implementation by Google; it is quite fragile in how the offsets are
-    //       computed and separate concerns are mixed together.
-    //       A cleaner solution would be to prepare a high-level representation of the ELF structure in memory and then
-    //       have separate code that serializes it to disk.
-
     int const NUM_THREADS = 1;
-    size_t const PAGESIZE = 4096;       // TODO: can we make this assumption and does it matter?
 
-    FILE* f = fopen(fn, "wb");
+    // Find out which pages are in use, and split the segments around long runs of unused ones
+    std::vector<bool> zero_pages;
+    std::vector<LoadSegment> load_segments;
+
+    for (const auto& seg : segments)
+    {
+        auto data = (byte const*) seg.ptr;
+        auto num_pages = (seg.size + PAGESIZE - 1) / PAGESIZE;
+        auto first_page = zero_pages.size();
+
+        for (size_t i = 0; i < num_pages; i++)
+        {
+            zero_pages.push_back(!data || isZeroMemory(data + i * PAGESIZE, std::min(PAGESIZE, seg.size - i * PAGESIZE)));
+        }
+
+        for (size_t i = 0; i < num_pages; )
+        {
+            // Extend the run while the page class stays the same; short zero runs do not interrupt a non-zero run
+            auto is_zero = zero_pages[first_page + i];
+            auto end = i + 1;
+
+            while (end < num_pages)
+            {
+                if (zero_pages[first_page + end] == is_zero)
+                {
+                    end++;
+                    continue;
+                }
+
+                if (is_zero)
+                {
+                    break;
+                }
+
+                auto gap_end = end;
+
+                while (gap_end < num_pages && zero_pages[first_page + gap_end])
+                {
+                    gap_end++;
+                }
+
+                if (gap_end < num_pages && (gap_end - end) * PAGESIZE < MIN_SPLIT_GAP)
+                {
+                    end = gap_end;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            auto run_size = std::min(end * PAGESIZE, seg.size) - i * PAGESIZE;
+
+            load_segments.push_back(LoadSegment {
+                .start_address = seg.start_address + (intptr_t) (i * PAGESIZE),
+                .size = run_size,
+                .ptr = is_zero ? nullptr : data + i * PAGESIZE,
+                .first_page = first_page + i,
+            });
+
+            i = end;
+        }
+    }
+
+    // Build the ELF header, program headers and notes in memory
+    std::vector<byte> headers;
 
-    // Write out the ELF header
     Elf64_Ehdr ehdr;
     memset(&ehdr, 0, sizeof(ehdr));
     ehdr.e_ident[0] = ELFMAG0;
@@ -114,110 +288,111 @@ void internal::writeCoreDump(char const *fn,
     ehdr.e_phoff    = sizeof(ehdr);
     ehdr.e_ehsize   = sizeof(ehdr);
     ehdr.e_phentsize= sizeof(Elf64_Phdr);
-    ehdr.e_phnum    = segments.size() + 1;
+    ehdr.e_phnum    = load_segments.size() + 1;
     ehdr.e_shentsize= sizeof(Elf64_Shdr);
 
-    if (fwrite(&ehdr, 1, sizeof(ehdr), f) != sizeof(ehdr))
+    append(headers, as_bytes(span{&ehdr, 1}));
+
+    // Notes
+    std::vector<byte> notes;
+
+    elf_prpsinfo prpsinfo = {};
+    // TODO: could include payload name & hash (if we had those)
+    strncpy(prpsinfo.pr_psargs, "(bmboot payload)", sizeof(prpsinfo.pr_psargs));
+    write_note(notes, "CORE", NT_PRPSINFO, as_bytes(span{&prpsinfo, 1}));
+
+    for (int thread = 0; thread < NUM_THREADS; thread++)
     {
-        return;
+        // Process status and integer registers
+        elf_prstatus prstatus {};
+        prstatus.pr_pid = 1;
+        static_assert(sizeof(prstatus.pr_reg) == sizeof(the_regs));
+        memcpy(&prstatus.pr_reg, &the_regs, sizeof(the_regs));
+        write_note(notes, "CORE", NT_PRSTATUS, as_bytes(span{&prstatus, 1}));
+
+        // FPU registers
+        write_note(notes, "CORE", NT_FPREGSET, as_bytes(span{&fpregs, 1}));
     }
 
-    // Write program headers, starting with the PT_NOTE entry
-    Elf64_Phdr phdr;
-    size_t offset   = sizeof(Elf64_Ehdr) + ehdr.e_phnum * sizeof(phdr);
-    size_t filesz   = sizeof(Elf64_Nhdr) + 8 + sizeof(elf_prpsinfo) + NUM_THREADS * (
-                        sizeof(Elf64_Nhdr) + 8 + sizeof(elf_prstatus) +
-                        sizeof(Elf64_Nhdr) + 8 + sizeof(fpregs));
+    // Program headers, starting with the PT_NOTE entry
+    size_t offset = sizeof(Elf64_Ehdr) + ehdr.e_phnum * sizeof(Elf64_Phdr);
 
+    Elf64_Phdr phdr;
     memset(&phdr, 0, sizeof(phdr));
     phdr.p_type     = PT_NOTE;
     phdr.p_offset   = offset;
-    phdr.p_filesz   = filesz;
+    phdr.p_filesz   = notes.size();
+    append(headers, as_bytes(span{&phdr, 1}));
+
+    // Segment contents start at the next page boundary, and each occupies a whole number of pages
+    offset = (offset + notes.size() + PAGESIZE - 1) / PAGESIZE * PAGESIZE;
 
-    if (fwrite(&phdr, 1, sizeof(phdr), f) != sizeof(phdr))
+    for (const auto& seg : load_segments)
     {
-        return;
+        memset(&phdr, 0, sizeof(phdr));
+        phdr.p_type     = PT_LOAD;
+        phdr.p_flags    = PF_R | PF_X | PF_W;
+        phdr.p_align    = PAGESIZE;
+        phdr.p_vaddr    = seg.start_address;
+        phdr.p_memsz    = seg.size;
+        // All-zero ranges are not stored in the file at all; the debugger fills them in by itself
+        phdr.p_filesz   = seg.ptr ? seg.size : 0;
+        phdr.p_offset   = seg.ptr ? offset : 0;
+        append(headers, as_bytes(span{&phdr, 1}));
+
+        if (seg.ptr)
+        {
+            offset += (seg.size + PAGESIZE - 1) / PAGESIZE * PAGESIZE;
+        }
     }
 
-    // Now follow with program headers for each of the memory segments
-    phdr.p_type     = PT_LOAD;
-    phdr.p_align    = PAGESIZE;
-    phdr.p_paddr    = 0;
-    auto note_align = phdr.p_align - ((offset + filesz) % phdr.p_align);
+    append(headers, notes);
+    headers.resize((headers.size() + PAGESIZE - 1) / PAGESIZE * PAGESIZE);
+
+    // Write it all out
+    CoreWriter writer(fd);
 
-    if (note_align == phdr.p_align)
+    if (!writer.write(headers))
     {
-        note_align = 0;
+        return false;
     }
 
-    offset         += note_align;
-    for (const auto& seg : segments)
+    for (const auto& seg : load_segments)
     {
-        offset       += filesz;
-        filesz        = seg.size;
-        phdr.p_offset = offset;
-        phdr.p_vaddr  = seg.start_address;
-        phdr.p_memsz  = filesz;
-
-        /* Do not write contents for memory segments that are read-only  */
-//            if ((mappings[i].flags & PF_W) == 0)
-//                filesz      = 0;
-        phdr.p_filesz = filesz;
-        phdr.p_flags  = PF_R | PF_X | PF_W; //mappings[i].flags;
-
-        if (fwrite(&phdr, 1, sizeof(phdr), f) != sizeof(phdr))
+        if (!seg.ptr)
         {
-            return;
+            continue;
         }
-    }
 
-    // Write note section
-    elf_prpsinfo prpsinfo = {};
-    // TODO: could include payload name & hash (if we had those)
-    strncpy(prpsinfo.pr_psargs, "(bmboot payload)", sizeof(prpsinfo.pr_psargs));
-
-    if (!write_note(f, "CORE", NT_PRPSINFO, as_bytes(span{&prpsinfo, 1})))
-    {
-        return;
-    }
+        auto num_pages = (seg.size + PAGESIZE - 1) / PAGESIZE;
 
-    // Process status and integer registers
-    elf_prstatus prstatus {};
-    prstatus.pr_pid = 1;
-    static_assert(sizeof(prstatus.pr_reg) == sizeof(the_regs));
-    memcpy(&prstatus.pr_reg, &the_regs, sizeof(the_regs));
+        for (size_t i = 0; i < num_pages; )
+        {
+            // Skip zero pages, write out runs of the others in large chunks
+            auto end = i + 1;
+            auto is_zero = zero_pages[seg.first_page + i];
 
-    if (!write_note(f, "CORE", NT_PRSTATUS, as_bytes(span{&prstatus, 1})))
-    {
-        return;
-    }
+            while (end < num_pages && zero_pages[seg.first_page + end] == is_zero && (end - i) * PAGESIZE < MAX_WRITE_SIZE)
+            {
+                end++;
+            }
 
-    // FPU registers
-    if (!write_note(f, "CORE", NT_FPREGSET, as_bytes(span{&fpregs, 1})))
-    {
-        return;
-    }
+            auto length = std::min(end * PAGESIZE, seg.size) - i * PAGESIZE;
+            auto ok = is_zero ? writer.skip(length) : writer.write(span{seg.ptr + i * PAGESIZE, length});
 
-    // Align all following segments to multiples of page size
-    if (note_align)
-    {
-        char scratch[note_align];
+            if (!ok)
+            {
+                return false;
+            }
 
-        memset(scratch, 0, sizeof(scratch));
-        if (fwrite(scratch, 1, sizeof(scratch), f) != sizeof(scratch))
-        {
-            return;
+            i = end;
         }
-    }
 
-    // Write all memory segments
-    for (const auto& seg : segments)
-    {
-        if (/*(seg.flags & PF_W) &&*/ fwrite(seg.ptr, 1, seg.size, f) != seg.size)
+        if (!writer.skip((PAGESIZE - seg.size % PAGESIZE) % PAGESIZE))
         {
-            return;
+            return false;
         }
     }
 
-    fclose(f);
+    return writer.finish();
 }
@@ -17,10 +17,16 @@ struct MemorySegment
 {
     intptr_t start_address;
     size_t size;
-    void const* ptr;
+    void const* ptr;            // nullptr if the memory is known to contain only zeros
 };
 
-void writeCoreDump(char const *fn,
+// Check whether a block of memory contains only zeros
+bool isZeroMemory(void const* ptr, size_t size);
+
+// Write a core dump to a file descriptor, which can be a regular file as well as a pipe.
+// Pages that contain only zeros are left out: short runs become holes in the file (or are written out, if it is not
+// seekable), long runs become PT_LOAD segments without file contents. Returns false if writing failed.
+bool writeCoreDump(int fd,
                    std::span<MemorySegment const> segments,
                    Aarch64_Regs const& the_regs,
                    Aarch64_FpRegs const& fpregs);
@@ -4,8 +4,12 @@
 
 #include "../bmboot_internal.hpp"
 #include "bmboot/domain.hpp"
+#include "bmboot/domain_group.hpp"
 #include "bmboot/manager_configuration.hpp"
 #include "coredump_linux.hpp"
+#include "elf_file.hpp"
+#include "stdout_ring.hpp"
+#include "../utility/crc32.hpp"
 #include "../utility/mmap.hpp"
 
 #include "monitor_zynqmp_cpu1.hpp"
@@ -15,8 +19,12 @@
 // This, of course, negates any attempt to keep platform-specific stuff contained.
 #include "zynqmp_manager.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <thread>
 #include <variant>
+#include <vector>
 
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -24,6 +32,8 @@
 
 using namespace bmboot;
 using namespace bmboot::internal;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
 
 static int s_devmem_handle = -1;
 
@@ -53,6 +63,18 @@ struct PhysicalMemoryRanges
     size_t monitor_ipc_size;
     intptr_t payload_address;
     size_t payload_size;
+    intptr_t stdout_address;
+    size_t stdout_size;
+    intptr_t telemetry_address;
+    size_t telemetry_size;
+    intptr_t log_address;
+    size_t log_size;
+    intptr_t profile_address;
+    size_t profile_size;
+    intptr_t irq_stats_address;
+    size_t irq_stats_size;
+    intptr_t scheduler_address;
+    size_t scheduler_size;
 };
 
 static PhysicalMemoryRanges const& getPhysicalMemoryRanges(DomainIndex domain);
@@ -62,37 +84,101 @@ static PhysicalMemoryRanges const& getPhysicalMemoryRanges(DomainIndex domain);
 class Domain : public IDomain
 {
 public:
-    Domain(DomainIndex domain, IpcBlock& ipc_block) : m_domain(domain), m_ipc_block(ipc_block) {}
+    Domain(DomainIndex domain,
+           Mmap ipc_area,
+           Mmap monitor_area,
+           Mmap payload_area,
+           Mmap stdout_area,
+           Mmap telemetry_area,
+           Mmap log_area,
+           Mmap profile_area,
+           Mmap irq_stats_area,
+           Mmap scheduler_area)
+            : m_domain(domain),
+              m_ipc_area(std::move(ipc_area)),
+              m_monitor_area(std::move(monitor_area)),
+              m_payload_area(std::move(payload_area)),
+              m_stdout_area(std::move(stdout_area)),
+              m_telemetry_area(std::move(telemetry_area)),
+              m_log_area(std::move(log_area)),
+              m_profile_area(std::move(profile_area)),
+              m_irq_stats_area(std::move(irq_stats_area)),
+              m_scheduler_area(std::move(scheduler_area)),
+              m_ipc_block(*(IpcBlock*) m_ipc_area.data())
+    {
+    }
 
     MaybeError dumpCore(char const* filename) final;
+    MaybeError dumpCore(int fd) final;
+    MaybeError snapshot(int fd, SnapshotMode mode) final;
+    MaybeError snapshot(char const* filename, SnapshotMode mode) final;
     void dumpDebugInfo() final;
     MaybeError ensureReadyToLoadPayload() final;
     MaybeError loadAndStartPayload(std::span<uint8_t const> payload_binary,
                                    uint32_t payload_crc32,
                                    uintptr_t payload_argument) final;
+    MaybeError loadAndStartPayload(std::span<uint8_t const> payload_binary,
+                                   uintptr_t payload_argument) final;
     MaybeError loadElfPayload(std::span<uint8_t const> payload_binary,
                               uintptr_t payload_argument) final;
+    MaybeError loadPayloadFromFile(std::filesystem::path const& path,
+                                   uintptr_t payload_argument) final;
     int getchar() final;
+    size_t readStdout(std::span<char> buffer) final;
+    size_t readStdoutLine(std::span<char> buffer) final;
+    uint64_t getStdoutDroppedBytes() final;
+    size_t getStdoutPendingBytes() final;
+    void setStdoutOverflowPolicy(StdoutOverflowPolicy policy, microseconds block_timeout) final;
+    size_t readTelemetry(std::span<TelemetryRecord> records) final;
+    uint32_t getTelemetryDroppedCount() final;
+    size_t readLog(std::span<LogRecord> records) final;
+    std::optional<ClockSample> sampleExecutorClock(microseconds timeout) final;
+    uint32_t getLogDroppedCount() final;
+    size_t getLogPendingCount() final;
+    void setLogLevel(LogLevel level) final;
+    MaybeError startProfiler(ProfilerSettings const& settings) final;
+    MaybeError stopProfiler() final;
+    size_t readProfileSamples(std::span<ProfileSample> samples) final;
+    uint32_t getProfileDroppedCount() final;
+    MaybeError startPerfCounters(std::span<pmu::Event const> events) final;
+    MaybeError stopPerfCounters() final;
+    std::optional<PerfCounterValues> readPerfCounters() final;
+    std::optional<IrqStatistics> readIrqStatistics() final;
+    void resetIrqStatistics() final;
+    std::optional<SchedulerStatistics> readSchedulerStatistics() final;
+    void resetSchedulerStatistics() final;
     CrashInfo getCrashInfo() final;
     DomainIndex getIndex() const final { return m_domain; }
     DomainState getState() final;
+    WaitPolicy const& getWaitPolicy() const final { return m_wait_policy; }
+    void setWaitPolicy(WaitPolicy policy) final;
     MaybeError terminatePayload() final;
     MaybeError startup() final;
+    MaybeError waitForState(DomainState state, microseconds timeout) final;
 
     void startDummyPayload() final
     {
         // we _know_ that this will time out, don't bother checking the result
-        startPayloadAt(0xbaadf00d, 0, 0, 0);
+        startPayloadAt(0xbaadf00d, 0, 0, 0, {});
     }
 
 private:
+    friend class bmboot::DomainGroup;
+
+    std::optional<Response> awaitCommandAck(microseconds timeout);
     MaybeError awaitMonitorStartup();
+    MaybeError beginStartup(std::span<uint8_t const> monitor_binary);
+    std::span<uint8_t const> getMonitorBinary() const;
+    MaybeError loadToPayloadArea(uintptr_t address, std::span<uint8_t const> binary, uint32_t* crc32_out = nullptr);
     PhysicalMemoryRanges const& getPhysicalMemoryRanges() { return ::getPhysicalMemoryRanges(m_domain); }
     MaybeError startPayloadAt(uintptr_t entry_address,
                               size_t payload_size,
                               uint32_t payload_crc32,
-                              uintptr_t payload_argument);
-    MaybeError startup(std::span<uint8_t const> monitor_binary);
+                              uintptr_t payload_argument,
+                              std::span<MemoryRange const> segments);
+    template <typename Predicate>
+    bool waitUntil(microseconds timeout, Predicate&& condition);
+    MaybeError sendIpiRequest(uint32_t request);
 
 //    volatile IpcBlock& getIpcBlock()
 //    {
@@ -114,8 +200,66 @@ private:
         return m_ipc_block.executor_to_manager;
     }
 
+    volatile auto& getStdoutRingHeader()
+    {
+        return *(StdoutRingHeader volatile*) m_stdout_area.data();
+    }
+
+    StdoutRingView getStdoutRing()
+    {
+        auto& header = getStdoutRingHeader();
+
+        return StdoutRingView {
+            .buf = (char const*) m_stdout_area.data() + sizeof(StdoutRingHeader),
+            .capacity = getStdoutRingCapacity(getPhysicalMemoryRanges().stdout_size),
+            .wrpos = &header.wrpos,
+            .rdpos = &header.rdpos,
+        };
+    }
+
+    volatile auto& getTelemetryRing()
+    {
+        return *(TelemetryRingHeader volatile*) m_telemetry_area.data();
+    }
+
+    volatile auto& getLogRing()
+    {
+        return *(LogRingHeader volatile*) m_log_area.data();
+    }
+
+    volatile auto& getProfileRing()
+    {
+        return *(ProfileRingHeader volatile*) m_profile_area.data();
+    }
+
+    volatile auto& getIrqStatsBlock()
+    {
+        return *(IrqStatsBlock volatile*) m_irq_stats_area.data();
+    }
+
+    volatile auto& getSchedulerBlock()
+    {
+        return *(SchedulerBlock volatile*) m_scheduler_area.data();
+    }
+
     DomainIndex m_domain;
+
+    // These mappings are kept for the lifetime of the Domain object
+    Mmap m_ipc_area;
+    Mmap m_monitor_area;
+    Mmap m_payload_area;
+    Mmap m_stdout_area;
+    Mmap m_telemetry_area;
+    Mmap m_log_area;
+    Mmap m_profile_area;
+    Mmap m_irq_stats_area;
+    Mmap m_scheduler_area;
+
     IpcBlock& m_ipc_block;
+    WaitPolicy m_wait_policy;
+
+    // CRC-32 of each page of the payload area as of the last snapshot; empty if there has been none
+    std::vector<uint32_t> m_snapshot_page_crcs;
 };
 
 // ************************************************************
@@ -145,6 +289,18 @@ static PhysicalMemoryRanges const& getPhysicalMemoryRanges(DomainIndex domain)
         .monitor_ipc_size = bmboot_cpu1_monitor_ipc_SIZE,
         .payload_address = bmboot_cpu1_payload_ADDRESS,
         .payload_size = bmboot_cpu1_payload_SIZE,
+        .stdout_address = bmboot_cpu1_stdout_ADDRESS,
+        .stdout_size = bmboot_cpu1_stdout_SIZE,
+        .telemetry_address = bmboot_cpu1_telemetry_ADDRESS,
+        .telemetry_size = bmboot_cpu1_telemetry_SIZE,
+        .log_address = bmboot_cpu1_log_ADDRESS,
+        .log_size = bmboot_cpu1_log_SIZE,
+        .profile_address = bmboot_cpu1_profile_ADDRESS,
+        .profile_size = bmboot_cpu1_profile_SIZE,
+        .irq_stats_address = bmboot_cpu1_irq_stats_ADDRESS,
+        .irq_stats_size = bmboot_cpu1_irq_stats_SIZE,
+        .scheduler_address = bmboot_cpu1_scheduler_ADDRESS,
+        .scheduler_size = bmboot_cpu1_scheduler_SIZE,
     };
 
     static PhysicalMemoryRanges cpu2
@@ -155,6 +311,18 @@ static PhysicalMemoryRanges const& getPhysicalMemoryRanges(DomainIndex domain)
         .monitor_ipc_size = bmboot_cpu2_monitor_ipc_SIZE,
         .payload_address = bmboot_cpu2_payload_ADDRESS,
         .payload_size = bmboot_cpu2_payload_SIZE,
+        .stdout_address = bmboot_cpu2_stdout_ADDRESS,
+        .stdout_size = bmboot_cpu2_stdout_SIZE,
+        .telemetry_address = bmboot_cpu2_telemetry_ADDRESS,
+        .telemetry_size = bmboot_cpu2_telemetry_SIZE,
+        .log_address = bmboot_cpu2_log_ADDRESS,
+        .log_size = bmboot_cpu2_log_SIZE,
+        .profile_address = bmboot_cpu2_profile_ADDRESS,
+        .profile_size = bmboot_cpu2_profile_SIZE,
+        .irq_stats_address = bmboot_cpu2_irq_stats_ADDRESS,
+        .irq_stats_size = bmboot_cpu2_irq_stats_SIZE,
+        .scheduler_address = bmboot_cpu2_scheduler_ADDRESS,
+        .scheduler_size = bmboot_cpu2_scheduler_SIZE,
     };
 
     static PhysicalMemoryRanges cpu3
@@ -165,6 +333,18 @@ static PhysicalMemoryRanges const& getPhysicalMemoryRanges(DomainIndex domain)
         .monitor_ipc_size = bmboot_cpu3_monitor_ipc_SIZE,
         .payload_address = bmboot_cpu3_payload_ADDRESS,
         .payload_size = bmboot_cpu3_payload_SIZE,
+        .stdout_address = bmboot_cpu3_stdout_ADDRESS,
+        .stdout_size = bmboot_cpu3_stdout_SIZE,
+        .telemetry_address = bmboot_cpu3_telemetry_ADDRESS,
+        .telemetry_size = bmboot_cpu3_telemetry_SIZE,
+        .log_address = bmboot_cpu3_log_ADDRESS,
+        .log_size = bmboot_cpu3_log_SIZE,
+        .profile_address = bmboot_cpu3_profile_ADDRESS,
+        .profile_size = bmboot_cpu3_profile_SIZE,
+        .irq_stats_address = bmboot_cpu3_irq_stats_ADDRESS,
+        .irq_stats_size = bmboot_cpu3_irq_stats_SIZE,
+        .scheduler_address = bmboot_cpu3_scheduler_ADDRESS,
+        .scheduler_size = bmboot_cpu3_scheduler_SIZE,
     };
 
     switch (domain)
@@ -176,65 +356,80 @@ static PhysicalMemoryRanges const& getPhysicalMemoryRanges(DomainIndex domain)
     }
 }
 
-static MaybeError load_to_physical_memory(uintptr_t address, std::span<uint8_t const> binary)
+static Mmap mapPhysicalMemory(int devmem_fd, uintptr_t address, size_t size, MappingOptions const& options)
 {
-    auto devmem = get_devmem_handle();
-    if (std::holds_alternative<ErrorCode>(devmem))
+    constexpr size_t large_page_size = 2 * 1024 * 1024;
+
+    auto flags = MAP_SHARED | (options.populate ? MAP_POPULATE : 0);
+
+    if (options.large_page_alignment)
     {
-        return std::get<ErrorCode>(devmem);
+        return Mmap::mapAligned(large_page_size, size, PROT_READ | PROT_WRITE, flags, devmem_fd, address);
     }
+    else
+    {
+        return Mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, devmem_fd, address);
+    }
+}
 
-    // TODO: assert that address is aligned
-
-    // FIXME: assuming 4k pages
-    const auto alignment = 4096;
-    auto size_aligned = (binary.size() + alignment - 1) & ~(alignment - 1);
+// ************************************************************
 
-    Mmap code_area(nullptr,
-                   size_aligned,
-                   PROT_READ | PROT_WRITE,
-                   MAP_SHARED,
-                   std::get<int>(devmem),
-                   address);
+std::optional<Response> Domain::awaitCommandAck(microseconds timeout)
+{
+    auto const& inbox = getInbox();
+    auto const& outbox = getOutbox();
 
-    if (!code_area)
+    if (!waitUntil(timeout, [&] { return inbox.cmd_ack == outbox.cmd_seq; }))
     {
-        return ErrorCode::mmap_failed;
+        return {};
     }
 
-    memcpy(code_area.data(), binary.data(), binary.size());
+    return inbox.cmd_resp;
+}
 
-    __clear_cache(code_area.data(), (uint8_t*) code_area.data() + size_aligned);
+// ************************************************************
 
-    code_area.unmap();
+MaybeError Domain::awaitMonitorStartup()
+{
+    // should normally take around 130 ms
+    if (waitForState(DomainState::monitor_ready, m_wait_policy.monitor_startup_timeout).has_value())
+    {
+        return ErrorCode::monitor_start_timed_out;
+    }
 
     return {};
 }
 
 // ************************************************************
 
-MaybeError Domain::awaitMonitorStartup()
+MaybeError Domain::dumpCore(char const* filename)
 {
-    // wait up to 0.5sec for monitor to come to life; should normally take around 130 ms
-    constexpr int timeout_msec = 500;
-    constexpr int poll_period_msec = 10;
+    auto state = getState();
 
-    for (int i = 0; i < timeout_msec / poll_period_msec; i++)
+    // Check before creating the file, so as not to leave an empty one behind
+    if (state != DomainState::crashed_payload && state != DomainState::crashed_monitor)
     {
-        usleep(poll_period_msec * 1000);
+        return ErrorCode::bad_domain_state;
+    }
 
-        if (getState() == DomainState::monitor_ready)
-        {
-            return {};
-        }
+    int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        return ErrorCode::core_dump_failed;
     }
 
-    return ErrorCode::monitor_start_timed_out;
-}
+    auto err = dumpCore(fd);
 
-// ************************************************************
+    if (::close(fd) != 0 && !err.has_value())
+    {
+        return ErrorCode::core_dump_failed;
+    }
 
-MaybeError Domain::dumpCore(char const* filename)
+    return err;
+}
+
+MaybeError Domain::dumpCore(int fd)
 {
     auto state = getState();
 
@@ -244,37 +439,167 @@ MaybeError Domain::dumpCore(char const* filename)
         return ErrorCode::bad_domain_state;
     }
 
-    auto devmem = get_devmem_handle();
-    if (std::holds_alternative<ErrorCode>(devmem))
+    auto& ranges = getPhysicalMemoryRanges();
+    auto& inbox = getInboxNonvolatile();
+
+    const MemorySegment segments[]
     {
-        return std::get<ErrorCode>(devmem);
+            { ranges.payload_address, ranges.payload_size, m_payload_area.data() },
+    };
+
+    if (!writeCoreDump(fd, segments, inbox.regs, inbox.fpregs))
+    {
+        return ErrorCode::core_dump_failed;
+    }
+
+    return {};
+}
+
+// ************************************************************
+
+MaybeError Domain::snapshot(char const* filename, SnapshotMode mode)
+{
+    // Check before creating the file, so as not to leave an empty one behind
+    if (getState() != DomainState::running_payload)
+    {
+        return ErrorCode::bad_domain_state;
     }
 
+    int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        return ErrorCode::core_dump_failed;
+    }
+
+    auto err = snapshot(fd, mode);
+
+    if (::close(fd) != 0 && !err.has_value())
+    {
+        return ErrorCode::core_dump_failed;
+    }
+
+    return err;
+}
+
+MaybeError Domain::snapshot(int fd, SnapshotMode mode)
+{
+    constexpr size_t SNAPSHOT_PAGE_SIZE = 4096;
+
+    if (getState() != DomainState::running_payload)
+    {
+        return ErrorCode::bad_domain_state;
+    }
+
+    enum class Page : uint8_t { omitted, zero, copied };
+
     auto& ranges = getPhysicalMemoryRanges();
+    auto memory = (std::byte const*) m_payload_area.data();
+    auto num_pages = ranges.payload_size / SNAPSHOT_PAGE_SIZE;
+    auto incremental = (mode == SnapshotMode::incremental && m_snapshot_page_crcs.size() == num_pages);
 
-    Mmap code_area(nullptr,
-                   ranges.payload_size,
-                   PROT_READ | PROT_WRITE,
-                   MAP_SHARED,
-                   std::get<int>(devmem),
-                   ranges.payload_address);
+    // Take a first copy of the entire payload area while the payload is still running. Once it has been parked, only a
+    // comparison is needed to find the pages that have changed in the meantime; all other processing is done on the
+    // (consistent) copy after the payload has been released.
+    std::unique_ptr<std::byte[]> copy(new std::byte[ranges.payload_size]);
+    memcpy(copy.get(), memory, ranges.payload_size);
 
-    if (!code_area)
+    auto const& inbox = getInbox();
+    auto& outbox = getOutbox();
+
+    // Have the monitor park the payload
+    auto seq = outbox.snapshot_seq + 1;
+    outbox.snapshot_seq = seq;
+
+    if (auto err = sendIpiRequest(IPI_REQ_SNAPSHOT); err.has_value())
     {
-        return ErrorCode::mmap_failed;
+        outbox.snapshot_release = seq;
+        return err;
     }
 
-    auto& inbox = getInboxNonvolatile();
+    auto parked = waitUntil(m_wait_policy.snapshot_timeout, [&] { return inbox.snapshot_ack == seq; });
 
-    static const MemorySegment segments[]
+    if (!parked || inbox.snapshot_result != SnapshotResult::snapshot_parked)
     {
-            { ranges.payload_address, ranges.payload_size, code_area.data() },
-    };
+        // Should the monitor get to the request after all, it will not wait for us
+        outbox.snapshot_release = seq;
+        return parked ? ErrorCode::bad_domain_state : ErrorCode::state_wait_timed_out;
+    }
 
-    writeCoreDump(filename,
-                  segments,
-                  inbox.regs,
-                  inbox.fpregs);
+    auto regs = getInboxNonvolatile().snapshot_regs;
+    auto fpregs = getInboxNonvolatile().snapshot_fpregs;
+
+    for (size_t offset = 0; offset < ranges.payload_size; offset += SNAPSHOT_PAGE_SIZE)
+    {
+        if (memcmp(copy.get() + offset, memory + offset, SNAPSHOT_PAGE_SIZE) != 0)
+        {
+            memcpy(copy.get() + offset, memory + offset, SNAPSHOT_PAGE_SIZE);
+        }
+    }
+
+    // Our reads of the payload memory must be complete before it can resume
+    memory_barrier();
+    outbox.snapshot_release = seq;
+
+    // Decide which pages go into the snapshot; a full snapshot becomes the baseline for the next incremental one
+    static uint32_t const ZERO_PAGE_CRC = [] {
+        std::byte const zeros[SNAPSHOT_PAGE_SIZE] {};
+        return crc32(0, zeros, sizeof(zeros));
+    }();
+
+    std::vector<Page> pages(num_pages);
+    m_snapshot_page_crcs.resize(num_pages);
+
+    for (size_t i = 0; i < num_pages; i++)
+    {
+        auto page = copy.get() + i * SNAPSHOT_PAGE_SIZE;
+
+        if (incremental)
+        {
+            auto crc = crc32(0, page, SNAPSHOT_PAGE_SIZE);
+            pages[i] = (crc != m_snapshot_page_crcs[i]) ? Page::copied : Page::omitted;
+            m_snapshot_page_crcs[i] = crc;
+        }
+        else if (isZeroMemory(page, SNAPSHOT_PAGE_SIZE))
+        {
+            pages[i] = Page::zero;
+            m_snapshot_page_crcs[i] = ZERO_PAGE_CRC;
+        }
+        else
+        {
+            pages[i] = Page::copied;
+            m_snapshot_page_crcs[i] = crc32(0, page, SNAPSHOT_PAGE_SIZE);
+        }
+    }
+
+    // One segment per run of pages of the same kind
+    std::vector<MemorySegment> segments;
+
+    for (size_t i = 0; i < num_pages; )
+    {
+        auto end = i + 1;
+
+        while (end < num_pages && pages[end] == pages[i])
+        {
+            end++;
+        }
+
+        if (pages[i] != Page::omitted)
+        {
+            segments.push_back(MemorySegment {
+                .start_address = (intptr_t) (ranges.payload_address + i * SNAPSHOT_PAGE_SIZE),
+                .size = (end - i) * SNAPSHOT_PAGE_SIZE,
+                .ptr = (pages[i] == Page::copied) ? copy.get() + i * SNAPSHOT_PAGE_SIZE : nullptr,
+            });
+        }
+
+        i = end;
+    }
+
+    if (!writeCoreDump(fd, segments, regs, fpregs))
+    {
+        return ErrorCode::core_dump_failed;
+    }
 
     return {};
 }
@@ -283,9 +608,12 @@ MaybeError Domain::dumpCore(char const* filename)
 
 void Domain::dumpDebugInfo()
 {
-    fprintf(stderr, "debug: rdpos=%3zu wrpos=%3zu\n",
-            getOutbox().stdout_rdpos,
-            getInbox().stdout_wrpos);
+    auto& stdout_header = getStdoutRingHeader();
+
+    fprintf(stderr, "debug: rdpos=%3zu wrpos=%3zu dropped=%zu\n",
+            stdout_header.rdpos,
+            stdout_header.wrpos,
+            (size_t) stdout_header.dropped_bytes);
 }
 
 // ************************************************************
@@ -355,32 +683,594 @@ DomainState Domain::getState()
 
 int Domain::getchar()
 {
-    auto const& inbox = getInbox();
+    return stdoutRingGetchar(getStdoutRing());
+}
+
+// ************************************************************
+
+size_t Domain::readStdout(std::span<char> buffer)
+{
+    return stdoutRingRead(getStdoutRing(), buffer);
+}
+
+// ************************************************************
+
+size_t Domain::readStdoutLine(std::span<char> buffer)
+{
+    return stdoutRingReadLine(getStdoutRing(), buffer);
+}
+
+// ************************************************************
+
+uint64_t Domain::getStdoutDroppedBytes()
+{
+    return getStdoutRingHeader().dropped_bytes;
+}
+
+// ************************************************************
+
+size_t Domain::getStdoutPendingBytes()
+{
+    size_t rdpos, wrpos;
+    return stdoutRingSnapshot(getStdoutRing(), rdpos, wrpos);
+}
+
+// ************************************************************
+
+void Domain::setStdoutOverflowPolicy(StdoutOverflowPolicy policy, microseconds block_timeout)
+{
+    auto& header = getStdoutRingHeader();
+
+    header.block_timeout_us = std::clamp<microseconds::rep>(block_timeout.count(), 0, MAX_STDOUT_BLOCK_TIMEOUT_US);
+    header.overflow_mode = (policy == StdoutOverflowPolicy::block) ? StdoutOverflowMode::block
+                                                                   : StdoutOverflowMode::drop;
+}
+
+// ************************************************************
+
+// Count the pending records in a ring of fixed-size records
+template <typename Header>
+static size_t getRecordRingPending(Header volatile& ring, size_t capacity, uint32_t& rdpos, uint32_t& wrpos)
+{
+    rdpos = ring.rdpos;
+    wrpos = ring.wrpos;
+
+    if (rdpos >= capacity || wrpos >= capacity)
+    {
+        // Not initialized yet, or corrupted; either way, there is nothing we can read
+        return 0;
+    }
+
+    return (wrpos >= rdpos) ? (wrpos - rdpos) : (capacity - rdpos + wrpos);
+}
+
+// Copy out pending records from a ring of fixed-size records (telemetry, log or profile samples)
+template <typename Header, typename Record>
+static size_t readRecordRing(Header volatile& ring, Record const* slots, size_t capacity, std::span<Record> records)
+{
+    uint32_t rdpos, wrpos;
+    size_t pending = getRecordRingPending(ring, capacity, rdpos, wrpos);
+
+    if (pending == 0)
+    {
+        return 0;
+    }
+
+    // Do not let the record reads be hoisted above the write position read
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    auto count = std::min(pending, records.size());
+
+    // Copy out in (at most) two contiguous runs
+    auto first_run = std::min(count, capacity - rdpos);
+    memcpy(records.data(), slots + rdpos, first_run * sizeof(Record));
+    memcpy(records.data() + first_run, slots, (count - first_run) * sizeof(Record));
+
+    // The payload may only reuse the slots once we are done copying out of them
+    std::atomic_thread_fence(std::memory_order_release);
+    ring.rdpos = (rdpos + count) % capacity;
+
+    return count;
+}
+
+// ************************************************************
+
+size_t Domain::readTelemetry(std::span<TelemetryRecord> records)
+{
+    auto capacity = getTelemetryRingCapacity(getPhysicalMemoryRanges().telemetry_size);
+    auto slots = (TelemetryRecord const*) ((uint8_t const*) m_telemetry_area.data() + sizeof(TelemetryRingHeader));
+
+    return readRecordRing(getTelemetryRing(), slots, capacity, records);
+}
+
+// ************************************************************
+
+uint32_t Domain::getTelemetryDroppedCount()
+{
+    return getTelemetryRing().dropped;
+}
+
+// ************************************************************
+
+size_t Domain::readLog(std::span<LogRecord> records)
+{
+    auto capacity = getLogRingCapacity(getPhysicalMemoryRanges().log_size);
+    auto slots = (LogRecord const*) ((uint8_t const*) m_log_area.data() + sizeof(LogRingHeader));
+
+    return readRecordRing(getLogRing(), slots, capacity, records);
+}
+
+// ************************************************************
+
+uint32_t Domain::getLogDroppedCount()
+{
+    return getLogRing().dropped;
+}
+
+// ************************************************************
+
+size_t Domain::getLogPendingCount()
+{
+    uint32_t rdpos, wrpos;
+    return getRecordRingPending(getLogRing(), getLogRingCapacity(getPhysicalMemoryRanges().log_size), rdpos, wrpos);
+}
+
+// ************************************************************
+
+void Domain::setLogLevel(LogLevel level)
+{
+    getLogRing().level = level;
+}
+
+// ************************************************************
+
+MaybeError Domain::startProfiler(ProfilerSettings const& settings)
+{
+    auto state = getState();
+
+    if (state != DomainState::monitor_ready && state != DomainState::starting_payload &&
+        state != DomainState::running_payload)
+    {
+        return ErrorCode::bad_domain_state;
+    }
+
+    // Sampling any faster would leave the payload little time to do anything else
+    auto frequency = (int64_t) getOutbox().cntfrq;
+    auto ticks = std::clamp<int64_t>(settings.interval.count() * frequency / 1'000'000,
+                                     frequency / 100'000, UINT32_MAX);
+
+    // Start from an empty ring; samples left over from a previous run would only be confusing
+    auto& ring = getProfileRing();
+    ring.rdpos = ring.wrpos;
+    ring.interval_ticks = ticks;
+    ring.max_stack_depth = std::min(settings.max_stack_depth, ProfileSample::MAX_FRAMES);
+
+    return sendIpiRequest(IPI_REQ_PROFILE);
+}
+
+// ************************************************************
+
+MaybeError Domain::stopProfiler()
+{
+    getProfileRing().interval_ticks = 0;
+
+    // A monitor that is not running has nothing to stop; it will pick up the setting when it starts
+    if (domain_general_state[m_domain] != DomainGeneralState::monitorStarted)
+    {
+        return {};
+    }
+
+    return sendIpiRequest(IPI_REQ_PROFILE);
+}
+
+// ************************************************************
+
+size_t Domain::readProfileSamples(std::span<ProfileSample> samples)
+{
+    auto capacity = getProfileRingCapacity(getPhysicalMemoryRanges().profile_size);
+    auto slots = (ProfileSample const*) ((uint8_t const*) m_profile_area.data() + sizeof(ProfileRingHeader));
+
+    return readRecordRing(getProfileRing(), slots, capacity, samples);
+}
+
+// ************************************************************
+
+uint32_t Domain::getProfileDroppedCount()
+{
+    return getProfileRing().dropped;
+}
+
+// ************************************************************
+
+static_assert(MAX_PERF_EVENTS == pmu::MAX_COUNTERS);
+
+MaybeError Domain::startPerfCounters(std::span<pmu::Event const> events)
+{
+    if (domain_general_state[m_domain] != DomainGeneralState::monitorStarted)
+    {
+        return ErrorCode::bad_domain_state;
+    }
+
+    if (events.size() > MAX_PERF_EVENTS)
+    {
+        return ErrorCode::invalid_argument;
+    }
+
+    auto& outbox = getOutbox();
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        outbox.perf_events[i] = (uint16_t) events[i];
+    }
+
+    outbox.perf_num_events = events.size();
+    outbox.perf_enabled = 1;
+
+    // From now on, readPerfCounters waits for values that follow these settings
+    memory_write_reorder_barrier();
+    outbox.perf_request_seq = outbox.perf_request_seq + 1;
+
+    return sendIpiRequest(IPI_REQ_PERF);
+}
+
+// ************************************************************
+
+MaybeError Domain::stopPerfCounters()
+{
+    auto& outbox = getOutbox();
+
+    outbox.perf_enabled = 0;
+    memory_write_reorder_barrier();
+    outbox.perf_request_seq = outbox.perf_request_seq + 1;
+
+    // A monitor that is not running has nothing to stop; it will pick up the setting when it starts
+    if (domain_general_state[m_domain] != DomainGeneralState::monitorStarted)
+    {
+        return {};
+    }
+
+    return sendIpiRequest(IPI_REQ_PERF);
+}
+
+// ************************************************************
+
+std::optional<PerfCounterValues> Domain::readPerfCounters()
+{
+    auto& inbox = getInbox();
+
+    // The monitor updates the values only every few milliseconds and takes well under a microsecond to do so;
+    // a few retries are enough to get a consistent copy
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        auto seq = inbox.perf_seq;
+
+        if (seq % 2 != 0)
+        {
+            continue;
+        }
+
+        memory_barrier();
+
+        if (!inbox.perf_active || inbox.perf_request_ack != getOutbox().perf_request_seq)
+        {
+            return {};
+        }
+
+        PerfCounterValues values {};
+        values.timestamp = inbox.perf_timestamp;
+        values.timer_frequency = inbox.perf_timer_freq;
+        values.cycles = inbox.perf_cycles;
+        values.num_events = std::min<size_t>(inbox.perf_num_events, MAX_PERF_EVENTS);
+
+        for (size_t i = 0; i < values.num_events; i++)
+        {
+            values.events[i] = inbox.perf_events[i];
+        }
+
+        memory_barrier();
+
+        if (inbox.perf_seq == seq)
+        {
+            return values;
+        }
+    }
+
+    return {};
+}
+
+// ************************************************************
+
+// Take a consistent copy of a record that the payload might be updating right now
+static std::optional<TickHistogram> readIrqStatsRecord(IrqStatsRecord volatile const& record, uint32_t generation)
+{
+    // An update takes a few dozen cycles and happens with interrupts masked, so a few retries are plenty
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        auto seq = record.seq;
+
+        if (seq % 2 != 0)
+        {
+            continue;
+        }
+
+        memory_barrier();
+
+        if (record.generation != generation)
+        {
+            // Left over from before the last reset
+            return TickHistogram {};
+        }
+
+        TickHistogram histogram;
+        histogram.count = record.histogram.count;
+        histogram.total = record.histogram.total;
+        histogram.min = record.histogram.min;
+        histogram.max = record.histogram.max;
+
+        for (size_t bin = 0; bin < TickHistogram::NUM_BINS; bin++)
+        {
+            histogram.bins[bin] = record.histogram.bins[bin];
+        }
+
+        memory_barrier();
+
+        if (record.seq == seq)
+        {
+            return histogram;
+        }
+    }
+
+    return {};
+}
+
+std::optional<IrqStatistics> Domain::readIrqStatistics()
+{
+    auto& block = getIrqStatsBlock();
+
+    if (!block.instrumented)
+    {
+        return {};
+    }
+
+    auto generation = block.generation;
+
+    IrqStatistics statistics {};
+    statistics.timer_frequency = getOutbox().cntfrq;
+    statistics.timer_latency = readIrqStatsRecord(block.timer_latency, generation).value_or(TickHistogram {});
+
+    for (size_t i = 0; i < std::size(block.interrupts); i++)
+    {
+        auto histogram = readIrqStatsRecord(block.interrupts[i], generation);
+
+        if (histogram.has_value() && histogram->count != 0)
+        {
+            statistics.interrupts.push_back(InterruptStatistics {
+                .interrupt_id = (int) (GIC_MIN_USER_INTERRUPT_ID + i),
+                .duration = *histogram,
+            });
+        }
+    }
+
+    return statistics;
+}
+
+// ************************************************************
+
+void Domain::resetIrqStatistics()
+{
+    auto& block = getIrqStatsBlock();
+    block.generation = block.generation + 1;
+}
+
+// ************************************************************
+
+// Take a consistent copy of the statistics of a task, in the same way as readIrqStatsRecord
+static std::optional<TaskStatistics> readTaskStatistics(SchedulerTaskRecord volatile const& record, uint32_t generation)
+{
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        auto seq = record.seq;
+
+        if (seq % 2 != 0)
+        {
+            continue;
+        }
+
+        memory_barrier();
+
+        TaskStatistics statistics {};
+
+        // Left over from before the last reset, if the generation does not match
+        if (record.generation == generation)
+        {
+            statistics.releases = record.statistics.releases;
+            statistics.completions = record.statistics.completions;
+            statistics.overruns = record.statistics.overruns;
+            statistics.dropped = record.statistics.dropped;
+            statistics.total_execution = record.statistics.total_execution;
+            statistics.min_execution = record.statistics.min_execution;
+            statistics.max_execution = record.statistics.max_execution;
+            statistics.max_start_delay = record.statistics.max_start_delay;
+            statistics.max_lateness = record.statistics.max_lateness;
+        }
+
+        memory_barrier();
+
+        if (record.seq == seq)
+        {
+            return statistics;
+        }
+    }
+
+    return {};
+}
+
+std::optional<SchedulerStatistics> Domain::readSchedulerStatistics()
+{
+    auto& block = getSchedulerBlock();
+    auto num_tasks = std::min<size_t>(block.num_tasks, SchedulerBlock::MAX_TASKS);
+
+    if (num_tasks == 0)
+    {
+        return {};
+    }
+
+    memory_barrier();
+
+    auto generation = block.generation;
+
+    SchedulerStatistics statistics {};
+    statistics.timer_frequency = getOutbox().cntfrq;
+
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        auto const& record = block.tasks[i];
+
+        // The name is written once, before the number of tasks is published
+        char name[sizeof(record.name) + 1] {};
+
+        for (size_t j = 0; j < sizeof(record.name); j++)
+        {
+            name[j] = record.name[j];
+        }
+
+        statistics.tasks.push_back(ScheduledTask {
+            .name = name,
+            .period = record.period,
+            .offset = record.offset,
+            .priority = (int) record.priority,
+            .statistics = readTaskStatistics(record, generation).value_or(TaskStatistics {}),
+        });
+    }
+
+    return statistics;
+}
+
+// ************************************************************
+
+void Domain::resetSchedulerStatistics()
+{
+    auto& block = getSchedulerBlock();
+    block.generation = block.generation + 1;
+}
+
+// ************************************************************
+
+std::optional<ClockSample> Domain::sampleExecutorClock(microseconds timeout)
+{
+    auto state = getState();
+
+    if (state != DomainState::monitor_ready && state != DomainState::running_payload)
+    {
+        return {};
+    }
+
+    auto& inbox = getInbox();
     auto& outbox = getOutbox();
 
-    if (outbox.stdout_rdpos >= sizeof(inbox.stdout_buf))
+    auto seq = outbox.clock_sample_seq + 1;
+
+    // Do not sleep while waiting: any delay would be added to the uncertainty of the sample
+    auto before = steady_clock::now();
+    outbox.clock_sample_seq = seq;
+    send_event();
+
+    auto deadline = before + timeout;
+    auto after = before;
+
+    for (;;)
+    {
+        auto answered = (inbox.clock_sample_ack == seq);
+        after = steady_clock::now();
+
+        if (answered)
+        {
+            break;
+        }
+
+        if (after >= deadline)
+        {
+            return {};
+        }
+    }
+
+    // Do not let the sample reads be hoisted above the acknowledgement read
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return ClockSample {
+        .executor_ticks = inbox.clock_sample_counter,
+        .executor_frequency = inbox.clock_sample_freq,
+        .host_before = before,
+        .host_after = after,
+    };
+}
+
+// ************************************************************
+
+MaybeError Domain::loadToPayloadArea(uintptr_t address, std::span<uint8_t const> binary, uint32_t* crc32_out)
+{
+    auto& ranges = getPhysicalMemoryRanges();
+
+    if (address < (uintptr_t) ranges.payload_address ||
+        address + binary.size() > ranges.payload_address + ranges.payload_size)
+    {
+        return ErrorCode::program_too_large;
+    }
+
+    auto dest = (uint8_t*) m_payload_area.data() + (address - ranges.payload_address);
+
+    if (crc32_out)
+    {
+        *crc32_out = crc32_copy(0, dest, binary.data(), binary.size());
+    }
+    else
+    {
+        memcpy(dest, binary.data(), binary.size());
+    }
+
+    __clear_cache(dest, dest + binary.size());
+
+    return {};
+}
+
+// ************************************************************
+
+MaybeError Domain::loadAndStartPayload(std::span<uint8_t const> payload_binary,
+                                       uint32_t payload_crc32,
+                                       uintptr_t payload_argument)
+{
+    // First, ensure we are in 'ready' state
+    if (getState() != DomainState::monitor_ready)
     {
-        printf("bmboot: unexpected mst_stdout_rdpos %zx, resetting to 0\n", outbox.stdout_rdpos);
-        outbox.stdout_rdpos = 0;
+        return ErrorCode::bad_domain_state;
     }
 
-    if (outbox.stdout_rdpos != inbox.stdout_wrpos)
+    auto& ranges = getPhysicalMemoryRanges();
+
+    if (payload_binary.size() > ranges.payload_size)
     {
-        unsigned char c = inbox.stdout_buf[outbox.stdout_rdpos];
-        outbox.stdout_rdpos = (outbox.stdout_rdpos + 1) % sizeof(inbox.stdout_buf);
-        return c;
+        return ErrorCode::program_too_large;
     }
-    else
+
+    auto error = loadToPayloadArea(ranges.payload_address, payload_binary);
+
+    if (error.has_value())
     {
-        return -1;
+        return error;
     }
+
+    MemoryRange const segments[] { { (uintptr_t) ranges.payload_address, payload_binary.size() } };
+
+    return startPayloadAt(ranges.payload_address,
+                          payload_binary.size(),
+                          payload_crc32,
+                          payload_argument,
+                          segments);
 }
 
 // ************************************************************
 
-MaybeError Domain::loadAndStartPayload(std::span<uint8_t const> payload_binary,
-                                       uint32_t payload_crc32,
-                                       uintptr_t payload_argument)
+MaybeError Domain::loadAndStartPayload(std::span<uint8_t const> payload_binary, uintptr_t payload_argument)
 {
     // First, ensure we are in 'ready' state
     if (getState() != DomainState::monitor_ready)
@@ -395,17 +1285,22 @@ MaybeError Domain::loadAndStartPayload(std::span<uint8_t const> payload_binary,
         return ErrorCode::program_too_large;
     }
 
-    auto error = load_to_physical_memory(ranges.payload_address, payload_binary);
+    // The checksum is computed on the fly, sparing a separate pass over the image
+    uint32_t payload_crc32;
+    auto error = loadToPayloadArea(ranges.payload_address, payload_binary, &payload_crc32);
 
     if (error.has_value())
     {
         return error;
     }
 
+    MemoryRange const segments[] { { (uintptr_t) ranges.payload_address, payload_binary.size() } };
+
     return startPayloadAt(ranges.payload_address,
                           payload_binary.size(),
                           payload_crc32,
-                          payload_argument);
+                          payload_argument,
+                          segments);
 }
 
 // ************************************************************
@@ -425,30 +1320,14 @@ MaybeError Domain::loadElfPayload(std::span<uint8_t const> payload_binary, uintp
     }
 
     auto& ranges = getPhysicalMemoryRanges();
-    auto devmem = get_devmem_handle();
-
-    if (std::holds_alternative<ErrorCode>(devmem))
-    {
-        return std::get<ErrorCode>(devmem);
-    }
-
-    Mmap code_area(nullptr,
-                   ranges.payload_size,
-                   PROT_READ | PROT_WRITE,
-                   MAP_SHARED,
-                   std::get<int>(devmem),
-                   ranges.payload_address);
-
-    if (!code_area)
-    {
-        return ErrorCode::mmap_failed;
-    }
+    auto& code_area = m_payload_area;
 
     struct MyElfCtx : el_ctx
     {
         std::span<uint8_t const> payload_binary;
         PhysicalMemoryRanges const& ranges;
         Mmap& code_area;
+        std::vector<MemoryRange> segments;      // ranges actually written by the loader
     };
 
 //    el_ctx ctx;
@@ -468,7 +1347,7 @@ MaybeError Domain::loadElfPayload(std::span<uint8_t const> payload_binary, uintp
             printf("pread: %08lX bytes @ %08lX in file (%p VM)\n", nb, offset, dest);
         }
 
-        if (offset + nb < ctx.payload_binary.size())
+        if (offset <= ctx.payload_binary.size() && nb <= ctx.payload_binary.size() - offset)
         {
             memcpy(dest, &ctx.payload_binary[offset], nb);
             return true;
@@ -502,6 +1381,8 @@ MaybeError Domain::loadElfPayload(std::span<uint8_t const> payload_binary, uintp
             return nullptr;
         }
 
+        ctx.segments.push_back(MemoryRange { .address = phys, .size = size });
+
         return (uint8_t *) ctx.code_area.data() + phys - ctx.ranges.payload_address;
     });
 
@@ -510,16 +1391,48 @@ MaybeError Domain::loadElfPayload(std::span<uint8_t const> payload_binary, uintp
         return ErrorCode::program_too_large;
     }
 
-    __clear_cache(code_area.data(), (uint8_t*) code_area.data() + code_area.size());
+    // Only the loaded segments need to be flushed, not the entire payload area
+    for (auto const& segment : ctx.segments)
+    {
+        auto start = (uint8_t*) code_area.data() + (segment.address - ranges.payload_address);
+        __clear_cache(start, start + segment.size);
+    }
+
+    return startPayloadAt(ctx.ehdr.e_entry + ctx.base_load_paddr, 0, 0, payload_argument, ctx.segments);
+}
+
+// ************************************************************
+
+MaybeError Domain::loadPayloadFromFile(std::filesystem::path const& path, uintptr_t payload_argument)
+{
+    // The image is copied straight from the page cache into the payload area
+    auto maybe_file = mapFileReadOnly(path);
+
+    if (std::holds_alternative<ErrorCode>(maybe_file))
+    {
+        return std::get<ErrorCode>(maybe_file);
+    }
+
+    auto& file = std::get<Mmap>(maybe_file);
+
+    std::span<uint8_t const> image((uint8_t const*) file.data(), file.size());
 
-    code_area.unmap();
+    if (path.extension() == ".elf")
+    {
+        return loadElfPayload(image, payload_argument);
+    }
+    else
+    {
+        // Raw binaries are consumed front to back in a single pass
+        madvise(file.data(), file.size(), MADV_SEQUENTIAL);
 
-    return startPayloadAt(ctx.ehdr.e_entry + ctx.base_load_paddr, 0, 0, payload_argument);
+        return loadAndStartPayload(image, payload_argument);
+    }
 }
 
 // ************************************************************
 
-DomainInstanceOrErrorCode IDomain::open(DomainIndex domain)
+DomainInstanceOrErrorCode IDomain::open(DomainIndex domain, MappingOptions const& options)
 {
     auto devmem = get_devmem_handle();
     if (std::holds_alternative<ErrorCode>(devmem))
@@ -529,24 +1442,18 @@ DomainInstanceOrErrorCode IDomain::open(DomainIndex domain)
 
     auto& ranges = getPhysicalMemoryRanges(domain);
 
-    auto ipc_block = (IpcBlock*) mmap(nullptr,
-                                      ranges.monitor_ipc_size,
-                                      PROT_READ | PROT_WRITE,
-                                      MAP_SHARED,
-                                      std::get<int>(devmem),
-                                      ranges.monitor_ipc_address);
-    if (ipc_block == MAP_FAILED)
-    {
-        return ErrorCode::mmap_failed;
-    }
-
-    auto code_area = (uint8_t*) mmap(nullptr,
-                                     ranges.monitor_size,
-                                     PROT_READ | PROT_WRITE,
-                                     MAP_SHARED,
-                                     std::get<int>(devmem),
-                                     ranges.monitor_address);
-    if (code_area == MAP_FAILED)
+    auto ipc_area = mapPhysicalMemory(std::get<int>(devmem), ranges.monitor_ipc_address, ranges.monitor_ipc_size, options);
+    auto monitor_area = mapPhysicalMemory(std::get<int>(devmem), ranges.monitor_address, ranges.monitor_size, options);
+    auto payload_area = mapPhysicalMemory(std::get<int>(devmem), ranges.payload_address, ranges.payload_size, options);
+    auto stdout_area = mapPhysicalMemory(std::get<int>(devmem), ranges.stdout_address, ranges.stdout_size, options);
+    auto telemetry_area = mapPhysicalMemory(std::get<int>(devmem), ranges.telemetry_address, ranges.telemetry_size, options);
+    auto log_area = mapPhysicalMemory(std::get<int>(devmem), ranges.log_address, ranges.log_size, options);
+    auto profile_area = mapPhysicalMemory(std::get<int>(devmem), ranges.profile_address, ranges.profile_size, options);
+    auto irq_stats_area = mapPhysicalMemory(std::get<int>(devmem), ranges.irq_stats_address, ranges.irq_stats_size, options);
+    auto scheduler_area = mapPhysicalMemory(std::get<int>(devmem), ranges.scheduler_address, ranges.scheduler_size, options);
+
+    if (!ipc_area || !monitor_area || !payload_area || !stdout_area || !telemetry_area || !log_area || !profile_area ||
+        !irq_stats_area || !scheduler_area)
     {
         return ErrorCode::mmap_failed;
     }
@@ -566,7 +1473,7 @@ DomainInstanceOrErrorCode IDomain::open(DomainIndex domain)
     {
         // Look for cookie in the specified location
         Cookie cookie = -1;
-        memcpy(&cookie, code_area + ranges.monitor_size - sizeof(cookie), sizeof(cookie));
+        memcpy(&cookie, (uint8_t*) monitor_area.data() + ranges.monitor_size - sizeof(cookie), sizeof(cookie));
 
         if (cookie == MONITOR_CODE_COOKIE)
         {
@@ -584,9 +1491,25 @@ DomainInstanceOrErrorCode IDomain::open(DomainIndex domain)
         }
     }
 
-    munmap(code_area, ranges.monitor_size);
+    return std::make_unique<Domain>(domain,
+                                    std::move(ipc_area),
+                                    std::move(monitor_area),
+                                    std::move(payload_area),
+                                    std::move(stdout_area),
+                                    std::move(telemetry_area),
+                                    std::move(log_area),
+                                    std::move(profile_area),
+                                    std::move(irq_stats_area),
+                                    std::move(scheduler_area));
+}
+
+// ************************************************************
+
+void Domain::setWaitPolicy(WaitPolicy policy)
+{
+    m_wait_policy = std::move(policy);
 
-    return std::make_unique<Domain>(domain, *ipc_block);
+    getOutbox().notify_ipi_mask = m_wait_policy.notification_ipi_mask;
 }
 
 // ************************************************************
@@ -594,7 +1517,8 @@ DomainInstanceOrErrorCode IDomain::open(DomainIndex domain)
 MaybeError Domain::startPayloadAt(uintptr_t entry_address,
                                   size_t payload_size,
                                   uint32_t payload_crc32,
-                                  uintptr_t payload_argument)
+                                  uintptr_t payload_argument,
+                                  std::span<MemoryRange const> segments)
 {
     // First, ensure we are in 'ready' state
     if (getState() != DomainState::monitor_ready)
@@ -611,56 +1535,91 @@ MaybeError Domain::startPayloadAt(uintptr_t entry_address,
     }
 
     // flush any residual content of the stdout buffer by setting our read position equal to the write position
-    outbox.stdout_rdpos = inbox.stdout_wrpos;
+    auto& stdout_header = getStdoutRingHeader();
+    stdout_header.rdpos = stdout_header.wrpos;
+
+    // start the telemetry stream from scratch; the payload is not running yet, so we may touch its side too
+    auto& telemetry = getTelemetryRing();
+    telemetry.wrpos = 0;
+    telemetry.dropped = 0;
+    telemetry.rdpos = 0;
+
+    // likewise for the log, but keep the log level
+    auto& log = getLogRing();
+    log.wrpos = 0;
+    log.dropped = 0;
+    log.rdpos = 0;
+
+    // the statistics are collected (or not) by the new payload; until it says so, there are none
+    memset(m_irq_stats_area.data(), 0, sizeof(IrqStatsBlock));
+    memset(m_scheduler_area.data(), 0, sizeof(SchedulerBlock));
+
+    // incremental snapshots of the new payload have nothing to build upon
+    m_snapshot_page_crcs.clear();
 
     outbox.payload_entry_address = entry_address;
     outbox.payload_size = payload_size;
     outbox.payload_crc = payload_crc32;
     outbox.payload_argument = payload_argument;
+
+    // If there are more segments than fit, report none; the monitor will then fall back to a full cache flush
+    outbox.num_payload_segments = (segments.size() <= MAX_PAYLOAD_SEGMENTS) ? segments.size() : 0;
+
+    for (size_t i = 0; i < outbox.num_payload_segments; i++)
+    {
+        outbox.payload_segments[i].address = segments[i].address;
+        outbox.payload_segments[i].size = segments[i].size;
+    }
+
     outbox.cmd = Command::start_payload;
     memory_write_reorder_barrier();
     outbox.cmd_seq = (outbox.cmd_seq + 1);
 
-    // wait up to 1sec for domain to come to life
-    constexpr int timeout_msec = 1000;
-    constexpr int poll_period_msec = 10;
+    // wait for the monitor to validate the payload...
+    auto deadline = steady_clock::now() + m_wait_policy.payload_start_timeout;
+    auto response = awaitCommandAck(m_wait_policy.payload_start_timeout);
 
-    for (int i = 0; i < timeout_msec / poll_period_msec; i++)
+    if (!response.has_value())
     {
-        usleep(poll_period_msec * 1000);
+        return ErrorCode::payload_start_timed_out;
+    }
 
-        if (inbox.cmd_ack == outbox.cmd_seq)
-        {
-            switch (inbox.cmd_resp)
-            {
-                case Response::crc_ok:
-                    // Good, but we are waiting for DomainState::running_payload
-                    break;
+    switch (*response)
+    {
+        case Response::crc_ok:
+            // Good, but we are waiting for DomainState::running_payload
+            break;
 
-                case Response::crc_mismatched:
-                    return ErrorCode::payload_checksum_mismatch;
+        case Response::crc_mismatched:
+            return ErrorCode::payload_checksum_mismatch;
 
-                case Response::image_malformed:
-                    return ErrorCode::payload_image_malformed;
+        case Response::image_malformed:
+            return ErrorCode::payload_image_malformed;
 
-                case Response::abi_incompatible:
-                    return ErrorCode::payload_abi_incompatible;
+        case Response::abi_incompatible:
+            return ErrorCode::payload_abi_incompatible;
 
-                default:
-                    return ErrorCode::unknown_error;
-            }
-        }
+        default:
+            return ErrorCode::unknown_error;
+    }
 
-        auto state = getState();
+    // ...and then for the payload to come to life
+    auto state = DomainState::invalid_state;
+    auto remaining = std::chrono::ceil<microseconds>(deadline - steady_clock::now());
 
-        if (state == DomainState::running_payload)
-        {
-            return {};
-        }
-        else if (state == DomainState::crashed_payload)
-        {
-            return ErrorCode::payload_crashed_during_startup;
-        }
+    waitUntil(remaining, [&]
+    {
+        state = getState();
+        return state == DomainState::running_payload || state == DomainState::crashed_payload;
+    });
+
+    if (state == DomainState::running_payload)
+    {
+        return {};
+    }
+    else if (state == DomainState::crashed_payload)
+    {
+        return ErrorCode::payload_crashed_during_startup;
     }
 
     // TODO: might want to latch DomainState::crashedPayload when this happens?
@@ -670,19 +1629,39 @@ MaybeError Domain::startPayloadAt(uintptr_t entry_address,
 // ************************************************************
 
 MaybeError Domain::startup()
+{
+    auto error = beginStartup(getMonitorBinary());
+
+    if (error.has_value())
+    {
+        return error;
+    }
+
+    return awaitMonitorStartup();
+}
+
+// ************************************************************
+
+std::span<uint8_t const> Domain::getMonitorBinary() const
 {
     switch (m_domain) {
-        case DomainIndex::cpu1: return startup(monitor_zynqmp_cpu1_payload);
-        case DomainIndex::cpu2: return startup(monitor_zynqmp_cpu2_payload);
-        case DomainIndex::cpu3: return startup(monitor_zynqmp_cpu3_payload);
-        default: return ErrorCode::hw_resource_unavailable;
+        case DomainIndex::cpu1: return monitor_zynqmp_cpu1_payload;
+        case DomainIndex::cpu2: return monitor_zynqmp_cpu2_payload;
+        case DomainIndex::cpu3: return monitor_zynqmp_cpu3_payload;
+        default: return {};
     }
 }
 
 // ************************************************************
 
-MaybeError Domain::startup(std::span<uint8_t const> monitor_binary)
+// Copy the monitor and release the core, without waiting for the monitor to come up
+MaybeError Domain::beginStartup(std::span<uint8_t const> monitor_binary)
 {
+    if (monitor_binary.empty())
+    {
+        return ErrorCode::hw_resource_unavailable;
+    }
+
     ManagerConfiguration config {};
     if (!loadConfigurationFromDefaultFile(config))
     {
@@ -701,17 +1680,7 @@ MaybeError Domain::startup(std::span<uint8_t const> monitor_binary)
     }
 
     auto& ranges = getPhysicalMemoryRanges();
-
-    auto code_area = (uint8_t*) mmap(nullptr,
-                                     ranges.monitor_size,
-                                     PROT_READ | PROT_WRITE,
-                                     MAP_SHARED,
-                                     std::get<int>(devmem),
-                                     ranges.monitor_address);
-    if (code_area == MAP_FAILED)
-    {
-        return ErrorCode::mmap_failed;
-    }
+    auto code_area = (uint8_t*) m_monitor_area.data();
 
     const auto cookie = MONITOR_CODE_COOKIE;
 
@@ -726,8 +1695,6 @@ MaybeError Domain::startup(std::span<uint8_t const> monitor_binary)
     // flush the newly written code from L1 through to DDR (since CPUn will come up in uncached mode)
     __clear_cache(code_area, code_area + ranges.monitor_size);
 
-    munmap(code_area, ranges.monitor_size);
-
     // initialize IPC block
     memset((void*) &m_ipc_block, 0, ranges.monitor_ipc_size);
     m_ipc_block.executor_to_manager.state = DomainState::invalid_state;
@@ -735,8 +1702,27 @@ MaybeError Domain::startup(std::span<uint8_t const> monitor_binary)
     // patch in the frequency of the Generic Timer (see doc/arch-counter.rst)
     m_ipc_block.manager_to_executor.cntfrq = config.cntfrq;
 
+    // ask for notifications (if desired)
+    m_ipc_block.manager_to_executor.notify_ipi_mask = m_wait_policy.notification_ipi_mask;
+
+    // initialize the standard output ring (this also resets the overflow policy)
+    auto stdout_header = (uint8_t*) m_stdout_area.data();
+    memset(stdout_header, 0, sizeof(StdoutRingHeader));
+
+    // initialize the log ring, including the default log level
+    auto log_header = (uint8_t*) m_log_area.data();
+    memset(log_header, 0, sizeof(LogRingHeader));
+    ((LogRingHeader*) log_header)->level = LogLevel::info;
+
+    // initialize the profile ring, with the profiler off
+    auto profile_header = (uint8_t*) m_profile_area.data();
+    memset(profile_header, 0, sizeof(ProfileRingHeader));
+
     // flush the IPC region to DDR (since the SCU is not in effect yet and CPUn will come up with cold caches)
     __clear_cache(&m_ipc_block, (uint8_t*) &m_ipc_block + ranges.monitor_ipc_size);
+    __clear_cache(stdout_header, stdout_header + sizeof(StdoutRingHeader));
+    __clear_cache(log_header, log_header + sizeof(LogRingHeader));
+    __clear_cache(profile_header, profile_header + sizeof(ProfileRingHeader));
 
     // Set the reset vector registers and give it the the monitor address
     auto maybe_error = zynqmp::bootCore(std::get<int>(devmem), m_domain, ranges.monitor_address);
@@ -748,7 +1734,7 @@ MaybeError Domain::startup(std::span<uint8_t const> monitor_binary)
     // TODO: maybe we should only do this after state goes to ready
     domain_general_state[m_domain] = DomainGeneralState::monitorStarted;
 
-    return awaitMonitorStartup();
+    return {};
 }
 
 // ************************************************************
@@ -760,19 +1746,238 @@ MaybeError Domain::terminatePayload()
         return ErrorCode::bad_domain_state;
     }
 
+    // Clear any pending command (although none should have been sent in the current state)
+    getOutbox().cmd = Command::noop;
+
+    if (auto err = sendIpiRequest(IPI_REQ_KILL); err.has_value())
+    {
+        return err;
+    }
+
+    return awaitMonitorStartup();
+}
+
+// ************************************************************
+
+MaybeError Domain::sendIpiRequest(uint32_t request)
+{
     auto devmem = get_devmem_handle();
     if (std::holds_alternative<ErrorCode>(devmem))
     {
         return std::get<ErrorCode>(devmem);
     }
 
-    // Clear any pending command (although none should have been sent in the current state)
-    getOutbox().cmd = Command::noop;
+    // The IPI itself carries no information (the message buffer is not used); the monitor looks up the request here
+    getOutbox().ipi_request = request;
+    memory_write_reorder_barrier();
 
-    // TODO: Clean up a bit; these values have no meaning, but if/when we have multiple different IPIs, we will use
-    //       this buffer to signal which one is being invoked.
     uint8_t message[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
-    zynqmp::sendIpiMessage(std::get<int>(devmem), m_domain, message);
+    return zynqmp::sendIpiMessage(std::get<int>(devmem), m_domain, message);
+}
 
-    return awaitMonitorStartup();
+// ************************************************************
+
+MaybeError Domain::waitForState(DomainState state, microseconds timeout)
+{
+    if (!waitUntil(timeout, [&] { return getState() == state; }))
+    {
+        return ErrorCode::state_wait_timed_out;
+    }
+
+    return {};
+}
+
+// ************************************************************
+
+template <typename Predicate>
+bool Domain::waitUntil(microseconds timeout, Predicate&& condition)
+{
+    // The executor typically responds within microseconds, so start by spinning on the shared memory.
+    // Only then fall back to sleeping, with an exponentially growing interval.
+    auto start = steady_clock::now();
+    auto deadline = start + timeout;
+    auto backoff = m_wait_policy.initial_backoff;
+
+    for (;;)
+    {
+        if (condition())
+        {
+            return true;
+        }
+
+        auto now = steady_clock::now();
+
+        if (now >= deadline)
+        {
+            return false;
+        }
+
+        if (now - start < m_wait_policy.spin_duration)
+        {
+            continue;
+        }
+
+        auto interval = std::min<microseconds>(backoff, std::chrono::ceil<microseconds>(deadline - now));
+
+        if (m_wait_policy.await_notification)
+        {
+            m_wait_policy.await_notification(interval);
+        }
+        else
+        {
+            std::this_thread::sleep_for(interval);
+        }
+
+        backoff = std::min(backoff * 2, m_wait_policy.max_backoff);
+    }
+}
+
+// ************************************************************
+
+// Apply an operation to each member of the group, each in its own thread, and collect the results
+template <typename Operation>
+static std::vector<MaybeError> forEachInParallel(std::vector<std::unique_ptr<IDomain>>& domains, Operation&& operation)
+{
+    std::vector<MaybeError> results(domains.size());
+    std::vector<std::thread> threads;
+    threads.reserve(domains.size());
+
+    for (size_t i = 0; i < domains.size(); i++)
+    {
+        // All group members are created by IDomain::open, so this cast is safe
+        threads.emplace_back([&, i] { results[i] = operation(i, static_cast<Domain&>(*domains[i])); });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    return results;
+}
+
+// ************************************************************
+
+DomainGroupOrErrorCode DomainGroup::open(std::span<DomainIndex const> domains, MappingOptions const& options)
+{
+    std::vector<std::unique_ptr<IDomain>> members;
+
+    for (auto index : domains)
+    {
+        for (auto const& member : members)
+        {
+            if (member->getIndex() == index)
+            {
+                return ErrorCode::hw_resource_unavailable;
+            }
+        }
+
+        auto maybe_domain = IDomain::open(index, options);
+
+        if (std::holds_alternative<ErrorCode>(maybe_domain))
+        {
+            return std::get<ErrorCode>(maybe_domain);
+        }
+
+        members.push_back(std::move(std::get<std::unique_ptr<IDomain>>(maybe_domain)));
+    }
+
+    return DomainGroup(std::move(members));
+}
+
+// ************************************************************
+
+DomainGroupOrErrorCode DomainGroup::openAll(MappingOptions const& options)
+{
+    static constexpr DomainIndex all_domains[] { DomainIndex::cpu1, DomainIndex::cpu2, DomainIndex::cpu3 };
+    static_assert(std::size(all_domains) == DomainIndex::max_domain);
+
+    return open(all_domains, options);
+}
+
+// ************************************************************
+
+std::vector<MaybeError> DomainGroup::startup()
+{
+    // Copying the monitors and releasing the cores takes next to no time; it is the monitor initialization that takes
+    // long. So do the former for all domains first, and only then wait for all of them together.
+    std::vector<MaybeError> begin_results;
+
+    for (auto& member : m_domains)
+    {
+        auto& domain = static_cast<Domain&>(*member);
+        begin_results.push_back(domain.beginStartup(domain.getMonitorBinary()));
+    }
+
+    return forEachInParallel(m_domains, [&](size_t i, Domain& domain) -> MaybeError
+    {
+        if (begin_results[i].has_value())
+        {
+            return begin_results[i];
+        }
+
+        return domain.awaitMonitorStartup();
+    });
+}
+
+// ************************************************************
+
+std::vector<MaybeError> DomainGroup::ensureReadyToLoadPayload()
+{
+    // Same as in startup(): first release all the cores that need it
+    std::vector<std::optional<MaybeError>> begin_results(m_domains.size());
+
+    for (size_t i = 0; i < m_domains.size(); i++)
+    {
+        auto& domain = static_cast<Domain&>(*m_domains[i]);
+
+        if (domain.getState() == DomainState::in_reset)
+        {
+            begin_results[i] = domain.beginStartup(domain.getMonitorBinary());
+        }
+    }
+
+    return forEachInParallel(m_domains, [&](size_t i, Domain& domain) -> MaybeError
+    {
+        if (!begin_results[i].has_value())
+        {
+            return domain.ensureReadyToLoadPayload();
+        }
+        else if (begin_results[i]->has_value())
+        {
+            return *begin_results[i];
+        }
+
+        return domain.awaitMonitorStartup();
+    });
+}
+
+// ************************************************************
+
+std::vector<MaybeError> DomainGroup::loadPayloadsFromFiles(std::span<std::filesystem::path const> paths,
+                                                           uintptr_t payload_argument)
+{
+    return forEachInParallel(m_domains, [&](size_t i, Domain& domain) -> MaybeError
+    {
+        if (i >= paths.size())
+        {
+            return ErrorCode::file_access_failed;
+        }
+
+        return domain.loadPayloadFromFile(paths[i], payload_argument);
+    });
+}
+
+std::vector<MaybeError> DomainGroup::loadPayloadsFromFiles(std::span<std::filesystem::path const> paths,
+                                                           std::span<uintptr_t const> payload_arguments)
+{
+    return forEachInParallel(m_domains, [&](size_t i, Domain& domain) -> MaybeError
+    {
+        if (i >= paths.size())
+        {
+            return ErrorCode::file_access_failed;
+        }
+
+        return domain.loadPayloadFromFile(paths[i], (i < payload_arguments.size()) ? payload_arguments[i] : 0);
+    });
 }
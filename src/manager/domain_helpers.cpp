@@ -1,132 +1,114 @@
 #include <bmboot/domain_helpers.hpp>
-
-#include "../utility/crc32.hpp"
+#include <bmboot/console.hpp>
 
 #include <csignal>
-#include <fstream>
-#include <sstream>
+#include <cstdio>
 #include <thread>
-#include <vector>
 
 using namespace bmboot;
-using namespace std::chrono_literals;
-using std::chrono::milliseconds;
-
-static std::atomic_bool console_interrupted[DomainIndex::max_domain];
 
-static std::thread console_threads[DomainIndex::max_domain];
+// The console being run by runConsoleUntilInterrupted, for the benefit of the signal handler
+static std::atomic<Console*> interruptible_console;
 
 /*
  * Console works like this:
  *
- * - it always runs on a thread
- * - in stand-alone mode we just instantiate it for 1 domain (so it's the user's responisbility that it has been initialized etc.)
- * - when embedded as library, you spawn a thread per each domain spun up, and then it's up to you to tear 'em down
+ * - a single Console instance services any number of domains from one thread
+ * - in stand-alone mode we run it in the calling thread until SIGINT (so it's the user's responsibility that the
+ *   domains have been initialized etc.)
+ * - when embedded as library, startConsoleThread adds domains to a console running in the background for the rest of
+ *   the process lifetime
  */
 
-static void runConsole(IDomain& domain)
+// Open a decoder for the log of a payload, if possible; the console makes do without one otherwise
+static std::shared_ptr<LogDecoder const> openLogDecoder(std::filesystem::path const& payload_path)
 {
-    static const int MAX_LINE_LENGTH = 160;
-
-    auto domain_name = toString(domain.getIndex());
-
-    auto start = std::chrono::system_clock::now();
-
-    std::stringstream stdout_accum;
-
-    auto flush = [&]()
+    if (payload_path.extension() != ".elf")
     {
-        auto now = std::chrono::system_clock::now();
-        printf("[%s %7.3f] %s\n",
-               domain_name.c_str(),
-               duration_cast<std::chrono::duration<float>>((now - start)).count(),
-               stdout_accum.str().c_str());
-        std::stringstream().swap(stdout_accum);         // https://stackoverflow.com/a/23266418
-    };
-
-    while (!console_interrupted[domain.getIndex()])
-    {
-        int c = domain.getchar();
-
-        if (c >= 0)
-        {
-            if (c == '\n')
-            {
-                flush();
-            }
-            else
-            {
-                stdout_accum << (char)c;
-
-                if (stdout_accum.tellp() >= MAX_LINE_LENGTH)
-                {
-                    flush();
-                }
-            }
-        }
-        else
-        {
-            std::this_thread::sleep_for(1ms);
-        }
+        return nullptr;
     }
 
-    if (stdout_accum.tellp() > 0)
+    auto maybe_decoder = LogDecoder::open(payload_path);
+
+    if (!std::holds_alternative<LogDecoder>(maybe_decoder))
     {
-        flush();
+        fprintf(stderr, "warning: cannot decode log messages using %s: %s\n",
+                payload_path.c_str(), toString(std::get<ErrorCode>(maybe_decoder)).c_str());
+        return nullptr;
     }
+
+    return std::make_shared<LogDecoder const>(std::move(std::get<LogDecoder>(maybe_decoder)));
 }
 
-void bmboot::runConsoleUntilInterrupted(IDomain& domain)
+static void runUntilInterrupted(Console& console)
 {
-    console_interrupted[domain.getIndex()] = false;
+    interruptible_console = &console;
 
     struct sigaction sa;
     sa.sa_handler = [](int signal)
     {
-        for (auto& stop : console_interrupted)
+        if (auto console = interruptible_console.load())
         {
-            stop = true;
+            console->stop();
         }
     };
     sigemptyset(&sa.sa_mask);
     sa.sa_flags = 0;
     sigaction(SIGINT, &sa, nullptr);
 
-    startConsoleThread(domain);
-    console_threads[domain.getIndex()].join();
+    console.run();
+
+    interruptible_console = nullptr;
 }
 
-void bmboot::loadPayloadFromFileOrThrow(IDomain& domain, std::filesystem::path const& path)
+void bmboot::runConsoleUntilInterrupted(IDomain& domain, std::filesystem::path const& payload_path)
 {
-    std::ifstream file(path, std::ios::binary);
+    Console console;
+    console.addDomain(domain, openLogDecoder(payload_path));
 
-    if (!file)
-    {
-        throw std::runtime_error("failed to open " + path.string());
-    }
+    runUntilInterrupted(console);
+}
 
-    std::vector<uint8_t> program((std::istreambuf_iterator<char>(file)),
-                                 std::istreambuf_iterator<char>());
+void bmboot::runConsoleUntilInterrupted(DomainGroup& group, std::span<std::filesystem::path const> payload_paths)
+{
+    Console console;
 
-    if (path.extension() == ".elf")
-    {
-        throwOnError(domain.loadElfPayload(program, 1234), "loadElfPayload");
-    }
-    else
+    for (size_t i = 0; i < group.size(); i++)
     {
-        auto crc = crc32(0, program.data(), program.size());
-        throwOnError(domain.loadAndStartPayload(program, crc, 123), "loadAndStartPayload");
+        console.addDomain(group[i], (i < payload_paths.size()) ? openLogDecoder(payload_paths[i]) : nullptr);
     }
+
+    runUntilInterrupted(console);
 }
 
-void bmboot::startConsoleThread(IDomain& domain)
+uintptr_t bmboot::getDefaultPayloadArgument(std::filesystem::path const& path)
 {
-    auto& thread = console_threads[domain.getIndex()];
+    return (path.extension() == ".elf") ? 1234 : 123;
+}
 
-    if (!thread.joinable())
+void bmboot::loadPayloadFromFileOrThrow(IDomain& domain, std::filesystem::path const& path)
+{
+    auto err = domain.loadPayloadFromFile(path, getDefaultPayloadArgument(path));
+
+    if (err == ErrorCode::file_access_failed)
     {
-        thread = std::thread(runConsole, std::ref(domain));
+        throw std::runtime_error("failed to open " + path.string());
     }
+
+    throwOnError(err, "loadPayloadFromFile");
+}
+
+void bmboot::startConsoleThread(IDomain& domain, std::filesystem::path const& payload_path)
+{
+    // Deliberately never destroyed, since the thread keeps running until the process exits
+    static auto background_console = []
+    {
+        auto console = new Console();
+        std::thread([console] { console->run(); }).detach();
+        return console;
+    }();
+
+    background_console->addDomain(domain, openLogDecoder(payload_path));
 }
 
 std::unique_ptr<IDomain> bmboot::throwOnError(DomainInstanceOrErrorCode maybe_domain, const char* function_name)
@@ -139,6 +121,16 @@ std::unique_ptr<IDomain> bmboot::throwOnError(DomainInstanceOrErrorCode maybe_do
     return std::move(std::get<std::unique_ptr<IDomain>>(maybe_domain));
 }
 
+DomainGroup bmboot::throwOnError(DomainGroupOrErrorCode maybe_group, const char* function_name)
+{
+    if (!std::holds_alternative<DomainGroup>(maybe_group))
+    {
+        throw std::runtime_error((std::string) function_name + ": error: " + toString(std::get<ErrorCode>(maybe_group)));
+    }
+
+    return std::move(std::get<DomainGroup>(maybe_group));
+}
+
 void bmboot::throwOnError(MaybeError err, const char* function_name)
 {
     if (err.has_value())
@@ -0,0 +1,112 @@
+//! @file
+//! @brief  Read-only access to payload files
+//! @author Martin Cejp
+
+#include "elf_file.hpp"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+// ************************************************************
+
+MmapOrErrorCode internal::mapFileReadOnly(std::filesystem::path const& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return ErrorCode::file_access_failed;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return ErrorCode::file_access_failed;
+    }
+
+    if (st.st_size == 0)
+    {
+        ::close(fd);
+        return ErrorCode::payload_image_malformed;
+    }
+
+    Mmap file(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (!file)
+    {
+        return ErrorCode::mmap_failed;
+    }
+
+    return file;
+}
+
+// ************************************************************
+
+std::optional<ElfImage> ElfImage::parse(std::span<uint8_t const> contents)
+{
+    Elf64_Ehdr ehdr;
+
+    if (contents.size() < sizeof(ehdr))
+    {
+        return {};
+    }
+
+    memcpy(&ehdr, contents.data(), sizeof(ehdr));
+
+    if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+        (ehdr.e_phnum > 0 && ehdr.e_phentsize != sizeof(Elf64_Phdr)) ||
+        ehdr.e_phoff > contents.size() ||
+        ehdr.e_phnum > (contents.size() - ehdr.e_phoff) / sizeof(Elf64_Phdr) ||
+        (ehdr.e_shnum > 0 && ehdr.e_shentsize != sizeof(Elf64_Shdr)) ||
+        ehdr.e_shoff > contents.size() ||
+        ehdr.e_shnum > (contents.size() - ehdr.e_shoff) / sizeof(Elf64_Shdr))
+    {
+        return {};
+    }
+
+    return ElfImage(contents, ehdr);
+}
+
+Elf64_Phdr ElfImage::getSegment(size_t index) const
+{
+    Elf64_Phdr phdr;
+    memcpy(&phdr, m_contents.data() + m_header.e_phoff + index * sizeof(phdr), sizeof(phdr));
+    return phdr;
+}
+
+Elf64_Shdr ElfImage::getSection(size_t index) const
+{
+    Elf64_Shdr shdr;
+    memcpy(&shdr, m_contents.data() + m_header.e_shoff + index * sizeof(shdr), sizeof(shdr));
+    return shdr;
+}
+
+std::optional<std::span<uint8_t const>> ElfImage::getRange(uint64_t offset, uint64_t size) const
+{
+    if (offset > m_contents.size() || size > m_contents.size() - offset)
+    {
+        return {};
+    }
+
+    return m_contents.subspan(offset, size);
+}
+
+std::optional<std::span<uint8_t const>> ElfImage::getSectionContents(Elf64_Shdr const& section) const
+{
+    if (section.sh_type == SHT_NOBITS)
+    {
+        return std::span<uint8_t const>();
+    }
+
+    return getRange(section.sh_offset, section.sh_size);
+}
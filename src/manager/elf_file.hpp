@@ -0,0 +1,56 @@
+//! @file
+//! @brief  Read-only access to payload files
+//! @author Martin Cejp
+
+#pragma once
+
+#include "bmboot.hpp"
+#include "../utility/mmap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <variant>
+
+#include <elf.h>
+
+namespace bmboot::internal
+{
+
+using MmapOrErrorCode = std::variant<Mmap, ErrorCode>;
+
+// Map an entire file read-only. The contents are read from the page cache on demand instead of being buffered on the
+// heap, and the mapping outlives the file descriptor.
+// Returns file_access_failed if the file cannot be opened or is not a regular file, payload_image_malformed if it is
+// empty and mmap_failed if it cannot be mapped.
+MmapOrErrorCode mapFileReadOnly(std::filesystem::path const& path);
+
+// A 64-bit ELF file in memory. The header tables are validated up-front; everything else is bounds-checked on access.
+class ElfImage
+{
+public:
+    // Returns nothing if the contents are not a well-formed 64-bit ELF file
+    static std::optional<ElfImage> parse(std::span<uint8_t const> contents);
+
+    size_t getNumSegments() const { return m_header.e_phnum; }
+    Elf64_Phdr getSegment(size_t index) const;
+
+    size_t getNumSections() const { return m_header.e_shnum; }
+    Elf64_Shdr getSection(size_t index) const;
+
+    // Get a range of the file; nothing if it extends past the end
+    std::optional<std::span<uint8_t const>> getRange(uint64_t offset, uint64_t size) const;
+
+    // Get the contents of a section (empty for SHT_NOBITS); nothing if it extends past the end of the file
+    std::optional<std::span<uint8_t const>> getSectionContents(Elf64_Shdr const& section) const;
+
+private:
+    ElfImage(std::span<uint8_t const> contents, Elf64_Ehdr const& header) : m_contents(contents), m_header(header) {}
+
+    std::span<uint8_t const> m_contents;
+    Elf64_Ehdr m_header;
+};
+
+}
@@ -0,0 +1,275 @@
+//! @file
+//! @brief  Rendering of deferred-formatting log messages
+//! @author Martin Cejp
+
+#include "bmboot/log_decoder.hpp"
+#include "elf_file.hpp"
+#include "../utility/append_formatted.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+// ************************************************************
+
+// The payload widens integer arguments to 64 bits, sign-extending the signed ones. Narrow them back to the size given
+// by the length modifier of the conversion, which is what printf would have seen.
+static uint64_t narrowUnsigned(uint64_t value, int bits)
+{
+    return (bits < 64) ? (value & ((1ull << bits) - 1)) : value;
+}
+
+static int64_t narrowSigned(uint64_t value, int bits)
+{
+    return (bits < 64) ? ((int64_t) (value << (64 - bits)) >> (64 - bits)) : (int64_t) value;
+}
+
+// ************************************************************
+
+LogDecoderOrErrorCode LogDecoder::open(std::filesystem::path const& elf_path)
+{
+    auto maybe_file = mapFileReadOnly(elf_path);
+
+    if (std::holds_alternative<ErrorCode>(maybe_file))
+    {
+        return std::get<ErrorCode>(maybe_file);
+    }
+
+    auto& file = std::get<Mmap>(maybe_file);
+    auto elf = ElfImage::parse({ (uint8_t const*) file.data(), file.size() });
+
+    if (!elf.has_value())
+    {
+        return ErrorCode::payload_image_malformed;
+    }
+
+    // Keep only the contents of the loadable segments; that is where the payload's string literals reside
+    LogDecoder decoder;
+
+    for (size_t i = 0; i < elf->getNumSegments(); i++)
+    {
+        auto phdr = elf->getSegment(i);
+
+        if (phdr.p_type != PT_LOAD || phdr.p_filesz == 0)
+        {
+            continue;
+        }
+
+        auto contents = elf->getRange(phdr.p_offset, phdr.p_filesz);
+
+        if (!contents.has_value())
+        {
+            return ErrorCode::payload_image_malformed;
+        }
+
+        decoder.m_segments.push_back(Segment {
+            .address = phdr.p_vaddr,
+            .size = phdr.p_filesz,
+            .offset = decoder.m_image.size(),
+        });
+
+        decoder.m_image.insert(decoder.m_image.end(), contents->begin(), contents->end());
+    }
+
+    return decoder;
+}
+
+// ************************************************************
+
+std::optional<std::string_view> LogDecoder::lookupString(uint64_t address) const
+{
+    for (auto const& segment : m_segments)
+    {
+        if (address < segment.address || address - segment.address >= segment.size)
+        {
+            continue;
+        }
+
+        auto begin = m_image.data() + segment.offset + (address - segment.address);
+        auto end = m_image.data() + segment.offset + segment.size;
+
+        // Only accept properly terminated strings, so that the result can also be passed where a C string is expected
+        auto terminator = std::find(begin, end, '\0');
+
+        if (terminator == end)
+        {
+            return {};
+        }
+
+        return std::string_view(begin, terminator - begin);
+    }
+
+    return {};
+}
+
+// ************************************************************
+
+std::string LogDecoder::format(LogRecord const& record) const
+{
+    std::string text;
+
+    auto num_args = std::min<size_t>(record.num_args, LogRecord::MAX_ARGS);
+    auto maybe_format = lookupString(record.format);
+
+    if (!maybe_format.has_value())
+    {
+        // Without the format string, the best we can do is to show the raw data
+        appendFormatted(text, "<format 0x%llx>", (unsigned long long) record.format);
+
+        for (size_t i = 0; i < num_args; i++)
+        {
+            appendFormatted(text, " 0x%llx", (unsigned long long) record.args[i]);
+        }
+
+        return text;
+    }
+
+    auto format = *maybe_format;
+    size_t next_arg = 0;
+
+    for (size_t pos = 0; pos < format.size(); )
+    {
+        if (format[pos] != '%')
+        {
+            auto end = std::min(format.find('%', pos), format.size());
+            text.append(format.substr(pos, end - pos));
+            pos = end;
+            continue;
+        }
+
+        auto spec_start = pos++;
+
+        if (pos < format.size() && format[pos] == '%')
+        {
+            text.push_back('%');
+            pos++;
+            continue;
+        }
+
+        // Rebuild the conversion specification with the argument-dependent parts (* and length) resolved
+        std::string conversion = "%";
+
+        while (pos < format.size() && strchr("-+ #0", format[pos]) != nullptr)
+        {
+            conversion.push_back(format[pos++]);
+        }
+
+        while (pos < format.size() && (isdigit((unsigned char) format[pos]) || format[pos] == '.' || format[pos] == '*'))
+        {
+            if (format[pos] == '*')
+            {
+                conversion += std::to_string(next_arg < num_args ? (int) record.args[next_arg++] : 0);
+            }
+            else
+            {
+                conversion.push_back(format[pos]);
+            }
+
+            pos++;
+        }
+
+        // Without a length modifier, an integer argument is an int (AArch64 is LP64: long, size_t etc. are 64-bit)
+        int arg_bits = 32;
+
+        if (format.substr(pos, 2) == "hh")
+        {
+            arg_bits = 8;
+            pos += 2;
+        }
+        else if (pos < format.size() && format[pos] == 'h')
+        {
+            arg_bits = 16;
+            pos++;
+        }
+        else if (format.substr(pos, 2) == "ll")
+        {
+            arg_bits = 64;
+            pos += 2;
+        }
+        else if (pos < format.size() && strchr("lLqjzt", format[pos]) != nullptr)
+        {
+            arg_bits = 64;
+            pos++;
+        }
+
+        if (pos == format.size())
+        {
+            text.append(format.substr(spec_start));
+            break;
+        }
+
+        auto specifier = format[pos++];
+
+        if (next_arg >= num_args)
+        {
+            // The payload passed fewer arguments than the format asks for; should have been caught at compile time
+            text.append(format.substr(spec_start, pos - spec_start));
+            continue;
+        }
+
+        auto arg = record.args[next_arg++];
+
+        switch (specifier)
+        {
+            case 'd':
+            case 'i':
+                appendFormatted(text, conversion + "ll" + specifier, (long long) narrowSigned(arg, arg_bits));
+                break;
+
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                appendFormatted(text, conversion + "ll" + specifier,
+                                (unsigned long long) narrowUnsigned(arg, arg_bits));
+                break;
+
+            case 'c':
+                appendFormatted(text, conversion + specifier, (int) arg);
+                break;
+
+            case 'a':
+            case 'A':
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G': {
+                double value;
+                memcpy(&value, &arg, sizeof(value));
+                appendFormatted(text, conversion + specifier, value);
+                break;
+            }
+
+            case 'p':
+                appendFormatted(text, conversion + specifier, (void*) (uintptr_t) arg);
+                break;
+
+            case 's':
+                if (auto string = lookupString(arg); string.has_value())
+                {
+                    appendFormatted(text, conversion + specifier, string->data());
+                }
+                else
+                {
+                    appendFormatted(text, "<string 0x%llx>", (unsigned long long) arg);
+                }
+                break;
+
+            case 'n':
+                // Nothing to print, and certainly nothing to write back
+                break;
+
+            default:
+                text.append(format.substr(spec_start, pos - spec_start));
+                break;
+        }
+    }
+
+    return text;
+}
@@ -0,0 +1,253 @@
+//! @file
+//! @brief  Symbolization and rendering of profiler samples
+//! @author Martin Cejp
+
+#include "bmboot/profiler.hpp"
+#include "elf_file.hpp"
+#include "../utility/append_formatted.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include <cxxabi.h>
+
+using namespace bmboot;
+using namespace bmboot::internal;
+
+// ************************************************************
+
+static std::string demangle(char const* name)
+{
+    int status;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+
+    if (status != 0 || demangled == nullptr)
+    {
+        return name;
+    }
+
+    std::string result(demangled);
+    free(demangled);
+    return result;
+}
+
+// A return address points after the call; the call itself is what should be attributed (it might even be the last
+// instruction of the function, in which case the return address would resolve to the next function)
+static uint64_t callSiteOf(uint64_t return_address)
+{
+    return return_address - 4;
+}
+
+// ************************************************************
+
+SymbolizerOrErrorCode Symbolizer::open(std::filesystem::path const& elf_path)
+{
+    auto maybe_file = mapFileReadOnly(elf_path);
+
+    if (std::holds_alternative<ErrorCode>(maybe_file))
+    {
+        return std::get<ErrorCode>(maybe_file);
+    }
+
+    auto& file = std::get<Mmap>(maybe_file);
+    auto elf = ElfImage::parse({ (uint8_t const*) file.data(), file.size() });
+
+    if (!elf.has_value())
+    {
+        return ErrorCode::payload_image_malformed;
+    }
+
+    Symbolizer symbolizer;
+
+    for (size_t i = 0; i < elf->getNumSections(); i++)
+    {
+        auto symtab = elf->getSection(i);
+
+        if (symtab.sh_type != SHT_SYMTAB)
+        {
+            continue;
+        }
+
+        if (symtab.sh_link >= elf->getNumSections())
+        {
+            return ErrorCode::payload_image_malformed;
+        }
+
+        auto symbols = elf->getSectionContents(symtab);
+        auto strings = elf->getSectionContents(elf->getSection(symtab.sh_link));
+
+        if (!symbols.has_value() || !strings.has_value())
+        {
+            return ErrorCode::payload_image_malformed;
+        }
+
+        for (size_t offset = 0; offset + sizeof(Elf64_Sym) <= symbols->size(); offset += sizeof(Elf64_Sym))
+        {
+            Elf64_Sym sym;
+            memcpy(&sym, symbols->data() + offset, sizeof(sym));
+
+            if (sym.st_name >= strings->size() || sym.st_shndx == SHN_UNDEF || sym.st_shndx >= elf->getNumSections())
+            {
+                continue;
+            }
+
+            // Besides proper functions, take labels in code, which is all there is for hand-written assembly
+            // (but not the $x/$d mapping symbols)
+            auto type = ELF64_ST_TYPE(sym.st_info);
+            auto name = (char const*) strings->data() + sym.st_name;
+            auto name_length = strnlen(name, strings->size() - sym.st_name);
+
+            if (name_length == 0 || name_length == strings->size() - sym.st_name || name[0] == '$' ||
+                (type != STT_FUNC && (type != STT_NOTYPE || !(elf->getSection(sym.st_shndx).sh_flags & SHF_EXECINSTR))))
+            {
+                continue;
+            }
+
+            symbolizer.m_functions.push_back(Function {
+                .address = sym.st_value,
+                .size = sym.st_size,
+                .name = demangle(name),
+            });
+        }
+    }
+
+    // Where several symbols share an address, prefer one that has a size
+    std::stable_sort(symbolizer.m_functions.begin(), symbolizer.m_functions.end(),
+                     [](Function const& a, Function const& b)
+                     {
+                         return a.address < b.address || (a.address == b.address && a.size > b.size);
+                     });
+
+    symbolizer.m_functions.erase(std::unique(symbolizer.m_functions.begin(), symbolizer.m_functions.end(),
+                                             [](Function const& a, Function const& b) { return a.address == b.address; }),
+                                 symbolizer.m_functions.end());
+
+    return symbolizer;
+}
+
+// ************************************************************
+
+std::optional<Symbolizer::Location> Symbolizer::lookup(uint64_t address) const
+{
+    auto it = std::upper_bound(m_functions.begin(), m_functions.end(), address,
+                               [](uint64_t address, Function const& function) { return address < function.address; });
+
+    if (it == m_functions.begin())
+    {
+        return {};
+    }
+
+    auto const& function = *std::prev(it);
+
+    if (function.size != 0 && address - function.address >= function.size)
+    {
+        return {};
+    }
+
+    return Location { function.name, address - function.address };
+}
+
+// ************************************************************
+
+std::string Symbolizer::describe(uint64_t address) const
+{
+    std::string text;
+
+    if (auto location = lookup(address); location.has_value())
+    {
+        text = location->function;
+        appendFormatted(text, "+0x%llx", (unsigned long long) location->offset);
+    }
+    else
+    {
+        appendFormatted(text, "0x%llx", (unsigned long long) address);
+    }
+
+    return text;
+}
+
+// ************************************************************
+
+std::string bmboot::formatFoldedStacks(std::span<ProfileSample const> samples, Symbolizer const& symbolizer)
+{
+    auto appendFunction = [&](std::string& stack, uint64_t address)
+    {
+        if (auto location = symbolizer.lookup(address); location.has_value())
+        {
+            stack.append(location->function);
+        }
+        else
+        {
+            appendFormatted(stack, "0x%llx", (unsigned long long) address);
+        }
+    };
+
+    std::map<std::string, size_t> counts;
+    std::string stack;
+
+    for (auto const& sample : samples)
+    {
+        stack.clear();
+
+        auto num_frames = std::min<size_t>(sample.num_frames, ProfileSample::MAX_FRAMES);
+
+        for (size_t i = num_frames; i > 0; i--)
+        {
+            appendFunction(stack, callSiteOf(sample.frames[i - 1]));
+            stack.push_back(';');
+        }
+
+        appendFunction(stack, sample.pc);
+        counts[stack]++;
+    }
+
+    std::string text;
+
+    for (auto const& [stack, count] : counts)
+    {
+        text.append(stack);
+        appendFormatted(text, " %zu\n", count);
+    }
+
+    return text;
+}
+
+// ************************************************************
+
+std::string bmboot::formatPerfScript(std::span<ProfileSample const> samples, Symbolizer const& symbolizer,
+                                     uint32_t timer_frequency, std::string_view command, int cpu)
+{
+    std::string text;
+
+    auto appendFrame = [&](uint64_t address)
+    {
+        appendFormatted(text, "\t%16llx ", (unsigned long long) address);
+        text.append(symbolizer.describe(address));
+        text.append(" ([payload])\n");
+    };
+
+    for (auto const& sample : samples)
+    {
+        auto seconds = timer_frequency ? sample.timestamp / timer_frequency : 0;
+        auto micros = timer_frequency ? (sample.timestamp % timer_frequency) * 1'000'000 / timer_frequency : 0;
+
+        text.append(command);
+        appendFormatted(text, " 0 [%03d] %llu.%06llu: 1 cpu-clock:\n",
+                        cpu, (unsigned long long) seconds, (unsigned long long) micros);
+
+        appendFrame(sample.pc);
+
+        auto num_frames = std::min<size_t>(sample.num_frames, ProfileSample::MAX_FRAMES);
+
+        for (size_t i = 0; i < num_frames; i++)
+        {
+            appendFrame(callSiteOf(sample.frames[i]));
+        }
+
+        text.push_back('\n');
+    }
+
+    return text;
+}
@@ -0,0 +1,159 @@
+//! @file
+//! @brief  Manager-side access to the executor's standard output ring buffer
+//! @author Martin Cejp
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+
+namespace bmboot::internal
+{
+
+//! A view of a single-producer, single-consumer byte ring shared with the executor.
+//!
+//! The executor owns the write position, the manager owns the read position.
+//! The ring is empty when the two are equal, so at most (capacity - 1) bytes can be pending.
+struct StdoutRingView
+{
+    char const volatile* buf;
+    size_t capacity;
+    size_t const volatile* wrpos;
+    size_t volatile* rdpos;
+};
+
+// ************************************************************
+
+//! Validate the read position and snapshot the write position. Returns the number of bytes pending.
+inline size_t stdoutRingSnapshot(StdoutRingView const& ring, size_t& rdpos_out, size_t& wrpos_out)
+{
+    auto rdpos = *ring.rdpos;
+
+    if (rdpos >= ring.capacity)
+    {
+        printf("bmboot: unexpected mst_stdout_rdpos %zx, resetting to 0\n", rdpos);
+        rdpos = 0;
+        *ring.rdpos = rdpos;
+    }
+
+    // The write position is read exactly once; anything the executor writes afterwards is left for the next call
+    auto wrpos = *ring.wrpos;
+
+    if (wrpos >= ring.capacity)
+    {
+        // Executor side is in an inconsistent state; it will reset its write position by itself
+        return 0;
+    }
+
+    // Do not let the buffer reads be hoisted above the write position read
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    rdpos_out = rdpos;
+    wrpos_out = wrpos;
+    return (wrpos >= rdpos) ? (wrpos - rdpos) : (ring.capacity - rdpos + wrpos);
+}
+
+//! Copy @p length pending bytes (in at most two contiguous runs) and release them back to the executor.
+inline void stdoutRingConsume(StdoutRingView const& ring, size_t rdpos, char* dest, size_t length)
+{
+    auto first_run = std::min(length, ring.capacity - rdpos);
+
+    memcpy(dest, (char const*) ring.buf + rdpos, first_run);
+    memcpy(dest + first_run, (char const*) ring.buf, length - first_run);
+
+    // The executor may only reuse the space once we are done copying out of it
+    std::atomic_thread_fence(std::memory_order_release);
+    *ring.rdpos = (rdpos + length) % ring.capacity;
+}
+
+// ************************************************************
+
+//! Read a single character from the ring. This is the legacy per-byte access path.
+//!
+//! @return The character read, or -1 if no output is pending.
+inline int stdoutRingGetchar(StdoutRingView const& ring)
+{
+    if (*ring.rdpos >= ring.capacity)
+    {
+        printf("bmboot: unexpected mst_stdout_rdpos %zx, resetting to 0\n", *ring.rdpos);
+        *ring.rdpos = 0;
+    }
+
+    if (*ring.rdpos != *ring.wrpos)
+    {
+        unsigned char c = ring.buf[*ring.rdpos];
+        *ring.rdpos = (*ring.rdpos + 1) % ring.capacity;
+        return c;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+//! Drain as much pending output as fits in @p buffer.
+//!
+//! @return Number of bytes read
+inline size_t stdoutRingRead(StdoutRingView const& ring, std::span<char> buffer)
+{
+    size_t rdpos, wrpos;
+    auto pending = stdoutRingSnapshot(ring, rdpos, wrpos);
+    auto length = std::min(pending, buffer.size());
+
+    if (length > 0)
+    {
+        stdoutRingConsume(ring, rdpos, buffer.data(), length);
+    }
+
+    return length;
+}
+
+//! Read one complete line, including the terminating newline.
+//!
+//! If no newline is pending, output is only consumed once it would fill the entire @p buffer.
+//!
+//! @return Number of bytes read, or 0 if no complete line is available yet
+inline size_t stdoutRingReadLine(StdoutRingView const& ring, std::span<char> buffer)
+{
+    size_t rdpos, wrpos;
+    auto pending = stdoutRingSnapshot(ring, rdpos, wrpos);
+    auto limit = std::min(pending, buffer.size());
+
+    if (limit == 0)
+    {
+        return 0;
+    }
+
+    // Look for a newline in (at most) two contiguous runs
+    auto first_run = std::min(limit, ring.capacity - rdpos);
+    auto first = (char const*) ring.buf + rdpos;
+    auto second = (char const*) ring.buf;
+
+    size_t length = 0;
+
+    if (auto newline = (char const*) memchr(first, '\n', first_run))
+    {
+        length = newline - first + 1;
+    }
+    else if (auto newline = (char const*) memchr(second, '\n', limit - first_run))
+    {
+        length = first_run + (newline - second) + 1;
+    }
+    else if (limit == buffer.size())
+    {
+        length = limit;
+    }
+    else
+    {
+        return 0;
+    }
+
+    stdoutRingConsume(ring, rdpos, buffer.data(), length);
+    return length;
+}
+
+}
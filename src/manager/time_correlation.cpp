@@ -0,0 +1,161 @@
+//! @file
+//! @brief  Correlation of executor timestamps with the manager's clock
+//! @author Martin Cejp
+
+#include "bmboot/time_correlation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace bmboot;
+using std::chrono::nanoseconds;
+
+// Maximum rate at which CLOCK_MONOTONIC may be slewed to follow NTP (MAXFREQ in the kernel), relative to real time
+static constexpr double MAX_RELATIVE_DRIFT = 500e-6;
+
+// ************************************************************
+
+TimeCorrelation::TimeCorrelation(nanoseconds max_round_trip, size_t window)
+        : m_max_round_trip(max_round_trip),
+          m_window(std::max<size_t>(window, 1))
+{
+}
+
+// ************************************************************
+
+bool TimeCorrelation::update(IDomain& domain, std::chrono::microseconds timeout)
+{
+    auto sample = domain.sampleExecutorClock(timeout);
+
+    return sample.has_value() && addSample(*sample);
+}
+
+// ************************************************************
+
+bool TimeCorrelation::addSample(ClockSample const& sample)
+{
+    auto round_trip = sample.host_after - sample.host_before;
+
+    if (round_trip < nanoseconds::zero() || round_trip > m_max_round_trip || sample.executor_frequency == 0)
+    {
+        return false;
+    }
+
+    // A sample from the past of the current ones (say, after the executor was restarted) invalidates all of them
+    if (!m_points.empty() && sample.executor_ticks <= m_points.back().ticks)
+    {
+        m_points.clear();
+    }
+
+    auto before_ns = std::chrono::duration_cast<nanoseconds>(sample.host_before.time_since_epoch()).count();
+    auto round_trip_ns = std::chrono::duration_cast<nanoseconds>(round_trip).count();
+
+    m_points.push_back(Point {
+        .ticks = sample.executor_ticks,
+        .host_ns = before_ns + round_trip_ns / 2,
+        .half_width_ns = (round_trip_ns + 1) / 2,
+    });
+
+    while (m_points.size() > m_window)
+    {
+        m_points.pop_front();
+    }
+
+    m_nominal_frequency = sample.executor_frequency;
+    refit();
+    return true;
+}
+
+// ************************************************************
+
+void TimeCorrelation::reset()
+{
+    m_points.clear();
+}
+
+// ************************************************************
+
+void TimeCorrelation::refit()
+{
+    // Work relative to the oldest sample, so that the magnitudes stay well within the precision of a double
+    m_ref_ticks = m_points.front().ticks;
+    m_ref_host_ns = m_points.front().host_ns;
+
+    auto n = (double) m_points.size();
+    double mean_x = 0, mean_y = 0;
+
+    for (auto const& point : m_points)
+    {
+        mean_x += (double) (point.ticks - m_ref_ticks) / n;
+        mean_y += (double) (point.host_ns - m_ref_host_ns) / n;
+    }
+
+    double sxx = 0, sxy = 0;
+
+    for (auto const& point : m_points)
+    {
+        auto dx = (double) (point.ticks - m_ref_ticks) - mean_x;
+        auto dy = (double) (point.host_ns - m_ref_host_ns) - mean_y;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+
+    m_slope_measured = (sxx > 0);
+    m_ns_per_tick = m_slope_measured ? (sxy / sxx) : (1e9 / m_nominal_frequency);
+    m_offset_ns = mean_y - m_ns_per_tick * mean_x;
+
+    m_error_ns = 0;
+
+    for (auto const& point : m_points)
+    {
+        auto fitted = m_offset_ns + m_ns_per_tick * (double) (point.ticks - m_ref_ticks);
+        auto residual = std::abs(fitted - (double) (point.host_ns - m_ref_host_ns));
+
+        m_error_ns = std::max(m_error_ns, (int64_t) std::ceil(residual) + point.half_width_ns);
+    }
+}
+
+// ************************************************************
+
+std::optional<HostTime> TimeCorrelation::toHostTime(uint64_t executor_ticks) const
+{
+    if (m_points.empty())
+    {
+        return {};
+    }
+
+    auto delta_ticks = (double) (int64_t) (executor_ticks - m_ref_ticks);
+    auto host_ns = (double) m_ref_host_ns + m_offset_ns + m_ns_per_tick * delta_ticks;
+
+    // Outside of the window, the clocks may have drifted apart in a way the fit knows nothing about
+    double outside_ns = 0;
+
+    if (executor_ticks < m_points.front().ticks)
+    {
+        outside_ns = (double) (m_points.front().ticks - executor_ticks) * m_ns_per_tick;
+    }
+    else if (executor_ticks > m_points.back().ticks)
+    {
+        outside_ns = (double) (executor_ticks - m_points.back().ticks) * m_ns_per_tick;
+    }
+
+    auto error_ns = m_error_ns + (int64_t) std::ceil(outside_ns * MAX_RELATIVE_DRIFT);
+
+    return HostTime {
+        .time = std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(nanoseconds(std::llround(host_ns)))),
+        .error_bound = nanoseconds(error_ns),
+    };
+}
+
+// ************************************************************
+
+std::optional<double> TimeCorrelation::getMeasuredFrequency() const
+{
+    if (m_points.empty() || !m_slope_measured)
+    {
+        return {};
+    }
+
+    return 1e9 / m_ns_per_tick;
+}
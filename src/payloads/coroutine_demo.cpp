@@ -0,0 +1,92 @@
+#include <bmboot/coroutines.hpp>
+#include <bmboot/payload_runtime.hpp>
+
+#include <cstdio>
+
+using bmboot::Channel;
+using bmboot::Coroutine;
+using bmboot::CoroutineExecutor;
+using std::chrono::microseconds;
+
+// Keep in sync with the test in src/tests/tests.cpp
+static constexpr int NUM_VALUES = 100;
+static constexpr int NUM_INTERRUPTS = 10;
+static constexpr int SGI_ID = 1;
+
+static Channel<int, 8> values;
+static unsigned num_received, sum_received, num_interrupts;
+
+static Coroutine produce()
+{
+    auto deadline = bmboot::getBuiltinTimerValue();
+
+    for (int i = 0; i < NUM_VALUES; i++)
+    {
+        deadline += bmboot::TimerService::toTicks(microseconds(1'000));
+        co_await bmboot::sleepUntil(deadline);
+
+        values.send(i);
+    }
+
+    values.send(-1);
+}
+
+static Coroutine consume()
+{
+    for (;;)
+    {
+        auto value = co_await values.receive();
+
+        if (value < 0)
+        {
+            break;
+        }
+
+        num_received++;
+        sum_received += value;
+    }
+}
+
+static Coroutine ping()
+{
+    for (int i = 0; i < NUM_INTERRUPTS; i++)
+    {
+        co_await bmboot::sleepFor(microseconds(5'000));
+        bmboot::raiseInterrupt(SGI_ID);
+    }
+}
+
+static Coroutine waitForInterrupts()
+{
+    while (num_interrupts < NUM_INTERRUPTS)
+    {
+        co_await bmboot::interrupt(SGI_ID);
+        num_interrupts++;
+    }
+}
+
+// A coroutine can await another one, like calling a function
+static Coroutine pingPong()
+{
+    co_await waitForInterrupts();
+}
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    printf("coroutine demo: %d values through a channel, %d interrupts\n", NUM_VALUES, NUM_INTERRUPTS);
+
+    auto start = bmboot::getBuiltinTimerValue();
+
+    CoroutineExecutor::spawn(consume());
+    CoroutineExecutor::spawn(produce());
+    CoroutineExecutor::spawn(pingPong());
+    CoroutineExecutor::spawn(ping());
+    CoroutineExecutor::run();
+
+    auto elapsed_us = (bmboot::getBuiltinTimerValue() - start) * 1'000'000 / bmboot::getBuiltinTimerFrequency();
+
+    printf("received: %u, sum: %u, interrupts: %u, frames: %u, elapsed: %u us\n", num_received, sum_received,
+           num_interrupts, (unsigned) CoroutineExecutor::getFrameCount(), (unsigned) elapsed_us);
+}
@@ -0,0 +1,37 @@
+#include <chrono>
+
+#include <bmboot/payload_runtime.hpp>
+
+// Keep in sync with the test in src/tests/tests.cpp
+static constexpr int NUM_ITERATIONS = 100;
+
+static void myHandler();
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    BMBOOT_LOG(info, "log demo on cpu%d: %s", bmboot::getCpuIndex(), "started");
+    BMBOOT_LOG(info, "flags 0x%x, offset %hd, low byte 0x%hhx", -1, -2, 0x1234);
+
+    bmboot::setupPeriodicInterrupt(std::chrono::microseconds(1'000), myHandler);
+    bmboot::startPeriodicInterrupt();
+
+    // do not exit the program while interrupt is active
+    for (;;) {
+        bmboot::idle();
+    }
+}
+
+static void myHandler()
+{
+    static int iteration = 0;
+
+    BMBOOT_LOG(debug, "this message is filtered out at the default level");
+    BMBOOT_LOG(info, "iteration %d: output %.3f", iteration, iteration * 0.5);
+
+    if (++iteration == NUM_ITERATIONS) {
+        BMBOOT_LOG(warning, "done after %d iterations", iteration);
+        bmboot::stopPeriodicInterrupt();
+    }
+}
@@ -1,24 +1,79 @@
 #include <bmboot/payload_runtime.hpp>
+#include <bmboot/pmu.hpp>
 #include <unistd.h>
 
-#include "../executor/armv8a.hpp"
+#include <cstdio>
+#include <iterator>
 
-static void myHandler();
+using bmboot::pmu::Event;
+
+static bmboot::pmu::Region sequential_region("sequential sum");
+static bmboot::pmu::Region strided_region("strided sum");
+
+// Large enough to not fit in the L1 data cache (32 KiB), small enough to fit in L2 (1 MiB)
+static volatile uint32_t data[64 * 1024];
+
+static uint32_t sum(size_t stride)
+{
+    uint32_t total = 0;
+
+    for (size_t start = 0; start < stride; start++)
+    {
+        for (size_t i = start; i < std::size(data); i += stride)
+        {
+            total += data[i];
+        }
+    }
+
+    return total;
+}
 
 int main(int argc, char** argv)
 {
     bmboot::notifyPayloadStarted();
 
     printf("Performance Monitor Unit demo\n");
-    printf("PMCR_EL0 =     0x%08X\n", readSysReg(PMCR_EL0));
-    printf("PMCCFLTR_EL0 = 0x%08X\n", readSysReg(PMCCFILTR_EL0));
-    printf("PMCCNTR_EL0 =  %ld\n", readSysReg(PMCCNTR_EL0));
 
-    bmboot::startCycleCounter();
+    Event const events[] = {
+        Event::instructions_retired,
+        Event::l1d_cache_access,
+        Event::l1d_cache_refill,
+        Event::l2d_cache_refill,
+        Event::branch_mispredicted,
+        Event::stall_load_miss,
+    };
+
+    if (!bmboot::pmu::configure(events))
+    {
+        printf("failed to configure PMU\n");
+        return 1;
+    }
+
+    // Keep in sync with the test in src/tests/tests.cpp
+    auto initial = bmboot::pmu::read();
+    printf("after configure: %llu cycles, %llu instructions\n",
+           (unsigned long long) initial.cycles, (unsigned long long) initial.events[0]);
 
     auto before = bmboot::getCycleCounterValue();
     usleep(10);
     auto after = bmboot::getCycleCounterValue();
 
-    printf("before: %ld, after: %ld, delta: %ld\n", before, after, after - before);
+    printf("usleep(10): %ld cycles\n", after - before);
+
+    // The same amount of work, once along the cache lines and once across them
+    for (int i = 0; i < 10; i++)
+    {
+        {
+            bmboot::pmu::ScopedCounters measure(sequential_region);
+            sum(1);
+        }
+
+        {
+            bmboot::pmu::ScopedCounters measure(strided_region);
+            sum(16);
+        }
+    }
+
+    bmboot::pmu::Region::printAll();
+    bmboot::pmu::stop();
 }
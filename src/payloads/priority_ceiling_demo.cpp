@@ -0,0 +1,66 @@
+#include <bmboot/payload_runtime.hpp>
+
+#include <cstdio>
+
+using bmboot::PayloadInterruptPriority;
+using bmboot::PriorityCeiling;
+
+// Keep in sync with the test in src/tests/tests.cpp
+static constexpr int HIGH_SGI_ID = 2;       // above the ceiling
+static constexpr int LOW_SGI_ID = 3;        // at the ceiling
+
+static volatile int high_count, low_count;
+
+static void countInterrupt(void* context)
+{
+    auto& count = *static_cast<volatile int*>(context);
+    count = count + 1;
+}
+
+// Give a pending interrupt ample time to be taken
+static void spin()
+{
+    auto end = bmboot::getBuiltinTimerValue() + bmboot::getBuiltinTimerFrequency() / 10'000;
+
+    while (bmboot::getBuiltinTimerValue() < end)
+    {
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    printf("priority ceiling demo\n");
+
+    bmboot::setupInterruptHandling(HIGH_SGI_ID, PayloadInterruptPriority::p6, countInterrupt, (void*) &high_count);
+    bmboot::setupInterruptHandling(LOW_SGI_ID, PayloadInterruptPriority::p4, countInterrupt, (void*) &low_count);
+    bmboot::enableInterruptHandling(HIGH_SGI_ID);
+    bmboot::enableInterruptHandling(LOW_SGI_ID);
+
+    int high_inside, low_inside, low_nested;
+
+    {
+        PriorityCeiling<PayloadInterruptPriority::p4> ceiling;
+
+        bmboot::raiseInterrupt(HIGH_SGI_ID);
+        bmboot::raiseInterrupt(LOW_SGI_ID);
+        spin();
+
+        high_inside = high_count;
+        low_inside = low_count;
+
+        // A lower ceiling inside must not let the interrupt through
+        {
+            PriorityCeiling<PayloadInterruptPriority::p1> nested;
+        }
+
+        spin();
+        low_nested = low_count;
+    }
+
+    spin();
+
+    printf("inside: high %d low %d, nested: low %d, after: low %d, mask: 0x%02x\n", high_inside, low_inside,
+           low_nested, (int) low_count, (unsigned) bmboot::getInterruptPriorityMask());
+}
@@ -0,0 +1,40 @@
+#include <bmboot/payload_runtime.hpp>
+#include <bmboot/scheduler.hpp>
+
+#include <cstdio>
+
+using bmboot::Task;
+using std::chrono::microseconds;
+
+// Keep in sync with the test in src/tests/tests.cpp
+static void busyWait(void* context)
+{
+    auto duration = bmboot::TimerService::toTicks(microseconds((intptr_t) context));
+    auto end = bmboot::getBuiltinTimerValue() + duration;
+
+    while (bmboot::getBuiltinTimerValue() < end)
+    {
+    }
+}
+
+// Priorities are assigned by period; the listing order does not matter
+static Task housekeeping("housekeeping", busyWait, (void*) 2'000, microseconds(100'000));
+static Task control_loop("control loop", busyWait, (void*) 100, microseconds(1'000));
+static Task supervision("supervision", busyWait, (void*) 1'000, microseconds(10'000), microseconds(500));
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    printf("scheduler demo: tasks at 1 kHz, 100 Hz and 10 Hz\n");
+
+    bmboot::Scheduler::addTask(housekeeping);
+    bmboot::Scheduler::addTask(control_loop);
+    bmboot::Scheduler::addTask(supervision);
+    bmboot::Scheduler::start();
+
+    for (;;)
+    {
+        bmboot::idle();
+    }
+}
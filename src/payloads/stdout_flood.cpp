@@ -0,0 +1,23 @@
+#include <bmboot/payload_runtime.hpp>
+
+#include <cstdio>
+
+// Keep in sync with the test in src/tests/tests.cpp
+static constexpr int NUM_LINES = 1024;      // 64 KiB in total, twice the capacity of the standard output ring
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    // Every line is 64 bytes long, so that the manager can tell exactly how much output has been lost
+    for (int i = 0; i < NUM_LINES; i++) {
+        printf("flood line %05d ..............................................\n", i);
+    }
+
+    fflush(stdout);
+    bmboot::flushStdout();
+
+    for (;;) {
+        bmboot::idle();
+    }
+}
@@ -0,0 +1,47 @@
+#include <chrono>
+
+#include <bmboot/payload_runtime.hpp>
+
+// Keep in sync with the test in src/tests/tests.cpp
+enum TelemetryType : uint16_t
+{
+    control_loop_sample = 1,
+};
+
+struct ControlLoopSample
+{
+    uint32_t iteration;
+    float error;
+    float output;
+};
+
+static void myHandler();
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    printf("telemetry demo: pushing one sample every 100 us\n");
+
+    bmboot::setupPeriodicInterrupt(std::chrono::microseconds(100), myHandler);
+    bmboot::startPeriodicInterrupt();
+
+    // do not exit the program while interrupt is active; idling also lets the manager correlate the timestamps
+    for (;;) {
+        bmboot::idle();
+    }
+}
+
+static void myHandler()
+{
+    static uint32_t iteration = 0;
+
+    ControlLoopSample sample {
+        .iteration = iteration,
+        .error = 1.0f / (iteration + 1),
+        .output = 0.5f * iteration,
+    };
+
+    bmboot::Telemetry::push(control_loop_sample, sample);
+    iteration++;
+}
@@ -0,0 +1,44 @@
+#include <bmboot/payload_runtime.hpp>
+#include <bmboot/timer_service.hpp>
+#include <unistd.h>
+
+#include <cstdio>
+
+using bmboot::Timer;
+using bmboot::TimerService;
+using std::chrono::microseconds;
+
+// Keep in sync with the test in src/tests/tests.cpp
+static uint32_t fast_count, medium_count, slow_count;
+
+static void countExpiry(void* context)
+{
+    (*static_cast<uint32_t*>(context))++;
+}
+
+static Timer fast_timer(countExpiry, &fast_count);
+static Timer medium_timer(countExpiry, &medium_count);
+static Timer slow_timer(countExpiry, &slow_count);
+
+int main(int argc, char** argv)
+{
+    bmboot::notifyPayloadStarted();
+
+    printf("timer service demo: 10 kHz, 1 kHz and 10 Hz timers for 1 second\n");
+
+    TimerService::start();
+    TimerService::startPeriodic(fast_timer, microseconds(100));
+    TimerService::startPeriodic(medium_timer, microseconds(1'000));
+    TimerService::startPeriodic(slow_timer, microseconds(100'000));
+
+    // With the service running, this sleeps in WFI instead of spinning
+    usleep(1'000'000);
+
+    TimerService::cancel(fast_timer);
+    TimerService::cancel(medium_timer);
+    TimerService::cancel(slow_timer);
+    TimerService::stop();
+
+    printf("expiries: %u %u %u, overruns: %u\n", (unsigned) fast_count, (unsigned) medium_count, (unsigned) slow_count,
+           (unsigned) (fast_timer.getOverrunCount() + medium_timer.getOverrunCount() + slow_timer.getOverrunCount()));
+}
@@ -15,6 +15,8 @@ using arm::armv8a::DAIF_F_MASK;
 using arm::armv8a::DAIF_I_MASK;
 using namespace bmboot::internal;
 using namespace bmboot::platform;
+using zynqmp::ipipsu::getIpi;
+using zynqmp::ipipsu::getIpiPeerMask;
 using zynqmp::ipipsu::IpiChannel;
 using zynqmp::scugic::getInterruptIdForIpi;
 using zynqmp::scugic::GICC;
@@ -96,6 +98,63 @@ void bmboot::platform::flushICache() {
 
 // ************************************************************
 
+void bmboot::platform::cleanAndInvalidateCacheRange(uintptr_t address, size_t size)
+{
+    // Cache line sizes are given in CTR_EL0 as log2 of the number of words
+    auto ctr = readSysReg(CTR_EL0);
+    uintptr_t dcache_line_size = 4 << ((ctr >> 16) & 0xF);
+    uintptr_t icache_line_size = 4 << (ctr & 0xF);
+
+    auto end = address + size;
+
+    for (auto line = address & ~(dcache_line_size - 1); line < end; line += dcache_line_size)
+    {
+        __asm__ __volatile__("dc civac, %0" : : "r" (line) : "memory");
+    }
+
+    // Data must have reached the PoU before the instruction fetch can observe it
+    __asm__ __volatile__("dsb ish" : : : "memory");
+
+    for (auto line = address & ~(icache_line_size - 1); line < end; line += icache_line_size)
+    {
+        __asm__ __volatile__("ic ivau, %0" : : "r" (line) : "memory");
+    }
+
+    __asm__ __volatile__("dsb ish; isb" : : : "memory");
+}
+
+// ************************************************************
+
+void bmboot::platform::notifyManager()
+{
+    auto mask = getIpcBlock().manager_to_executor.notify_ipi_mask;
+
+    // The channels on which the monitors listen for requests from the manager are off limits -- a notification
+    // would be interpreted as a request to kill the payload.
+    uint32_t monitor_channels_mask = 0;
+
+    for (int cpu_index = 1; cpu_index <= 3; cpu_index++)
+    {
+        monitor_channels_mask |= getIpiPeerMask(getIpiChannelForCpu(cpu_index));
+    }
+
+    if (mask != 0 && (mask & monitor_channels_mask) == 0)
+    {
+        // make sure the state update is visible before the interrupt arrives
+        __asm__ __volatile__("dsb st" : : : "memory");
+        getIpi(getIpiChannelForCpu(getCpuIndex()))->TRIG = mask;
+    }
+}
+
+// ************************************************************
+
+bool bmboot::platform::isManagerRequestPending()
+{
+    return (getIpi(getIpiChannelForCpu(getCpuIndex()))->ISR & getIpiPeerMask(IPI_SRC_BMBOOT_MANAGER)) != 0;
+}
+
+// ************************************************************
+
 static void setGroupForInterruptChannel(int int_id, InterruptGroup group)
 {
     if (group == InterruptGroup::group0_fiq_el3)
@@ -166,6 +225,22 @@ void bmboot::platform::enableInterrupt(int interrupt_id)
 
 // ************************************************************
 
+void bmboot::platform::enableSecureTimerInterrupt()
+{
+    // Below the IPI, which must always get through
+    configurePrivatePeripheralInterrupt(zynqmp::scugic::CNTPS_INTERRUPT_ID,
+                                        InterruptGroup::group0_fiq_el3,
+                                        MonitorInterruptPriority::m6);
+    enableInterrupt(zynqmp::scugic::CNTPS_INTERRUPT_ID);
+}
+
+void bmboot::platform::disableSecureTimerInterrupt()
+{
+    disableInterrupt(zynqmp::scugic::CNTPS_INTERRUPT_ID);
+}
+
+// ************************************************************
+
 void bmboot::platform::teardownEl1Interrupts()
 {
     platform::disableInterrupt(zynqmp::scugic::CNTPNS_INTERRUPT_ID);
@@ -9,6 +9,7 @@
 
 enum {
     EC_SMC = 0b010111,
+    EC_MSR_MRS = 0b011000,
 };
 
 using namespace bmboot;
@@ -18,7 +19,7 @@ using namespace zynqmp::scugic;
 
 // ************************************************************
 
-extern "C" void FIQInterrupt(void)
+extern "C" void FIQInterrupt(Aarch64_Regs& saved_regs)
 {
     auto iar = GICC->IAR;
     auto interrupt_id = (iar & arm::gicv2::GICC::IAR_INTERRUPT_ID_MASK);
@@ -37,6 +38,21 @@ extern "C" void FIQInterrupt(void)
 
         // IRQ triggered by APU?
         if (source_mask & getIpiPeerMask(internal::IPI_SRC_BMBOOT_MANAGER)) {
+            if (getIpcBlock().manager_to_executor.ipi_request == IPI_REQ_SNAPSHOT) {
+                // return to the payload once the snapshot is done
+                parkPayloadForSnapshot(saved_regs);
+                return;
+            }
+            else if (getIpcBlock().manager_to_executor.ipi_request == IPI_REQ_PROFILE) {
+                configureProfiler();
+                return;
+            }
+            else if (getIpcBlock().manager_to_executor.ipi_request == IPI_REQ_PERF) {
+                configurePerfCounters();
+                configureProfiler();
+                return;
+            }
+
             platform::teardownEl1Interrupts();
 
             // reset monitor by jumping to entry point
@@ -44,6 +60,13 @@ extern "C" void FIQInterrupt(void)
         }
     }
 
+    if (interrupt_id == CNTPS_INTERRUPT_ID) {
+        takeProfileSample(saved_regs);
+        updatePerfCounters();
+        GICC->EOIR = iar;
+        return;
+    }
+
     auto fault_address = iar; //get_ELR();
     reportCrash(CrashingEntity::monitor, "Monitor FIQInterrupt", fault_address);
 
@@ -71,13 +94,18 @@ extern "C" void IRQInterrupt(void)
 
 extern "C" void SynchronousInterrupt(Aarch64_Regs& saved_regs)
 {
-    auto ec = (readSysReg(ESR_EL3) >> 26) & 0b111111;
+    auto esr = readSysReg(ESR_EL3);
+    auto ec = (esr >> 26) & 0b111111;
 
     if (ec == EC_SMC)
     {
         handleSmc(saved_regs);
         return;
     }
+    else if (ec == EC_MSR_MRS && emulateTrappedPmuAccess(saved_regs, esr))
+    {
+        return;
+    }
 
     auto fault_address = readSysReg(ELR_EL3);
 
@@ -7,6 +7,7 @@
 
 // ************************************************************
 
+using arm::armv8a::CNTP_CTL_ISTATUS;
 using arm::armv8a::DAIF_F_MASK;
 using arm::armv8a::DAIF_I_MASK;
 using namespace bmboot;
@@ -31,13 +32,42 @@ extern "C" void FIQInterrupt(void)
 
 extern "C" void IRQInterrupt(void)
 {
+#if BMBOOT_IRQ_STATS
+    // As early as possible, so that the measurements cover (nearly) all of the dispatch
+    auto entry_ticks = getBuiltinTimerValue();
+#endif
+
     auto iar = scugic::GICC->IAR;
     auto interrupt_id = (iar & arm::gicv2::GICC::IAR_INTERRUPT_ID_MASK);
 
-    if (interrupt_id >= GIC_MIN_USER_INTERRUPT_ID &&
-            interrupt_id <= GIC_MAX_USER_INTERRUPT_ID &&
-        user_interrupt_handlers[interrupt_id - GIC_MIN_USER_INTERRUPT_ID])
+    // A spurious interrupt (0x3ff) means that an interrupt was signalled, but by the time we got around to checking it,
+    // it was no longer pending at a sufficient priority. Either it has been masked by setInterruptPriorityMask in the
+    // meantime, and will be taken later, or it was level-sensitive and has been de-asserted.
+    // It must not be acknowledged.
+    if (interrupt_id == arm::gicv2::GICC::SPURIOUS_INTERRUPT_ID)
+    {
+        return;
+    }
+
+    // Copy the entry before unmasking IRQs; a handler might replace it
+    InterruptDispatchEntry handler {};
+
+    if (interrupt_id >= GIC_MIN_USER_INTERRUPT_ID && interrupt_id <= GIC_MAX_USER_INTERRUPT_ID)
     {
+        handler = user_interrupt_handlers[interrupt_id - GIC_MIN_USER_INTERRUPT_ID];
+    }
+
+    if (handler.function)
+    {
+#if BMBOOT_IRQ_STATS
+        // The deadline is only advanced by the handler, so at this point it still tells when the interrupt was due
+        if (interrupt_id == scugic::CNTPNS_INTERRUPT_ID && (readSysReg(CNTP_CTL_EL0) & CNTP_CTL_ISTATUS))
+        {
+            auto deadline = readSysReg(CNTP_CVAL_EL0);
+            recordIrqStatistics(getIrqStatsBlock().timer_latency, entry_ticks > deadline ? entry_ticks - deadline : 0);
+        }
+#endif
+
         // Back up SPSR and ELR before re-enabling interrupts
         //
         // Equivalent macro in Xilinx SDK (but looks quite sketchy with the stack usage):
@@ -46,20 +76,22 @@ extern "C" void IRQInterrupt(void)
         uint64_t elr = readSysReg(ELR_EL1);
         writeSysReg(DAIF, readSysReg(DAIF) & ~DAIF_I_MASK);
 
-        user_interrupt_handlers[interrupt_id - GIC_MIN_USER_INTERRUPT_ID]();
+        handler.function(handler.context);
 
         writeSysReg(DAIF, readSysReg(DAIF) | DAIF_I_MASK);              // mask IRQs again
         writeSysReg(SPSR_EL1, spsr);
         writeSysReg(ELR_EL1, elr);
 
+#if BMBOOT_IRQ_STATS
+        // Includes the time spent in any interrupts that have preempted this one
+        recordIrqStatistics(getIrqStatsBlock().interrupts[interrupt_id - GIC_MIN_USER_INTERRUPT_ID],
+                            getBuiltinTimerValue() - entry_ticks);
+#endif
+
         scugic::GICC->EOIR = iar;
         return;
     }
 
-    // Q: What to do if we get IRQInterrupt EL1 0x3ff?
-    // A: It means that an interrupt was signalled, but by the time we got around to checking it, it was gone.
-    //    For example, it might have been configured as level sensitive, while it was meant to be edge-sensitive
-
     auto fault_address = iar; //get_ELR();
     notifyPayloadCrashed("EL1 IRQInterrupt", fault_address);
 
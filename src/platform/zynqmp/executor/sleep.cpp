@@ -5,8 +5,14 @@
 #include <unistd.h>
 
 #include <bmboot/payload_runtime.hpp>
+#include <bmboot/timer_service.hpp>
+
+#include "armv8a.hpp"
+#include "payload_runtime_internal.hpp"
 
 using namespace bmboot;
+using namespace bmboot::internal;
+using arm::armv8a::DAIF_I_MASK;
 
 // ************************************************************
 
@@ -15,6 +21,19 @@ static uint64_t divideRoundingUp(uint64_t dividend, uint64_t divisor)
     return (dividend + divisor - 1) / divisor;
 }
 
+static void setFlag(void* context)
+{
+    *static_cast<bool volatile*>(context) = true;
+}
+
+// Sleeping with WFI needs the timer interrupt to wake us up, which is only possible if it is serviced by the
+// TimerService and can preempt the caller. (Other handlers at the highest payload priority must not sleep either,
+// but there is no cheap way to tell.)
+static bool canWaitForTimer()
+{
+    return TimerService::isRunning() && !TimerService::isInCallback() && (readSysReg(DAIF) & DAIF_I_MASK) == 0;
+}
+
 // ************************************************************
 
 extern "C" unsigned int sleep(unsigned int seconds)
@@ -31,6 +50,29 @@ extern "C" int usleep(unsigned long useconds)
     // (The philosophy is to never sleep shorter than requested)
     auto end = start + divideRoundingUp(useconds * getBuiltinTimerFrequency(), 1'000'000);
 
+    if (canWaitForTimer())
+    {
+        bool volatile expired = false;
+        Timer timer(setFlag, (void*) &expired);
+        TimerService::startAt(timer, end);
+
+        for (;;)
+        {
+            // WFI wakes up for a pending interrupt even while IRQs are masked, so if the timer expires between the
+            // check and the WFI, the wakeup is not lost; the interrupt is taken as soon as they are unmasked again
+            IrqMask mask;
+
+            if (expired)
+            {
+                break;
+            }
+
+            arm::armv8a::waitForInterrupt();
+        }
+
+        return 0;
+    }
+
     while (getBuiltinTimerValue() < end)
     {
     }
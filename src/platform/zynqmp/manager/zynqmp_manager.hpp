@@ -12,6 +12,12 @@
 
 #define memory_write_reorder_barrier() __asm volatile ("dmb ishst" : : : "memory")
 
+// Order all preceding memory accesses, including reads, before any subsequent ones
+#define memory_barrier() __asm volatile ("dmb ish" : : : "memory")
+
+// Wake up cores waiting in WFE (all the APU cores are in the same cluster)
+#define send_event() __asm volatile ("dsb ishst; sev" : : : "memory")
+
 namespace zynqmp
 {
 
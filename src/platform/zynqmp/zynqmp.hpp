@@ -86,8 +86,12 @@ namespace zynqmp
         constexpr inline uintptr_t CPU_BASEADDR = 0xF9020000U;
 
         // UG1085, Table 13-4: APU Private Peripheral Interrupts
+        constexpr inline int CNTPS_INTERRUPT_ID = 29;
         constexpr inline int CNTPNS_INTERRUPT_ID = 30;
 
+        // UG1085, Table 13-1: System Interrupts (one per APU core, in order)
+        constexpr inline int APU_PMU0_INTERRUPT_ID = 175;
+
         inline auto GICD = (arm::gicv2::GICD*) DIST_BASEADDR;
 
         inline auto GICC = (arm::gicv2::GICC*) CPU_BASEADDR;
@@ -1,8 +1,13 @@
 #include "bmboot/domain.hpp"
+#include "bmboot/domain_group.hpp"
+#include "bmboot/log_decoder.hpp"
+#include "bmboot/profiler.hpp"
+#include "bmboot/time_correlation.hpp"
 #include "../utility/crc32.hpp"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 #include <thread>
@@ -111,6 +116,32 @@ struct BmbootFixture : public ::testing::Test
         throw_for_err(domain->loadAndStartPayload(program, crc, 0));
     }
 
+    // Read standard output of the payload until a line matches the sscanf format, filling in all of @p args.
+    // Returns false if no such line has appeared within 2 seconds.
+    template <typename... Args>
+    bool waitForStdoutLine(char const* format, Args*... args) const
+    {
+        char line[160];
+
+        for (auto deadline = std::chrono::steady_clock::now() + 2s; std::chrono::steady_clock::now() < deadline; )
+        {
+            auto length = domain->readStdoutLine(line);
+
+            if (length == 0)
+            {
+                std::this_thread::sleep_for(1ms);
+                continue;
+            }
+
+            if (sscanf(std::string(line, length).c_str(), format, args...) == (int) sizeof...(args))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     std::unique_ptr<IDomain> domain;
 };
 
@@ -131,6 +162,153 @@ TEST_F(BmbootFixture, hello_world)
     ASSERT_EQ(state, DomainState::running_payload);
 }
 
+TEST_F(BmbootFixture, load_from_file)
+{
+    // synopsis of test:
+    // 1. attempt to load a non-existent file, assert that it fails without side effects
+    // 2. load payload_hello_world directly from its file
+    // 3. assert that it starts correctly
+
+    ASSERT_EQ(domain->loadPayloadFromFile("does_not_exist.bin", 0), ErrorCode::file_access_failed);
+    ASSERT_EQ(domain->getState(), DomainState::monitor_ready);
+
+    throw_for_err(domain->loadPayloadFromFile("payload_hello_world_cpu1.bin", 0));
+
+    auto state = domain->getState();
+    ASSERT_EQ(state, DomainState::running_payload);
+}
+
+TEST_F(BmbootFixture, domain_group)
+{
+    // synopsis of test:
+    // 1. assert that a group cannot contain the same domain twice
+    // 2. open a group of the tested domain, load payload_hello_world through it with a per-domain argument
+    // 3. assert that the payload starts correctly and prints the argument
+    // 4. assert that a domain without a payload path fails without side effects
+
+    DomainIndex const duplicate[] { DomainIndex::cpu1, DomainIndex::cpu1 };
+    auto maybe_group = DomainGroup::open(duplicate);
+    ASSERT_TRUE(std::holds_alternative<ErrorCode>(maybe_group));
+    ASSERT_EQ(std::get<ErrorCode>(maybe_group), ErrorCode::hw_resource_unavailable);
+
+    DomainIndex const domains[] { DomainIndex::cpu1 };
+    maybe_group = DomainGroup::open(domains);
+    ASSERT_TRUE(std::holds_alternative<DomainGroup>(maybe_group));
+    auto& group = std::get<DomainGroup>(maybe_group);
+    ASSERT_EQ(group.size(), 1);
+
+    auto results = group.ensureReadyToLoadPayload();
+    ASSERT_EQ(results.size(), 1);
+    throw_for_err(results[0]);
+
+    ASSERT_EQ(group.loadPayloadsFromFiles({}, 0)[0], ErrorCode::file_access_failed);
+    ASSERT_EQ(domain->getState(), DomainState::monitor_ready);
+
+    std::filesystem::path const paths[] { "payload_hello_world_cpu1.bin" };
+    uintptr_t const payload_arguments[] { 4567 };
+    results = group.loadPayloadsFromFiles(paths, payload_arguments);
+    ASSERT_EQ(results.size(), 1);
+    throw_for_err(results[0]);
+
+    ASSERT_EQ(domain->getState(), DomainState::running_payload);
+
+    int cpu;
+    long argument;
+
+    ASSERT_TRUE(waitForStdoutLine("Hello world from CPU%d! Our base address is %*s and the Payload Argument is %ld.",
+                                  &cpu, &argument));
+    EXPECT_EQ(argument, 4567);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, stdout_line)
+{
+    // synopsis of test:
+    // 1. load payload_hello_world
+    // 2. read back the first line of its output in one call, including the newline
+
+    execute_payload("payload_hello_world_cpu1.bin");
+
+    int cpu, abi_major, abi_minor;
+    long argument;
+    char terminator;
+
+    ASSERT_TRUE(waitForStdoutLine("Hello world from CPU%d! Our base address is %*s and the Payload Argument is %ld. "
+                                  "ABI version %d.%d.%c",
+                                  &cpu, &argument, &abi_major, &abi_minor, &terminator));
+    EXPECT_EQ(cpu, 1);
+    EXPECT_EQ(terminator, '\n');
+}
+
+TEST_F(BmbootFixture, stdout_overflow)
+{
+    // synopsis of test:
+    // 1. select the drop policy and load payload_stdout_flood, which writes twice as much as the ring can hold
+    // 2. without reading, assert that every byte is either pending or counted as dropped
+    // 3. select the block policy and load payload_stdout_flood again
+    // 4. keep reading, assert that the entire output arrives intact and nothing is dropped
+
+    // Keep in sync with src/payloads/stdout_flood.cpp
+    constexpr int num_lines = 1024;
+    constexpr size_t line_length = 64;
+
+    std::string expected;
+
+    for (int i = 0; i < num_lines; i++)
+    {
+        char line[line_length + 1];
+        snprintf(line, sizeof(line), "flood line %05d ..............................................\n", i);
+        expected += line;
+    }
+
+    ASSERT_EQ(expected.size(), num_lines * line_length);
+
+    domain->setStdoutOverflowPolicy(StdoutOverflowPolicy::drop);
+    auto dropped_before = domain->getStdoutDroppedBytes();
+
+    execute_payload("payload_stdout_flood_cpu1.bin");
+
+    uint64_t dropped = 0;
+
+    for (auto deadline = std::chrono::steady_clock::now() + 1s; std::chrono::steady_clock::now() < deadline; )
+    {
+        dropped = domain->getStdoutDroppedBytes() - dropped_before;
+
+        if (dropped + domain->getStdoutPendingBytes() == expected.size())
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(1ms);
+    }
+
+    EXPECT_GT(dropped, 0);
+    EXPECT_EQ(dropped + domain->getStdoutPendingBytes(), expected.size());
+
+    throw_for_err(domain->terminatePayload());
+
+    domain->setStdoutOverflowPolicy(StdoutOverflowPolicy::block, 10ms);
+    dropped_before = domain->getStdoutDroppedBytes();
+
+    execute_payload("payload_stdout_flood_cpu1.bin");
+
+    std::string output;
+
+    for (auto deadline = std::chrono::steady_clock::now() + 2s;
+         output.size() < expected.size() && std::chrono::steady_clock::now() < deadline; )
+    {
+        char buffer[4096];
+        output.append(buffer, domain->readStdout(buffer));
+    }
+
+    EXPECT_EQ(domain->getStdoutDroppedBytes(), dropped_before);
+    EXPECT_EQ(output, expected);
+
+    throw_for_err(domain->terminatePayload());
+    domain->setStdoutOverflowPolicy(StdoutOverflowPolicy::drop);
+}
+
 TEST_F(BmbootFixture, access_violation)
 {
     // synopsis of test:
@@ -144,9 +322,9 @@ TEST_F(BmbootFixture, access_violation)
 
     execute_payload("payload_access_violation_cpu1.bin");
 
-    std::this_thread::sleep_for(50ms);
+    throw_for_err(domain->waitForState(DomainState::crashed_payload, 1s));
 
-    auto state = domain->getState();;
+    auto state = domain->getState();
     ASSERT_EQ(state, DomainState::crashed_payload);
 
     // Save core dump
@@ -173,3 +351,441 @@ TEST_F(BmbootFixture, access_violation)
     state = domain->getState();
     ASSERT_EQ(state, DomainState::running_payload);
 }
+
+TEST_F(BmbootFixture, telemetry)
+{
+    // synopsis of test:
+    // 1. load payload_telemetry_demo
+    // 2. collect the records it pushes for a while
+    // 3. assert that they arrive in order, with increasing timestamps
+
+    struct ControlLoopSample
+    {
+        uint32_t iteration;
+        float error;
+        float output;
+    };
+
+    execute_payload("payload_telemetry_demo_cpu1.bin");
+
+    std::vector<TelemetryRecord> records;
+    TelemetryRecord buffer[64];
+
+    for (auto deadline = std::chrono::steady_clock::now() + 100ms; std::chrono::steady_clock::now() < deadline; )
+    {
+        auto count = domain->readTelemetry(buffer);
+        records.insert(records.end(), buffer, buffer + count);
+        std::this_thread::sleep_for(1ms);
+    }
+
+    ASSERT_GT(records.size(), 100);
+    ASSERT_EQ(domain->getTelemetryDroppedCount(), 0);
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        ASSERT_EQ(records[i].type, 1);
+        ASSERT_EQ(records[i].size, sizeof(ControlLoopSample));
+        ASSERT_EQ(records[i].as<ControlLoopSample>().iteration, i);
+
+        if (i > 0)
+        {
+            ASSERT_GT(records[i].timestamp, records[i - 1].timestamp);
+        }
+    }
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, time_correlation)
+{
+    // synopsis of test:
+    // 1. load payload_telemetry_demo, which idles between its interrupts
+    // 2. correlate the executor's clock with CLOCK_MONOTONIC over a series of samples
+    // 3. assert that the measured frequency of the executor's timer matches the nominal one
+    // 4. assert that a fresh sample converts to a time within its request-response interval (give or take the bound)
+    // 5. assert that the converted timestamps of telemetry records lie between the payload start and now
+
+    auto start = std::chrono::steady_clock::now();
+    execute_payload("payload_telemetry_demo_cpu1.bin");
+
+    TimeCorrelation correlation;
+    int accepted = 0;
+
+    for (int i = 0; i < 20; i++)
+    {
+        accepted += correlation.update(*domain) ? 1 : 0;
+        std::this_thread::sleep_for(10ms);
+    }
+
+    ASSERT_GE(accepted, 5);
+
+    auto sample = domain->sampleExecutorClock(200us);
+    ASSERT_TRUE(sample.has_value());
+
+    auto frequency = correlation.getMeasuredFrequency();
+    ASSERT_TRUE(frequency.has_value());
+    EXPECT_NEAR(*frequency, sample->executor_frequency, sample->executor_frequency * 1e-3);
+
+    auto host_time = correlation.toHostTime(sample->executor_ticks);
+    ASSERT_TRUE(host_time.has_value());
+    EXPECT_LT(host_time->error_bound, 100us);
+    EXPECT_GE(host_time->time, sample->host_before - host_time->error_bound);
+    EXPECT_LE(host_time->time, sample->host_after + host_time->error_bound);
+
+    TelemetryRecord records[64];
+    auto count = domain->readTelemetry(records);
+    auto now = std::chrono::steady_clock::now();
+    ASSERT_GT(count, 0);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto record_time = correlation.toHostTime(records[i]);
+        ASSERT_TRUE(record_time.has_value());
+        EXPECT_GE(record_time->time, start - record_time->error_bound);
+        EXPECT_LE(record_time->time, now + record_time->error_bound);
+    }
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, snapshot)
+{
+    // synopsis of test:
+    // 1. load payload_telemetry_demo
+    // 2. take a full snapshot, then an incremental one
+    // 3. assert that the payload is still running and producing telemetry
+    // 4. assert that the incremental snapshot is smaller than the full one
+
+    execute_payload("payload_telemetry_demo_cpu1.bin");
+
+    throw_for_err(domain->snapshot("snapshot_full"));
+    std::this_thread::sleep_for(10ms);
+    throw_for_err(domain->snapshot("snapshot_incremental", SnapshotMode::incremental));
+
+    ASSERT_EQ(domain->getState(), DomainState::running_payload);
+
+    TelemetryRecord buffer[64];
+    while (domain->readTelemetry(buffer) > 0)
+    {
+    }
+
+    std::this_thread::sleep_for(10ms);
+    ASSERT_GT(domain->readTelemetry(buffer), 0);
+
+    struct stat full {}, incremental {};
+    ASSERT_EQ(stat("snapshot_full", &full), 0);
+    ASSERT_EQ(stat("snapshot_incremental", &incremental), 0);
+    ASSERT_GT(full.st_size, 4096);
+    ASSERT_LT(incremental.st_size, full.st_size);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, profiler)
+{
+    // synopsis of test:
+    // 1. load payload_telemetry_demo and profile it for 100 ms at 10 kHz
+    // 2. assert that samples have been taken and that they point into the payload
+    // 3. symbolize them and assert that the payload's idle loop in main() shows up
+
+    auto maybe_symbolizer = Symbolizer::open("payload_telemetry_demo_cpu1.elf");
+    ASSERT_TRUE(std::holds_alternative<Symbolizer>(maybe_symbolizer));
+    auto& symbolizer = std::get<Symbolizer>(maybe_symbolizer);
+
+    execute_payload("payload_telemetry_demo_cpu1.bin");
+
+    throw_for_err(domain->startProfiler(ProfilerSettings { .interval = 100us, .max_stack_depth = 4 }));
+
+    std::vector<ProfileSample> samples;
+    ProfileSample buffer[64];
+
+    for (auto deadline = std::chrono::steady_clock::now() + 100ms; std::chrono::steady_clock::now() < deadline; )
+    {
+        auto count = domain->readProfileSamples(buffer);
+        samples.insert(samples.end(), buffer, buffer + count);
+        std::this_thread::sleep_for(1ms);
+    }
+
+    throw_for_err(domain->stopProfiler());
+    throw_for_err(domain->terminatePayload());
+
+    ASSERT_GT(samples.size(), 100);
+
+    for (auto const& sample : samples)
+    {
+        ASSERT_GE(sample.pc, 0x800100000);
+        ASSERT_LT(sample.pc, 0x800100000 + 0x02000000);
+    }
+
+    ASSERT_NE(formatFoldedStacks(samples, symbolizer).find("main"), std::string::npos);
+}
+
+TEST_F(BmbootFixture, perf_counters)
+{
+    // synopsis of test:
+    // 1. load payload_telemetry_demo and have the monitor count instructions and IRQs
+    // 2. assert that the counters advance while the payload runs (it takes an interrupt every 100 us)
+    // 3. stop counting and assert that no more values are published
+
+    execute_payload("payload_telemetry_demo_cpu1.bin");
+
+    pmu::Event const events[] = { pmu::Event::instructions_retired, pmu::Event::irq_taken };
+    throw_for_err(domain->startPerfCounters(events));
+
+    std::this_thread::sleep_for(20ms);
+    auto start = domain->readPerfCounters();
+    std::this_thread::sleep_for(100ms);
+    auto end = domain->readPerfCounters();
+
+    ASSERT_TRUE(start.has_value());
+    ASSERT_TRUE(end.has_value());
+    ASSERT_EQ(end->num_events, 2);
+    ASSERT_GT(end->timestamp, start->timestamp);
+    ASSERT_GT(end->cycles, start->cycles);
+    ASSERT_GT(end->events[0], start->events[0]);
+    ASSERT_GE(end->events[1] - start->events[1], 500);
+
+    throw_for_err(domain->stopPerfCounters());
+    std::this_thread::sleep_for(10ms);
+    ASSERT_FALSE(domain->readPerfCounters().has_value());
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, payload_pmu)
+{
+    // synopsis of test:
+    // 1. load payload_pmu_demo, which counts events in a sequential and a strided pass over an array
+    // 2. assert that all counters, including the cycle counter, start from 0
+    // 3. assert that both regions have been measured 10 times, and that the strided pass misses L1 more often
+
+    execute_payload("payload_pmu_demo_cpu1.bin");
+
+    unsigned long long cycles, instructions;
+
+    ASSERT_TRUE(waitForStdoutLine("after configure: %llu cycles, %llu instructions", &cycles, &instructions));
+    EXPECT_LT(cycles, 100'000);
+    EXPECT_LT(instructions, 100'000);
+
+    // Region::printAll lists the regions in reverse order of construction
+    unsigned samples;
+    unsigned long long min, max, strided_refills, sequential_refills;
+
+    ASSERT_TRUE(waitForStdoutLine("strided sum: %u samples", &samples));
+    EXPECT_EQ(samples, 10);
+    ASSERT_TRUE(waitForStdoutLine(" l1d_cache_refill min %llu mean %llu max %llu", &min, &strided_refills, &max));
+
+    ASSERT_TRUE(waitForStdoutLine("sequential sum: %u samples", &samples));
+    EXPECT_EQ(samples, 10);
+    ASSERT_TRUE(waitForStdoutLine(" l1d_cache_refill min %llu mean %llu max %llu", &min, &sequential_refills, &max));
+
+    EXPECT_GT(strided_refills, sequential_refills);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, irq_statistics)
+{
+    // synopsis of test:
+    // 1. load payload_telemetry_demo, which takes the periodic interrupt every 100 us
+    // 2. unless the payload runtime was built without BMBOOT_IRQ_STATS, assert that the interrupt has been measured
+    // 3. reset the statistics and assert that they start over
+
+    auto const timer_interrupt_id = 30;      // CNTPNS
+
+    execute_payload("payload_telemetry_demo_cpu1.bin");
+    std::this_thread::sleep_for(100ms);
+
+    auto statistics = domain->readIrqStatistics();
+
+    if (!statistics.has_value())
+    {
+        throw_for_err(domain->terminatePayload());
+        GTEST_SKIP() << "payload runtime built without BMBOOT_IRQ_STATS";
+    }
+
+    ASSERT_GT(statistics->timer_frequency, 0);
+    ASSERT_GE(statistics->timer_latency.count, 500);
+    ASSERT_LE(statistics->timer_latency.min, statistics->timer_latency.max);
+
+    auto timer_irq = std::find_if(statistics->interrupts.begin(), statistics->interrupts.end(),
+                                  [&](auto const& interrupt) { return interrupt.interrupt_id == timer_interrupt_id; });
+    ASSERT_NE(timer_irq, statistics->interrupts.end());
+    ASSERT_GE(timer_irq->duration.count, 500);
+    ASSERT_GT(timer_irq->duration.max, 0);
+
+    domain->resetIrqStatistics();
+    std::this_thread::sleep_for(10ms);
+
+    auto after_reset = domain->readIrqStatistics();
+    ASSERT_TRUE(after_reset.has_value());
+    ASSERT_LT(after_reset->timer_latency.count, statistics->timer_latency.count);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, deferred_log)
+{
+    // synopsis of test:
+    // 1. load payload_log_demo
+    // 2. collect the log messages it writes until it is done
+    // 3. decode them using the ELF file and check the text, level and that debug messages have been filtered out
+    // 4. check that integer arguments are narrowed according to their length modifiers
+
+    auto maybe_decoder = LogDecoder::open("payload_log_demo_cpu1.elf");
+    ASSERT_TRUE(std::holds_alternative<LogDecoder>(maybe_decoder));
+    auto& decoder = std::get<LogDecoder>(maybe_decoder);
+
+    domain->setLogLevel(LogLevel::info);
+    execute_payload("payload_log_demo_cpu1.bin");
+
+    std::vector<LogRecord> records;
+    LogRecord buffer[16];
+
+    for (auto deadline = std::chrono::steady_clock::now() + 300ms; std::chrono::steady_clock::now() < deadline; )
+    {
+        auto count = domain->readLog(buffer);
+        records.insert(records.end(), buffer, buffer + count);
+        std::this_thread::sleep_for(1ms);
+    }
+
+    ASSERT_EQ(domain->getLogDroppedCount(), 0);
+    ASSERT_EQ(records.size(), 2 + 100 + 1);
+
+    ASSERT_EQ(decoder.format(records[0]), "log demo on cpu1: started");
+    ASSERT_EQ(decoder.format(records[2]), "iteration 0: output 0.000");
+    ASSERT_EQ(decoder.format(records[5]), "iteration 3: output 1.500");
+    ASSERT_EQ(records[5].level, LogLevel::info);
+    ASSERT_EQ(decoder.format(records.back()), "done after 100 iterations");
+    ASSERT_EQ(records.back().level, LogLevel::warning);
+
+    ASSERT_EQ(decoder.format(records[1]), "flags 0xffffffff, offset -2, low byte 0x34");
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, timer_service)
+{
+    // synopsis of test:
+    // 1. load payload_timer_service_demo, which runs timers at 10 kHz, 1 kHz and 10 Hz while sleeping for 1 second
+    // 2. wait for it to print how many times each has expired
+    // 3. assert that each count matches its rate, within one period, and that no periods were skipped
+
+    execute_payload("payload_timer_service_demo_cpu1.bin");
+
+    unsigned fast, medium, slow, overruns;
+
+    ASSERT_TRUE(waitForStdoutLine("expiries: %u %u %u, overruns: %u", &fast, &medium, &slow, &overruns));
+    EXPECT_NEAR(fast, 10'000, 1);
+    EXPECT_NEAR(medium, 1'000, 1);
+    EXPECT_NEAR(slow, 10, 1);
+    EXPECT_EQ(overruns, 0);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, scheduler)
+{
+    // synopsis of test:
+    // 1. load payload_scheduler_demo, which runs tasks at 1 kHz, 100 Hz and 10 Hz, busy for 10 % to 20 % of each period
+    // 2. after a while, read the task statistics
+    // 3. assert that priorities follow the periods, that every job has completed in time, and that the measured
+    //    execution times match the work done
+    // 4. reset the statistics and assert that they start over
+
+    execute_payload("payload_scheduler_demo_cpu1.bin");
+    std::this_thread::sleep_for(300ms);
+
+    auto statistics = domain->readSchedulerStatistics();
+    ASSERT_TRUE(statistics.has_value());
+    ASSERT_EQ(statistics->tasks.size(), 3);
+
+    auto const& control_loop = statistics->tasks[0];
+    auto const& supervision = statistics->tasks[1];
+    auto const& housekeeping = statistics->tasks[2];
+
+    ASSERT_EQ(control_loop.name, "control loop");
+    ASSERT_EQ(supervision.name, "supervision");
+    ASSERT_EQ(housekeeping.name, "housekeeping");
+    ASSERT_LT(control_loop.priority, supervision.priority);
+    ASSERT_LT(supervision.priority, housekeeping.priority);
+
+    auto ticks_per_us = statistics->timer_frequency / 1'000'000;
+
+    ASSERT_GE(control_loop.statistics.releases, 250);
+    ASSERT_GE(supervision.statistics.releases, 25);
+    ASSERT_GE(housekeeping.statistics.releases, 2);
+
+    for (auto const& task : statistics->tasks)
+    {
+        ASSERT_GE(task.statistics.completions + 1, task.statistics.releases);
+        ASSERT_EQ(task.statistics.overruns, 0);
+        ASSERT_EQ(task.statistics.dropped, 0);
+        ASSERT_LE(task.statistics.min_execution, task.statistics.max_execution);
+        ASSERT_LT(task.statistics.max_lateness, 0);
+    }
+
+    // Preemption by the control loop must not be counted against the other tasks
+    ASSERT_GE(control_loop.statistics.min_execution, 100 * ticks_per_us);
+    ASSERT_LT(supervision.statistics.max_execution, 1'100 * ticks_per_us);
+    ASSERT_LT(housekeeping.statistics.max_execution, 2'100 * ticks_per_us);
+
+    domain->resetSchedulerStatistics();
+    std::this_thread::sleep_for(10ms);
+
+    auto after_reset = domain->readSchedulerStatistics();
+    ASSERT_TRUE(after_reset.has_value());
+    ASSERT_LT(after_reset->tasks[0].statistics.releases, control_loop.statistics.releases);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, coroutines)
+{
+    // synopsis of test:
+    // 1. load payload_coroutine_demo, in which coroutines pass 100 values through a channel at 1 ms intervals and
+    //    wait for 10 software-generated interrupts raised at 5 ms intervals
+    // 2. wait for it to print the results once all coroutines have finished
+    // 3. assert that every value and interrupt has been received, that all frames have been freed, and that the
+    //    timing matches the sleeps
+
+    execute_payload("payload_coroutine_demo_cpu1.bin");
+
+    unsigned received, sum, interrupts, frames, elapsed_us;
+
+    ASSERT_TRUE(waitForStdoutLine("received: %u, sum: %u, interrupts: %u, frames: %u, elapsed: %u us",
+                                  &received, &sum, &interrupts, &frames, &elapsed_us));
+    EXPECT_EQ(received, 100);
+    EXPECT_EQ(sum, 99 * 100 / 2);
+    EXPECT_EQ(interrupts, 10);
+    EXPECT_EQ(frames, 0);
+    EXPECT_GE(elapsed_us, 100'000);
+    EXPECT_LT(elapsed_us, 110'000);
+
+    throw_for_err(domain->terminatePayload());
+}
+
+TEST_F(BmbootFixture, priority_ceiling)
+{
+    // synopsis of test:
+    // 1. load payload_priority_ceiling_demo, which raises two interrupts, one above and one at the ceiling, inside a
+    //    priority ceiling critical section, with another critical section of a lower ceiling nested in it
+    // 2. wait for it to print which interrupts have been taken at each point
+    // 3. assert that only the interrupt above the ceiling has been taken inside, and the other one once the critical
+    //    section has ended, and that the priority mask has been restored
+
+    execute_payload("payload_priority_ceiling_demo_cpu1.bin");
+
+    int high_inside, low_inside, low_nested, low_after;
+    unsigned mask;
+
+    ASSERT_TRUE(waitForStdoutLine("inside: high %d low %d, nested: low %d, after: low %d, mask: %x",
+                                  &high_inside, &low_inside, &low_nested, &low_after, &mask));
+    EXPECT_EQ(high_inside, 1);
+    EXPECT_EQ(low_inside, 0);
+    EXPECT_EQ(low_nested, 0);
+    EXPECT_EQ(low_after, 1);
+    EXPECT_GE(mask, 0xF8);
+
+    throw_for_err(domain->terminatePayload());
+}
@@ -3,10 +3,19 @@
 //! @author Martin Cejp
 
 #include "bmboot/domain.hpp"
+#include "bmboot/domain_group.hpp"
 #include "bmboot/domain_helpers.hpp"
+#include "bmboot/profiler.hpp"
 
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
 
 using namespace bmboot;
 
@@ -15,9 +24,17 @@ using namespace bmboot;
 static int usage()
 {
     fprintf(stderr, "usage: bmctl boot <domain>\n");
-    fprintf(stderr, "usage: bmctl core <domain>\n");
+    fprintf(stderr, "usage: bmctl boot all\n");
+    fprintf(stderr, "usage: bmctl core <domain> [<file>|-]\n");
     fprintf(stderr, "usage: bmctl debuginfo <domain>\n");
+    fprintf(stderr, "usage: bmctl irqstats <domain> [reset]\n");
+    fprintf(stderr, "usage: bmctl loglevel <domain> error|warning|info|debug\n");
+    fprintf(stderr, "usage: bmctl perf stat <domain> <seconds> [<event>...]\n");
+    fprintf(stderr, "usage: bmctl profile <domain> <payload.elf> [folded|perf] [<seconds>]\n");
     fprintf(stderr, "usage: bmctl run <domain> <payload>\n");
+    fprintf(stderr, "usage: bmctl run all <payload_cpu1> <payload_cpu2> <payload_cpu3>\n");
+    fprintf(stderr, "usage: bmctl sched <domain> [reset]\n");
+    fprintf(stderr, "usage: bmctl snapshot <domain> [<file>|-]\n");
     fprintf(stderr, "usage: bmctl start <domain> <payload>\n");
     fprintf(stderr, "usage: bmctl status <domain>\n");
     fprintf(stderr, "usage: bmctl terminate <domain>\n");
@@ -32,6 +49,11 @@ static void display_domain_state(IDomain& domain)
 
     puts(toString(state).c_str());
 
+    if (auto dropped_bytes = domain.getStdoutDroppedBytes(); dropped_bytes > 0)
+    {
+        printf("(%llu bytes of output dropped)\n", (unsigned long long) dropped_bytes);
+    }
+
     if (state == DomainState::crashed_monitor || state == DomainState::crashed_payload)
     {
         auto error_info = domain.getCrashInfo();
@@ -42,6 +64,470 @@ static void display_domain_state(IDomain& domain)
 
 // ************************************************************
 
+static bool report_group_errors(DomainGroup& group, std::vector<MaybeError> const& results, char const* function_name)
+{
+    bool any_error = false;
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (results[i].has_value())
+        {
+            fprintf(stderr, "%s: %s: error: %s\n",
+                    toString(group[i].getIndex()).c_str(), function_name, toString(*results[i]).c_str());
+            any_error = true;
+        }
+    }
+
+    return any_error;
+}
+
+// ************************************************************
+
+static int boot_all()
+{
+    auto group = throwOnError(DomainGroup::openAll(), "DomainGroup::open");
+
+    // all monitors are started concurrently
+    auto results = group.startup();
+
+    if (report_group_errors(group, results, "DomainGroup::startup"))
+    {
+        return -1;
+    }
+
+    for (auto& domain : group)
+    {
+        printf("%s: domain state: %s\n", toString(domain->getIndex()).c_str(), toString(domain->getState()).c_str());
+    }
+
+    return 0;
+}
+
+// ************************************************************
+
+static int run_all(int num_payloads, char** payload_filenames)
+{
+    auto group = throwOnError(DomainGroup::openAll(), "DomainGroup::open");
+
+    if (num_payloads != (int) group.size())
+    {
+        return usage();
+    }
+
+    // boot or reset as necessary
+
+    if (report_group_errors(group, group.ensureReadyToLoadPayload(), "DomainGroup::ensureReadyToLoadPayload"))
+    {
+        return -1;
+    }
+
+    // start
+
+    std::vector<std::filesystem::path> paths(payload_filenames, payload_filenames + num_payloads);
+    std::vector<uintptr_t> payload_arguments;
+
+    for (auto const& path : paths)
+    {
+        payload_arguments.push_back(getDefaultPayloadArgument(path));
+    }
+
+    if (report_group_errors(group, group.loadPayloadsFromFiles(paths, payload_arguments),
+                            "DomainGroup::loadPayloadsFromFiles"))
+    {
+        return -1;
+    }
+
+    // console
+
+    runConsoleUntilInterrupted(group, paths);
+
+    // terminate
+
+    int rc = 0;
+
+    for (auto& domain : group)
+    {
+        auto err = domain->terminatePayload();
+
+        if (err.has_value())
+        {
+            fprintf(stderr, "%s: IDomain::reset_domain: error: %s\n",
+                    toString(domain->getIndex()).c_str(), toString(*err).c_str());
+            rc = -1;
+        }
+    }
+
+    return rc;
+}
+
+// ************************************************************
+
+static volatile sig_atomic_t interrupted;
+
+// Make SIGINT set the flag above rather than kill us, so that the domain can be put back in order
+static void catchInterrupt()
+{
+    struct sigaction sa;
+    sa.sa_handler = [](int) { interrupted = 1; };
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, nullptr);
+}
+
+// Format an integer with thousands separators, like perf does
+static std::string formatCount(uint64_t value)
+{
+    auto digits = std::to_string(value);
+    std::string text;
+
+    for (size_t i = 0; i < digits.size(); i++)
+    {
+        if (i > 0 && (digits.size() - i) % 3 == 0)
+        {
+            text.push_back(',');
+        }
+
+        text.push_back(digits[i]);
+    }
+
+    return text;
+}
+
+// ************************************************************
+
+// Sample the running payload until the duration elapses (or forever, if 0) or until interrupted by SIGINT
+static int profile(IDomain& domain, char const* payload_filename, bool perf_format, double duration_seconds)
+{
+    auto maybe_symbolizer = Symbolizer::open(payload_filename);
+
+    if (std::holds_alternative<ErrorCode>(maybe_symbolizer))
+    {
+        fprintf(stderr, "Symbolizer::open: error: %s\n", toString(std::get<ErrorCode>(maybe_symbolizer)).c_str());
+        return -1;
+    }
+
+    auto& symbolizer = std::get<Symbolizer>(maybe_symbolizer);
+
+    auto clock = domain.sampleExecutorClock(std::chrono::milliseconds(10));
+    auto timer_frequency = clock.has_value() ? clock->executor_frequency : 0;
+
+    catchInterrupt();
+
+    auto dropped_before = domain.getProfileDroppedCount();
+
+    if (auto err = domain.startProfiler(ProfilerSettings { .max_stack_depth = ProfileSample::MAX_FRAMES });
+        err.has_value())
+    {
+        fprintf(stderr, "IDomain::startProfiler: error: %s\n", toString(*err).c_str());
+        return -1;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration_seconds));
+
+    std::vector<ProfileSample> samples;
+    ProfileSample buffer[64];
+
+    for (;;)
+    {
+        bool done = interrupted || (duration_seconds > 0 && std::chrono::steady_clock::now() >= deadline);
+
+        if (done)
+        {
+            domain.stopProfiler();
+        }
+
+        while (auto count = domain.readProfileSamples(buffer))
+        {
+            samples.insert(samples.end(), buffer, buffer + count);
+        }
+
+        if (done)
+        {
+            break;
+        }
+
+        // The ring holds about half a second worth of samples at the default rate
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    auto text = perf_format ? formatPerfScript(samples, symbolizer, timer_frequency,
+                                               std::filesystem::path(payload_filename).stem().string(),
+                                               domain.getIndex() + 1)
+                            : formatFoldedStacks(samples, symbolizer);
+    fwrite(text.data(), 1, text.size(), stdout);
+
+    fprintf(stderr, "bmctl: %zu samples", samples.size());
+
+    if (auto dropped = domain.getProfileDroppedCount() - dropped_before; dropped > 0)
+    {
+        fprintf(stderr, " (%u dropped)", dropped);
+    }
+
+    fprintf(stderr, "\n");
+    return 0;
+}
+
+// ************************************************************
+
+// Print the interrupt statistics of an instrumented payload
+static int irq_stats(IDomain& domain)
+{
+    auto statistics = domain.readIrqStatistics();
+
+    if (!statistics.has_value())
+    {
+        fprintf(stderr, "bmctl: the payload does not collect interrupt statistics (built without BMBOOT_IRQ_STATS?)\n");
+        return -1;
+    }
+
+    auto frequency = statistics->timer_frequency;
+
+    auto toMicros = [frequency](uint64_t ticks)
+    {
+        return frequency ? ticks * 1e6 / frequency : 0.0;
+    };
+
+    auto printRow = [&](char const* label, TickHistogram const& histogram)
+    {
+        if (histogram.count == 0)
+        {
+            printf("%-16s %12s\n", label, "0");
+            return;
+        }
+
+        printf("%-16s %12llu %12.3f %12.3f %12.3f\n", label, (unsigned long long) histogram.count,
+               toMicros(histogram.min), toMicros(histogram.total) / histogram.count, toMicros(histogram.max));
+    };
+
+    printf("%-16s %12s %12s %12s %12s\n", "", "count", "min [us]", "mean [us]", "max [us]");
+
+    for (auto const& interrupt : statistics->interrupts)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "irq %d", interrupt.interrupt_id);
+        printRow(label, interrupt.duration);
+    }
+
+    printRow("timer latency", statistics->timer_latency);
+
+    // The worst case is what matters for deadlines, so show how the latencies are distributed
+    if (auto const& latency = statistics->timer_latency; latency.count > 0)
+    {
+        printf("\ntimer latency distribution:\n");
+
+        for (size_t bin = 0; bin < TickHistogram::NUM_BINS; bin++)
+        {
+            if (latency.bins[bin] == 0)
+            {
+                continue;
+            }
+
+            auto low = (bin == 0) ? 0 : (1ull << bin);
+
+            if (bin == TickHistogram::NUM_BINS - 1)
+            {
+                printf("  %10.3f us and more   %12u\n", toMicros(low), latency.bins[bin]);
+            }
+            else
+            {
+                printf("  %10.3f - %-10.3f us  %12u\n", toMicros(low), toMicros((2ull << bin) - 1), latency.bins[bin]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// ************************************************************
+
+// Print the task statistics of the payload's scheduler
+static int sched_stats(IDomain& domain)
+{
+    auto statistics = domain.readSchedulerStatistics();
+
+    if (!statistics.has_value())
+    {
+        fprintf(stderr, "bmctl: the payload has not started a scheduler\n");
+        return -1;
+    }
+
+    auto frequency = statistics->timer_frequency;
+
+    auto toMicros = [frequency](double ticks)
+    {
+        return frequency ? ticks * 1e6 / frequency : 0.0;
+    };
+
+    printf("%-20s %4s %12s %10s %10s %8s %8s %10s %10s %10s %10s %10s\n", "task", "prio", "period [us]", "releases",
+           "completed", "overruns", "dropped", "min [us]", "mean [us]", "max [us]", "delay [us]", "late [us]");
+
+    for (auto const& task : statistics->tasks)
+    {
+        auto const& s = task.statistics;
+
+        printf("%-20s 0x%02x %12.1f %10llu %10llu %8llu %8llu", task.name.c_str(), task.priority,
+               toMicros(task.period), (unsigned long long) s.releases, (unsigned long long) s.completions,
+               (unsigned long long) s.overruns, (unsigned long long) s.dropped);
+
+        if (s.completions > 0)
+        {
+            printf(" %10.3f %10.3f %10.3f %10.3f %10.3f\n", toMicros(s.min_execution),
+                   toMicros(s.total_execution) / s.completions, toMicros(s.max_execution),
+                   toMicros(s.max_start_delay), toMicros(s.max_lateness));
+        }
+        else
+        {
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
+
+// ************************************************************
+
+// Count PMU events of the running payload for the given duration (or until interrupted by SIGINT) and print a summary
+static int perf_stat(IDomain& domain, double duration_seconds, std::vector<pmu::Event> events)
+{
+    using pmu::Event;
+
+    if (events.empty())
+    {
+        events = { Event::instructions_retired, Event::l1d_cache_access, Event::l1d_cache_refill,
+                   Event::l2d_cache_access, Event::l2d_cache_refill, Event::irq_taken };
+    }
+
+    catchInterrupt();
+
+    if (auto err = domain.startPerfCounters(events); err.has_value())
+    {
+        fprintf(stderr, "IDomain::startPerfCounters: error: %s\n", toString(*err).c_str());
+        return -1;
+    }
+
+    // The starting point is published as soon as the monitor has taken over the PMU; values of an earlier session
+    // that has not been stopped are not returned in the meantime
+    std::optional<PerfCounterValues> start;
+
+    for (auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+         !start.has_value() && std::chrono::steady_clock::now() < deadline; )
+    {
+        start = domain.readPerfCounters();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration_seconds));
+
+    while (!interrupted && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    auto end = domain.readPerfCounters();
+    domain.stopPerfCounters();
+
+    if (!start.has_value() || !end.has_value())
+    {
+        fprintf(stderr, "bmctl: the monitor did not publish any counter values\n");
+        return -1;
+    }
+
+    // The values are as of the last update by the monitor, so the time elapsed is measured by the same clock.
+    // (Its frequency is published along, since a busy payload might never answer IDomain::sampleExecutorClock.)
+    auto seconds = end->timer_frequency ? (double) (end->timestamp - start->timestamp) / end->timer_frequency : 0.0;
+    auto cycles = end->cycles - start->cycles;
+
+    auto getCount = [&](Event event) -> std::optional<uint64_t>
+    {
+        for (size_t i = 0; i < end->num_events && i < events.size(); i++)
+        {
+            if (events[i] == event)
+            {
+                return end->events[i] - start->events[i];
+            }
+        }
+
+        return {};
+    };
+
+    printf("\n Performance counter stats for %s (%.3f s):\n\n", toString(domain.getIndex()).c_str(), seconds);
+    printf("%18s      %-24s\n", formatCount(cycles).c_str(), "cycles");
+
+    for (size_t i = 0; i < end->num_events && i < events.size(); i++)
+    {
+        auto count = end->events[i] - start->events[i];
+        auto name = pmu::toString(events[i]);
+
+        char name_buffer[16];
+
+        if (name == nullptr)
+        {
+            snprintf(name_buffer, sizeof(name_buffer), "0x%02x", (unsigned) events[i]);
+            name = name_buffer;
+        }
+
+        printf("%18s      %-24s", formatCount(count).c_str(), name);
+
+        auto instructions = getCount(Event::instructions_retired);
+
+        switch (events[i])
+        {
+            case Event::instructions_retired:
+                if (cycles > 0)
+                {
+                    printf("  #  %8.2f insn per cycle", (double) count / cycles);
+                }
+                break;
+
+            case Event::l1d_cache_refill:
+            case Event::l2d_cache_refill:
+                if (auto accesses = getCount(events[i] == Event::l1d_cache_refill ? Event::l1d_cache_access
+                                                                                   : Event::l2d_cache_access);
+                    accesses.has_value() && *accesses > 0)
+                {
+                    printf("  #  %8.2f%% of accesses", 100.0 * count / *accesses);
+                }
+                break;
+
+            case Event::l1i_cache_refill:
+            case Event::branch_mispredicted:
+                if (instructions.has_value() && *instructions > 0)
+                {
+                    printf("  #  %8.2f per 1k instructions", 1000.0 * count / *instructions);
+                }
+                break;
+
+            case Event::irq_taken:
+            case Event::exception_taken:
+                if (seconds > 0)
+                {
+                    printf("  #  %8.1f /s", count / seconds);
+                }
+                break;
+
+            case Event::stall_icache_miss:
+            case Event::stall_load_miss:
+            case Event::stall_store:
+                if (cycles > 0)
+                {
+                    printf("  #  %8.2f%% of cycles", 100.0 * count / cycles);
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        printf("\n");
+    }
+
+    printf("\n");
+    return 0;
+}
+
+// ************************************************************
+
 int main(int argc, char** argv)
 {
     // each sub-command takes domain as 1st parameter
@@ -50,6 +536,57 @@ int main(int argc, char** argv)
         return usage();
     }
 
+    // perf takes a sub-sub-command first
+    if (strcmp(argv[1], "perf") == 0)
+    {
+        if (argc < 5 || strcmp(argv[2], "stat") != 0)
+        {
+            return usage();
+        }
+
+        auto domain_index = parseDomainIndex(argv[3]);
+
+        if (!domain_index.has_value())
+        {
+            fprintf(stderr, "bmctl: unknown domain '%s'\n", argv[3]);
+            return -1;
+        }
+
+        std::vector<pmu::Event> events;
+
+        for (int i = 5; i < argc; i++)
+        {
+            auto event = pmu::parseEvent(argv[i]);
+
+            if (!event.has_value())
+            {
+                fprintf(stderr, "bmctl: unknown event '%s'\n", argv[i]);
+                return -1;
+            }
+
+            events.push_back(*event);
+        }
+
+        auto domain = throwOnError(IDomain::open(*domain_index), "IDomain::open");
+        return perf_stat(*domain, atof(argv[4]), std::move(events));
+    }
+
+    if (strcmp(argv[2], "all") == 0)
+    {
+        if (strcmp(argv[1], "boot") == 0 && argc == 3)
+        {
+            return boot_all();
+        }
+        else if (strcmp(argv[1], "run") == 0)
+        {
+            return run_all(argc - 3, argv + 3);
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
     auto domain_index = parseDomainIndex(argv[2]);
 
     if (!domain_index.has_value())
@@ -85,7 +622,14 @@ int main(int argc, char** argv)
     }
     else if (strcmp(argv[1], "core") == 0)
     {
-        auto err = domain->dumpCore("core");
+        if (argc > 4)
+        {
+            return usage();
+        }
+
+        // "-" streams the dump to standard output, e.g. to pipe it into a compressor
+        auto filename = (argc == 4) ? argv[3] : "core";
+        auto err = (strcmp(filename, "-") == 0) ? domain->dumpCore(STDOUT_FILENO) : domain->dumpCore(filename);
 
         if (err.has_value())
         {
@@ -97,6 +641,60 @@ int main(int argc, char** argv)
     {
         domain->dumpDebugInfo();
     }
+    else if (strcmp(argv[1], "irqstats") == 0)
+    {
+        if (argc == 4 && strcmp(argv[3], "reset") == 0)
+        {
+            domain->resetIrqStatistics();
+        }
+        else if (argc == 3)
+        {
+            return irq_stats(*domain);
+        }
+        else
+        {
+            return usage();
+        }
+    }
+    else if (strcmp(argv[1], "loglevel") == 0)
+    {
+        if (argc != 4)
+        {
+            return usage();
+        }
+
+        auto level = parseLogLevel(argv[3]);
+
+        if (!level.has_value())
+        {
+            fprintf(stderr, "bmctl: unknown log level '%s'\n", argv[3]);
+            return -1;
+        }
+
+        domain->setLogLevel(*level);
+    }
+    else if (strcmp(argv[1], "profile") == 0)
+    {
+        if (argc < 4 || argc > 6)
+        {
+            return usage();
+        }
+
+        bool perf_format = false;
+
+        if (argc >= 5 && strcmp(argv[4], "perf") == 0)
+        {
+            perf_format = true;
+        }
+        else if (argc >= 5 && strcmp(argv[4], "folded") != 0)
+        {
+            return usage();
+        }
+
+        auto duration_seconds = (argc == 6) ? atof(argv[5]) : 0.0;
+
+        return profile(*domain, argv[3], perf_format, duration_seconds);
+    }
     else if (strcmp(argv[1], "run") == 0)
     {
         if (argc != 4)
@@ -137,7 +735,7 @@ int main(int argc, char** argv)
 
         // console
 
-        runConsoleUntilInterrupted(*domain);
+        runConsoleUntilInterrupted(*domain, payload_filename);
 
         // terminate
 
@@ -149,6 +747,37 @@ int main(int argc, char** argv)
             return -1;
         }
     }
+    else if (strcmp(argv[1], "sched") == 0)
+    {
+        if (argc == 4 && strcmp(argv[3], "reset") == 0)
+        {
+            domain->resetSchedulerStatistics();
+        }
+        else if (argc == 3)
+        {
+            return sched_stats(*domain);
+        }
+        else
+        {
+            return usage();
+        }
+    }
+    else if (strcmp(argv[1], "snapshot") == 0)
+    {
+        if (argc > 4)
+        {
+            return usage();
+        }
+
+        auto filename = (argc == 4) ? argv[3] : "snapshot";
+        auto err = (strcmp(filename, "-") == 0) ? domain->snapshot(STDOUT_FILENO) : domain->snapshot(filename);
+
+        if (err.has_value())
+        {
+            fprintf(stderr, "IDomain::snapshot: error: %s\n", toString(*err).c_str());
+            return -1;
+        }
+    }
     else if (strcmp(argv[1], "start") == 0)
     {
         if (argc != 4)
@@ -11,7 +11,7 @@ using namespace bmboot;
 
 static int usage()
 {
-    fprintf(stderr, "usage: console <domain>\n");
+    fprintf(stderr, "usage: console <domain> [payload.elf]\n");
     return -1;
 }
 
@@ -19,7 +19,7 @@ static int usage()
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    if (argc != 2 && argc != 3)
     {
         return usage();
     }
@@ -54,5 +54,6 @@ int main(int argc, char** argv)
         domain->startDummyPayload();
     }
 
-    runConsoleUntilInterrupted(*domain);
+    // the payload ELF, if given, is used to decode log messages
+    runConsoleUntilInterrupted(*domain, (argc == 3) ? argv[2] : "");
 }
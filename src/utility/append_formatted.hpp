@@ -0,0 +1,36 @@
+//! @file
+//! @brief  snprintf into a std::string
+//! @author Martin Cejp
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace bmboot::internal
+{
+
+// Append the result of snprintf to a string, however long it is
+template <typename... Args>
+void appendFormatted(std::string& text, char const* format, Args... args)
+{
+    auto length = snprintf(nullptr, 0, format, args...);
+
+    if (length <= 0)
+    {
+        return;
+    }
+
+    auto offset = text.size();
+    text.resize(offset + length + 1);
+    snprintf(text.data() + offset, length + 1, format, args...);
+    text.resize(offset + length);
+}
+
+template <typename... Args>
+void appendFormatted(std::string& text, std::string const& format, Args... args)
+{
+    appendFormatted(text, format.c_str(), args...);
+}
+
+}
@@ -38,10 +38,23 @@
  *
  *
  * CRC32 code derived from work by Gary S. Brown.
+ *
+ * On AArch64, the CRC32 instructions are used instead (both the APU running Linux and the executor cores are
+ * Cortex-A53, which implement them). Elsewhere, the table is extended for slicing-by-8.
  */
 
-#include <stddef.h>
-#include <stdint.h>
+#include "crc32.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__aarch64__)
+#pragma GCC target ("+crc")
+#include <arm_acle.h>
+#define BMBOOT_CRC32_INSTRUCTIONS 1
+#else
+#define BMBOOT_CRC32_INSTRUCTIONS 0
+#endif
 
 static const uint32_t crc32_tab[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -89,16 +102,109 @@ static const uint32_t crc32_tab[] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+// ************************************************************
+
+#if !BMBOOT_CRC32_INSTRUCTIONS
+
+// Slicing-by-8: crc32_slice_tab[k][b] is the CRC contribution of byte b followed by k zero bytes
+static constexpr auto crc32_slice_tab = []
+{
+	std::array<std::array<uint32_t, 256>, 8> tab {};
+
+	for (int b = 0; b < 256; b++)
+	{
+		tab[0][b] = crc32_tab[b];
+	}
+
+	for (int k = 1; k < 8; k++)
+	{
+		for (int b = 0; b < 256; b++)
+		{
+			tab[k][b] = (tab[k - 1][b] >> 8) ^ tab[0][tab[k - 1][b] & 0xFF];
+		}
+	}
+
+	return tab;
+}();
+
+#endif
+
+static inline uint32_t crc32_update_byte(uint32_t crc, uint8_t byte)
+{
+#if BMBOOT_CRC32_INSTRUCTIONS
+	return __crc32b(crc, byte);
+#else
+	return crc32_tab[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+#endif
+}
+
+// Consume 8 bytes, least significant first (little-endian byte order assumed)
+static inline uint32_t crc32_update_word(uint32_t crc, uint64_t word)
+{
+#if BMBOOT_CRC32_INSTRUCTIONS
+	return __crc32d(crc, word);
+#else
+	auto& t = crc32_slice_tab;
+	auto lo = (uint32_t) word ^ crc;
+	auto hi = (uint32_t) (word >> 32);
+
+	return t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+	       t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+#endif
+}
+
+// ************************************************************
+
 uint32_t
-crc32(uint32_t crc, const void *buf, size_t size)
+bmboot::crc32(uint32_t crc, const void *buf, size_t size)
 {
-	const uint8_t *p;
+	auto p = static_cast<const uint8_t*>(buf);
+	crc = crc ^ ~0U;
+
+	// Process the bulk 8 bytes at a time, from an aligned address
+	while (size > 0 && ((uintptr_t) p & 7) != 0)
+	{
+		crc = crc32_update_byte(crc, *p++);
+		size--;
+	}
+
+	for (; size >= 8; size -= 8, p += 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		crc = crc32_update_word(crc, word);
+	}
+
+	while (size--)
+		crc = crc32_update_byte(crc, *p++);
 
-	p = buf;
+	return crc ^ ~0U;
+}
+
+uint32_t
+bmboot::crc32_copy(uint32_t crc, void *dest, const void *src, size_t size)
+{
+	auto d = static_cast<uint8_t*>(dest);
+	auto s = static_cast<const uint8_t*>(src);
 	crc = crc ^ ~0U;
 
+	// Align the destination, since it is likely to be the more expensive side (e.g., memory mapped through /dev/mem)
+	while (size > 0 && ((uintptr_t) d & 7) != 0)
+	{
+		crc = crc32_update_byte(crc, *d++ = *s++);
+		size--;
+	}
+
+	for (; size >= 8; size -= 8, d += 8, s += 8)
+	{
+		uint64_t word;
+		memcpy(&word, s, sizeof(word));
+		memcpy(d, &word, sizeof(word));
+		crc = crc32_update_word(crc, word);
+	}
+
 	while (size--)
-		crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		crc = crc32_update_byte(crc, *d++ = *s++);
 
 	return crc ^ ~0U;
 }
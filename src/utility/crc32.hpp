@@ -1,5 +1,5 @@
 //! @file
-//! @brief  crc32 function
+//! @brief  crc32 functions
 //! @author Martin Cejp
 
 #pragma once
@@ -12,4 +12,8 @@ namespace bmboot
 
 extern "C" uint32_t crc32(uint32_t crc, const void *buf, size_t size);
 
+//! Copy @p size bytes from @p src to @p dest, computing the CRC-32 of the data along the way.
+//! This spares a second pass over the data when it needs to be both moved and checksummed.
+extern "C" uint32_t crc32_copy(uint32_t crc, void *dest, const void *src, size_t size);
+
 }
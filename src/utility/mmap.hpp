@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstdint>
+#include <utility>
 #include <sys/mman.h>
 
 namespace bmboot
@@ -12,6 +13,8 @@ namespace bmboot
     class Mmap
     {
     public:
+        Mmap() : base(nullptr), len(0) {}
+
         Mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
         {
             this->base = mmap(addr, len, prot, flags, fd, offset);
@@ -24,11 +27,73 @@ namespace bmboot
             }
         }
 
+        Mmap(Mmap const&) = delete;
+        Mmap& operator=(Mmap const&) = delete;
+
+        Mmap(Mmap&& other) noexcept
+                : base(std::exchange(other.base, nullptr)), len(std::exchange(other.len, 0))
+        {
+        }
+
+        Mmap& operator=(Mmap&& other) noexcept
+        {
+            if (this != &other)
+            {
+                this->unmap();
+                this->base = std::exchange(other.base, nullptr);
+                this->len = std::exchange(other.len, 0);
+            }
+
+            return *this;
+        }
+
         ~Mmap()
         {
             this->unmap();
         }
 
+        //! Map a file such that the virtual address is congruent with @p offset modulo @p alignment.
+        //!
+        //! For physical memory mapped through @c /dev/mem, this is the precondition for the kernel to be able to use
+        //! block (e.g., 2 MiB) translations instead of individual pages. Whether it actually does so depends on the
+        //! kernel; in the worst case, the mapping is no different from one created by the regular constructor.
+        static Mmap mapAligned(size_t alignment, size_t len, int prot, int flags, int fd, off_t offset)
+        {
+            // Reserve enough address space to be able to choose a suitably aligned start
+            auto reserved_len = len + alignment;
+            auto reserved = mmap(nullptr, reserved_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+            if (reserved == MAP_FAILED)
+            {
+                return Mmap(nullptr, len, prot, flags, fd, offset);
+            }
+
+            // Lowest address within the reservation that is congruent with the offset
+            auto reserved_start = (uintptr_t) reserved;
+            auto start = reserved_start + (((uintptr_t) offset - reserved_start) & (alignment - 1));
+
+            // Replace the middle of the reservation with the actual mapping, then release the remainder
+            Mmap mapping((void*) start, len, prot, flags | MAP_FIXED, fd, offset);
+
+            if (!mapping)
+            {
+                ::munmap(reserved, reserved_len);
+                return mapping;
+            }
+
+            if (start > reserved_start)
+            {
+                ::munmap(reserved, start - reserved_start);
+            }
+
+            if (reserved_start + reserved_len > start + len)
+            {
+                ::munmap((void*)(start + len), reserved_start + reserved_len - (start + len));
+            }
+
+            return mapping;
+        }
+
         void* data()
         {
             return this->base;
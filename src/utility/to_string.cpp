@@ -71,6 +71,48 @@ std::string bmboot::toString(ErrorCode err) {
         case ErrorCode::program_too_large: return "program too large, or wrong load address";
         case ErrorCode::monitor_start_timed_out: return "monitor startup timed out";
         case ErrorCode::unknown_error: return "unknown error";
+        case ErrorCode::file_access_failed: return "failed to open payload file";
+        case ErrorCode::core_dump_failed: return "failed to write core dump";
+        case ErrorCode::invalid_argument: return "invalid argument";
+        case ErrorCode::state_wait_timed_out: return "timed out waiting for domain state";
         default: return "error " + std::to_string((int) err);
     }
 }
+
+// ************************************************************
+
+std::optional<LogLevel> bmboot::parseLogLevel(std::string_view const& str)
+{
+    if (str == "error"sv)
+    {
+        return LogLevel::error;
+    }
+    else if (str == "warning"sv)
+    {
+        return LogLevel::warning;
+    }
+    else if (str == "info"sv)
+    {
+        return LogLevel::info;
+    }
+    else if (str == "debug"sv)
+    {
+        return LogLevel::debug;
+    }
+    else
+    {
+        return {};
+    }
+}
+
+// ************************************************************
+
+std::string bmboot::toString(LogLevel level) {
+    switch (level) {
+        case LogLevel::error: return "error";
+        case LogLevel::warning: return "warning";
+        case LogLevel::info: return "info";
+        case LogLevel::debug: return "debug";
+        default: return "level " + std::to_string((int) level);
+    }
+}